@@ -0,0 +1,327 @@
+// Measures the cost of the crypto operations performed on each stream using the
+// crypto backend that moonlight-common-c was built with. To compare backends, build
+// this once per backend (the default OpenSSL build and -DUSE_MBEDTLS=ON for PSA Crypto)
+// and compare the output of each.
+//
+// Usage: bench_crypto [cpu GHz]
+//
+// Cycles per byte are measured with the TSC on x86. On other architectures, they are
+// only reported when the CPU frequency is provided on the command line.
+
+#include <Limelight.h>
+#include <PlatformCrypto.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define HAVE_TSC
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+
+#define KEY_LENGTH 16
+#define GCM_IV_LENGTH 12
+#define GCM_TAG_LENGTH 16
+#define CBC_IV_LENGTH 16
+
+// Audio packets are usually a bit over 200 bytes and control messages are a few dozen
+#define AUDIO_PACKET_LENGTH 240
+#define CONTROL_MESSAGE_LENGTH 32
+
+#define VIDEO_BATCH_SIZE 32
+
+#define TARGET_RUN_TIME_NS 250000000ULL
+#define MAX_MESSAGE_LENGTH 2048
+
+typedef struct _BENCH_RESULT {
+    uint64_t iterations;
+    uint64_t bytes;
+    uint64_t timeNs;
+    uint64_t cycles;
+} BENCH_RESULT, *PBENCH_RESULT;
+
+typedef bool (*BenchOperation)(void* context);
+
+static double cpuGhz;
+
+static unsigned char key[KEY_LENGTH];
+static unsigned char iv[CBC_IV_LENGTH];
+static unsigned char tag[GCM_TAG_LENGTH];
+static unsigned char plaintext[MAX_MESSAGE_LENGTH];
+static unsigned char ciphertext[MAX_MESSAGE_LENGTH];
+static unsigned char output[MAX_MESSAGE_LENGTH];
+
+static uint64_t getNanoseconds(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&counter);
+
+    return (uint64_t)((double)counter.QuadPart * 1000000000.0 / (double)frequency.QuadPart);
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static uint64_t getCycles(void) {
+#ifdef HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Runs the operation until the target run time has elapsed
+static bool runBenchmark(BenchOperation operation, void* context, int bytesPerIteration, PBENCH_RESULT result) {
+    uint64_t startTimeNs, startCycles;
+
+    // Warm up the key schedule and caches
+    for (int i = 0; i < 1000; i++) {
+        if (!operation(context)) {
+            return false;
+        }
+    }
+
+    memset(result, 0, sizeof(*result));
+    startTimeNs = getNanoseconds();
+    startCycles = getCycles();
+    do {
+        for (int i = 0; i < 1000; i++) {
+            operation(context);
+        }
+        result->iterations += 1000;
+        result->timeNs = getNanoseconds() - startTimeNs;
+    } while (result->timeNs < TARGET_RUN_TIME_NS);
+    result->cycles = getCycles() - startCycles;
+    result->bytes = result->iterations * bytesPerIteration;
+
+    return true;
+}
+
+static void printResult(const char* name, int messageLength, int messagesPerIteration, PBENCH_RESULT result) {
+    double messages = (double)result->iterations * messagesPerIteration;
+    double cycles;
+
+#ifdef HAVE_TSC
+    cycles = (double)result->cycles;
+#else
+    cycles = (double)result->timeNs * cpuGhz;
+#endif
+
+    if (cycles > 0) {
+        printf("%-24s %6d %12.1f %12.2f\n", name, messageLength,
+               (double)result->timeNs / messages, cycles / (double)result->bytes);
+    }
+    else {
+        printf("%-24s %6d %12.1f %12s\n", name, messageLength,
+               (double)result->timeNs / messages, "n/a");
+    }
+}
+
+typedef struct _SINGLE_MESSAGE_CONTEXT {
+    PPLT_CRYPTO_CONTEXT ctx;
+    int length;
+} SINGLE_MESSAGE_CONTEXT, *PSINGLE_MESSAGE_CONTEXT;
+
+// Video packets are decrypted individually when the batch path isn't available
+static bool decryptVideoPacket(void* context) {
+    PSINGLE_MESSAGE_CONTEXT message = context;
+    int outputLength;
+
+    return PltDecryptMessage(message->ctx, ALGORITHM_AES_GCM, 0,
+                             key, sizeof(key), iv, GCM_IV_LENGTH, tag, sizeof(tag),
+                             ciphertext, message->length, output, &outputLength);
+}
+
+typedef struct _BATCH_CONTEXT {
+    PPLT_CRYPTO_CONTEXT ctx;
+    PLT_CRYPTO_MESSAGE messages[VIDEO_BATCH_SIZE];
+} BATCH_CONTEXT, *PBATCH_CONTEXT;
+
+static bool decryptVideoBatch(void* context) {
+    PBATCH_CONTEXT batch = context;
+
+    return PltDecryptMessageBatch(batch->ctx, ALGORITHM_AES_GCM, 0,
+                                  key, sizeof(key), GCM_IV_LENGTH, GCM_TAG_LENGTH,
+                                  batch->messages, VIDEO_BATCH_SIZE) == VIDEO_BATCH_SIZE;
+}
+
+// Audio resets the IV for each packet, which is the expensive case for the crypto libraries
+static bool decryptAudioPacket(void* context) {
+    PSINGLE_MESSAGE_CONTEXT message = context;
+    int outputLength = message->length;
+
+    return PltDecryptMessage(message->ctx, ALGORITHM_AES_CBC, CIPHER_FLAG_RESET_IV | CIPHER_FLAG_FINISH,
+                             key, sizeof(key), iv, CBC_IV_LENGTH, NULL, 0,
+                             ciphertext, message->length, output, &outputLength);
+}
+
+static bool encryptControlMessage(void* context) {
+    PSINGLE_MESSAGE_CONTEXT message = context;
+    unsigned char messageTag[GCM_TAG_LENGTH];
+    int outputLength;
+
+    // Control messages use a new IV for each message
+    iv[0]++;
+
+    return PltEncryptMessage(message->ctx, ALGORITHM_AES_GCM, 0,
+                             key, sizeof(key), iv, GCM_IV_LENGTH, messageTag, sizeof(messageTag),
+                             plaintext, message->length, output, &outputLength);
+}
+
+static bool decryptControlMessage(void* context) {
+    return decryptVideoPacket(context);
+}
+
+// Produces the ciphertext and tag that the decryption benchmarks will consume
+static bool prepareCiphertext(int algorithm, int flags, int length, int* ciphertextLength) {
+    PPLT_CRYPTO_CONTEXT ctx = PltCreateCryptoContext();
+    bool ret;
+
+    if (ctx == NULL) {
+        return false;
+    }
+
+    *ciphertextLength = sizeof(ciphertext);
+    ret = PltEncryptMessage(ctx, algorithm, flags,
+                            key, sizeof(key),
+                            iv, algorithm == ALGORITHM_AES_GCM ? GCM_IV_LENGTH : CBC_IV_LENGTH,
+                            algorithm == ALGORITHM_AES_GCM ? tag : NULL,
+                            algorithm == ALGORITHM_AES_GCM ? sizeof(tag) : 0,
+                            plaintext, length, ciphertext, ciphertextLength);
+
+    PltDestroyCryptoContext(ctx);
+    return ret;
+}
+
+static bool benchSingleMessages(const char* name, BenchOperation operation,
+                                int algorithm, int flags, bool decrypt, int length) {
+    SINGLE_MESSAGE_CONTEXT message;
+    BENCH_RESULT result;
+    bool ret;
+
+    message.length = length;
+    if (decrypt && !prepareCiphertext(algorithm, flags, length, &message.length)) {
+        fprintf(stderr, "%s: failed to prepare %d byte message\n", name, length);
+        return false;
+    }
+
+    message.ctx = PltCreateCryptoContext();
+    if (message.ctx == NULL) {
+        return false;
+    }
+
+    ret = runBenchmark(operation, &message, length, &result);
+    PltDestroyCryptoContext(message.ctx);
+
+    if (!ret) {
+        fprintf(stderr, "%s: operation failed at %d bytes\n", name, length);
+        return false;
+    }
+
+    printResult(name, length, 1, &result);
+    return true;
+}
+
+static bool benchVideoBatch(int length) {
+    static unsigned char batchOutput[VIDEO_BATCH_SIZE][MAX_MESSAGE_LENGTH];
+    BATCH_CONTEXT batch;
+    BENCH_RESULT result;
+    int ciphertextLength;
+    bool ret;
+
+    if (!prepareCiphertext(ALGORITHM_AES_GCM, 0, length, &ciphertextLength)) {
+        fprintf(stderr, "GCM video batch: failed to prepare %d byte message\n", length);
+        return false;
+    }
+
+    for (int i = 0; i < VIDEO_BATCH_SIZE; i++) {
+        batch.messages[i].iv = iv;
+        batch.messages[i].tag = tag;
+        batch.messages[i].inputData = ciphertext;
+        batch.messages[i].inputDataLength = length;
+        batch.messages[i].outputData = batchOutput[i];
+    }
+
+    batch.ctx = PltCreateCryptoContext();
+    if (batch.ctx == NULL) {
+        return false;
+    }
+
+    ret = runBenchmark(decryptVideoBatch, &batch, length * VIDEO_BATCH_SIZE, &result);
+    PltDestroyCryptoContext(batch.ctx);
+
+    if (!ret) {
+        fprintf(stderr, "GCM video batch: operation failed at %d bytes\n", length);
+        return false;
+    }
+
+    printResult("GCM video batch decrypt", length, VIDEO_BATCH_SIZE, &result);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    static const int videoPacketSizes[] = { 512, 1024, 1392 };
+    CRYPTO_STATS stats;
+    bool ret = true;
+
+    if (argc > 1) {
+        cpuGhz = atof(argv[1]);
+    }
+
+    for (int i = 0; i < (int)sizeof(key); i++) {
+        key[i] = (unsigned char)(i * 17 + 3);
+    }
+    for (int i = 0; i < (int)sizeof(iv); i++) {
+        iv[i] = (unsigned char)(i * 29 + 7);
+    }
+    for (int i = 0; i < (int)sizeof(plaintext); i++) {
+        plaintext[i] = (unsigned char)(i * 13 + 11);
+    }
+
+    // This also determines whether the built-in AES-GCM implementation is used
+    PltResetCryptoStats();
+    LiGetCryptoStats(&stats);
+
+    printf("Backend: %s%s\n", stats.backend, stats.builtInAesGcm ? " (built-in AES-GCM)" : "");
+#ifdef HAVE_TSC
+    printf("Cycles are TSC reference cycles\n");
+#endif
+    printf("%-24s %6s %12s %12s\n", "Operation", "Bytes", "ns/packet", "cycles/byte");
+
+    for (int i = 0; i < (int)(sizeof(videoPacketSizes) / sizeof(videoPacketSizes[0])); i++) {
+        ret = benchSingleMessages("GCM video decrypt", decryptVideoPacket,
+                                  ALGORITHM_AES_GCM, 0, true, videoPacketSizes[i]) && ret;
+    }
+    for (int i = 0; i < (int)(sizeof(videoPacketSizes) / sizeof(videoPacketSizes[0])); i++) {
+        ret = benchVideoBatch(videoPacketSizes[i]) && ret;
+    }
+
+    ret = benchSingleMessages("CBC audio decrypt", decryptAudioPacket,
+                              ALGORITHM_AES_CBC, CIPHER_FLAG_RESET_IV | CIPHER_FLAG_FINISH,
+                              true, AUDIO_PACKET_LENGTH) && ret;
+
+    ret = benchSingleMessages("GCM control encrypt", encryptControlMessage,
+                              ALGORITHM_AES_GCM, 0, false, CONTROL_MESSAGE_LENGTH) && ret;
+    ret = benchSingleMessages("GCM control decrypt", decryptControlMessage,
+                              ALGORITHM_AES_GCM, 0, true, CONTROL_MESSAGE_LENGTH) && ret;
+
+    return ret ? 0 : 1;
+}
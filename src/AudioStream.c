@@ -13,6 +13,8 @@ static PPLT_CRYPTO_CONTEXT audioDecryptionCtx;
 static uint32_t avRiKeyId;
 
 static unsigned short lastSeq;
+static uint32_t playoutRtpTimestamp;
+static uint32_t submittedRtpTimestamp;
 
 static bool pingThreadStarted;
 static bool receivedDataFromPeer;
@@ -35,6 +37,88 @@ typedef struct _QUEUED_AUDIO_PACKET {
     char data[MAX_PACKET_SIZE];
 } QUEUED_AUDIO_PACKET, *PQUEUED_AUDIO_PACKET;
 
+// Audio packet buffers are preallocated and recycled through this free list to avoid
+// a malloc() and free() for each packet. The pool covers a full packet queue plus the
+// packets being handled by the receive and decoder threads. If it runs dry, we fall
+// back to heap allocations. The free list is a lock-free ring, since packets are
+// returned by the decoder thread and taken by the receive thread.
+#define AUDIO_PACKET_POOL_SIZE 36
+static PQUEUED_AUDIO_PACKET packetPool;
+static MPMC_RING_QUEUE packetFreeList;
+
+// The jitter buffer target is a multiple of the inter-arrival jitter plus an adjustment
+// that is raised or lowered by one frame each window depending on the underrun rate.
+#define AUDIO_JB_JITTER_MULTIPLIER 4
+#define AUDIO_JB_WINDOW_MS 1000
+#define AUDIO_JB_MAX_UNDERRUN_PERMILLE 5
+#define AUDIO_JB_MAX_TARGET_MS 100
+
+// Number of frames above the target we allow before dropping
+#define AUDIO_JB_HYSTERESIS_FRAMES 2
+
+// Minimum number of packets between latency drops to keep them from being audible
+#define AUDIO_JB_DROP_INTERVAL_PACKETS 8
+
+// Gaps longer than this are pauses in the audio stream rather than jitter
+#define AUDIO_JB_MAX_STALL_MS 500
+
+// Only accessed by the receive thread
+static int64_t scaledJitterUs;
+static uint64_t lastArrivalTimeUs;
+static uint32_t lastArrivalRtpTimestamp;
+static int packetsSinceLastDrop;
+
+// Only accessed by the decoder thread
+static int underrunAdjustFrames;
+static int windowFrames;
+static int windowUnderruns;
+
+// Each of these is only written by one thread, but they're read by the other
+// thread and by LiGetAudioJitterBufferStats(), so they're accessed atomically.
+static volatile uint32_t interarrivalJitterUs; // receive thread
+static volatile uint32_t framesDroppedLatency; // receive thread
+static volatile uint32_t framesDroppedOverflow; // receive thread
+static volatile uint32_t targetDelayMs; // decoder thread
+static volatile uint32_t underruns; // decoder thread
+
+// The clock drift estimator takes the minimum offset between the local receive time and the
+// RTP timestamp in each window, which filters out queuing delays on the network. The drift is
+// the median slope between pairs of those minimums, which rejects any remaining outliers.
+#define AUDIO_DRIFT_WINDOW_MS 10000
+#define AUDIO_DRIFT_WINDOW_COUNT 12
+#define AUDIO_DRIFT_MIN_WINDOWS 3
+
+// A jump in transit time larger than this is a discontinuity in the host's timeline
+// rather than network delay. The window it lands in is discarded and later offsets
+// are rebased across the jump, so the windows we already have stay usable.
+#define AUDIO_DRIFT_MAX_TRANSIT_JUMP_MS 200
+
+typedef struct _AUDIO_DRIFT_SAMPLE {
+    int64_t hostTimeMs;
+    int64_t offsetUs;
+} AUDIO_DRIFT_SAMPLE, *PAUDIO_DRIFT_SAMPLE;
+
+// Only accessed by the receive thread
+static AUDIO_DRIFT_SAMPLE driftSamples[AUDIO_DRIFT_WINDOW_COUNT];
+static int driftSampleCount;
+static int driftSampleIndex;
+static AUDIO_DRIFT_SAMPLE driftWindowMin;
+static int64_t driftWindowStartMs;
+static int64_t extendedRtpTimestamp;
+static int64_t lastDriftOffsetUs;
+static int64_t driftRebaseUs;
+static bool driftTimelineStarted;
+
+// Published to LiGetAudioClockDrift() under the sequence lock. The
+// sequence is odd while the receive thread is updating these values.
+static volatile uint32_t driftEstimateSequence;
+static float estimatedDriftPpm;
+static bool driftEstimateValid;
+
+// Maximum number of frames passed to a single decodeAndPlaySamples() call
+#define AUDIO_MAX_BATCH_SIZE 8
+static unsigned char batchDecryptBuffers[AUDIO_MAX_BATCH_SIZE][ROUND_TO_PKCS7_PADDED_LEN(MAX_PACKET_SIZE)];
+
 static void AudioPingThreadProc(void* context) {
     char legacyPingData[] = { 0x50, 0x49, 0x4E, 0x47 };
     LC_SOCKADDR saddr;
@@ -64,15 +148,62 @@ static void AudioPingThreadProc(void* context) {
     }
 }
 
+static void resetDriftEstimator(void) {
+    driftSampleCount = 0;
+    driftSampleIndex = 0;
+    driftRebaseUs = 0;
+    driftTimelineStarted = false;
+}
+
+static void publishDriftEstimate(float driftPpm, bool valid) {
+    PltAtomicAdd32(&driftEstimateSequence, 1);
+    estimatedDriftPpm = driftPpm;
+    driftEstimateValid = valid;
+    PltAtomicAdd32(&driftEstimateSequence, 1);
+}
+
 // Initialize the audio stream and start
 int initializeAudioStream(void) {
+    int err;
+
+    err = MrqInitializeQueue(&packetFreeList, AUDIO_PACKET_POOL_SIZE);
+    if (err != 0) {
+        return err;
+    }
+
     LbqInitializeLinkedBlockingQueue(&packetQueue, 30);
     RtpaInitializeQueue(&rtpAudioQueue);
+
+    interarrivalJitterUs = 0;
+    framesDroppedLatency = 0;
+    framesDroppedOverflow = 0;
+    targetDelayMs = 0;
+    underruns = 0;
+    scaledJitterUs = 0;
+    lastArrivalTimeUs = 0;
+    lastArrivalRtpTimestamp = 0;
+    packetsSinceLastDrop = 0;
+    underrunAdjustFrames = 0;
+    windowFrames = 0;
+    windowUnderruns = 0;
+    resetDriftEstimator();
+    resetPresentationClock(PRESENTATION_CLOCK_AUDIO);
+    publishDriftEstimate(0, false);
+
+    packetPool = (PQUEUED_AUDIO_PACKET)malloc(AUDIO_PACKET_POOL_SIZE * sizeof(*packetPool));
+    if (packetPool != NULL) {
+        for (int i = 0; i < AUDIO_PACKET_POOL_SIZE; i++) {
+            MrqOfferQueueItem(&packetFreeList, &packetPool[i]);
+        }
+    }
     lastSeq = 0;
+    playoutRtpTimestamp = 0;
+    submittedRtpTimestamp = 0;
     receivedDataFromPeer = false;
     pingThreadStarted = false;
     firstReceiveTime = 0;
     audioDecryptionCtx = PltCreateCryptoContext();
+    PltSetCryptoContextStatsType(audioDecryptionCtx, CRYPTO_STATS_TYPE_AUDIO);
 #ifdef LC_DEBUG
     opusHeaderByte = INVALID_OPUS_HEADER;
 #endif
@@ -109,6 +240,34 @@ int notifyAudioPortNegotiationComplete(void) {
     return 0;
 }
 
+static bool isPooledPacket(PQUEUED_AUDIO_PACKET packet) {
+    return packetPool != NULL &&
+        (uintptr_t)packet >= (uintptr_t)&packetPool[0] &&
+        (uintptr_t)packet < (uintptr_t)&packetPool[AUDIO_PACKET_POOL_SIZE];
+}
+
+// This must only be called by the receive thread
+static PQUEUED_AUDIO_PACKET allocatePacket(void) {
+    PQUEUED_AUDIO_PACKET packet;
+
+    if (MrqPollQueueElement(&packetFreeList, (void**)&packet) == LBQ_SUCCESS) {
+        return packet;
+    }
+
+    rtpAudioQueue.stats.packetPoolExhausted++;
+    return (PQUEUED_AUDIO_PACKET)malloc(sizeof(*packet));
+}
+
+static void freePacket(PQUEUED_AUDIO_PACKET packet) {
+    if (isPooledPacket(packet)) {
+        // The pool always has room for all of its own packets
+        MrqOfferQueueItem(&packetFreeList, packet);
+    }
+    else {
+        free(packet);
+    }
+}
+
 static void freePacketList(PLINKED_BLOCKING_QUEUE_ENTRY entry) {
     PLINKED_BLOCKING_QUEUE_ENTRY nextEntry;
 
@@ -116,7 +275,7 @@ static void freePacketList(PLINKED_BLOCKING_QUEUE_ENTRY entry) {
         nextEntry = entry->flink;
 
         // The entry is stored within the data allocation
-        free(entry->data);
+        freePacket((PQUEUED_AUDIO_PACKET)entry->data);
 
         entry = nextEntry;
     }
@@ -124,6 +283,8 @@ static void freePacketList(PLINKED_BLOCKING_QUEUE_ENTRY entry) {
 
 // Tear down the audio stream once we're done with it
 void destroyAudioStream(void) {
+    void* data;
+
     if (rtpSocket != INVALID_SOCKET) {
         if (pingThreadStarted) {
             PltInterruptThread(&udpPingThread);
@@ -137,11 +298,220 @@ void destroyAudioStream(void) {
     PltDestroyCryptoContext(audioDecryptionCtx);
     freePacketList(LbqDestroyLinkedBlockingQueue(&packetQueue));
     RtpaCleanupQueue(&rtpAudioQueue);
+
+    // Pooled packets are freed with the pool itself
+    while (MrqReclaimQueueElement(&packetFreeList, &data)) {
+        LC_ASSERT(isPooledPacket((PQUEUED_AUDIO_PACKET)data));
+    }
+    MrqDestroyQueue(&packetFreeList);
+    free(packetPool);
+    packetPool = NULL;
+}
+
+// Updates the RFC 3550 inter-arrival jitter estimate with a newly received audio packet
+static void updateJitterEstimate(PRTP_PACKET rtp, uint64_t arrivalTimeUs) {
+    if (lastArrivalTimeUs != 0) {
+        int32_t timestampDeltaMs = (int32_t)(rtp->timestamp - lastArrivalRtpTimestamp);
+        uint64_t arrivalDeltaUs = arrivalTimeUs - lastArrivalTimeUs;
+
+        // Ignore duplicate and out of order packets
+        if (timestampDeltaMs <= 0) {
+            return;
+        }
+
+        // Don't let a pause in the audio stream count as jitter
+        if (arrivalDeltaUs < AUDIO_JB_MAX_STALL_MS * 1000) {
+            // D(i-1,i) is the difference in relative transit times. Our RTP clock is in milliseconds.
+            int64_t transitDeltaUs = (int64_t)arrivalDeltaUs - ((int64_t)timestampDeltaMs * 1000);
+            if (transitDeltaUs < 0) {
+                transitDeltaUs = -transitDeltaUs;
+            }
+
+            // J(i) = J(i-1) + (|D(i-1,i)| - J(i-1))/16, which we keep scaled by 16
+            scaledJitterUs += transitDeltaUs - ((scaledJitterUs + 8) >> 4);
+            PltAtomicStore32(&interarrivalJitterUs, (uint32_t)(scaledJitterUs >> 4));
+        }
+    }
+
+    lastArrivalTimeUs = arrivalTimeUs;
+    lastArrivalRtpTimestamp = rtp->timestamp;
+}
+
+static void computeDriftEstimate(void) {
+    float slopes[AUDIO_DRIFT_WINDOW_COUNT * (AUDIO_DRIFT_WINDOW_COUNT - 1) / 2];
+    int slopeCount = 0;
+    float driftPpm;
+
+    // Collect the slope between each pair of windows
+    for (int i = 0; i < driftSampleCount; i++) {
+        for (int j = i + 1; j < driftSampleCount; j++) {
+            int64_t hostDeltaMs = driftSamples[j].hostTimeMs - driftSamples[i].hostTimeMs;
+            if (hostDeltaMs != 0) {
+                // Microseconds of offset per millisecond of host time is 1000 ppm
+                slopes[slopeCount++] = (float)(driftSamples[j].offsetUs - driftSamples[i].offsetUs) * 1000.0f / (float)hostDeltaMs;
+            }
+        }
+    }
+
+    if (slopeCount == 0) {
+        return;
+    }
+
+    // Sort the slopes to find the median
+    for (int i = 1; i < slopeCount; i++) {
+        float slope = slopes[i];
+        int j = i - 1;
+
+        while (j >= 0 && slopes[j] > slope) {
+            slopes[j + 1] = slopes[j];
+            j--;
+        }
+        slopes[j + 1] = slope;
+    }
+
+    if (slopeCount % 2 == 0) {
+        driftPpm = (slopes[slopeCount / 2 - 1] + slopes[slopeCount / 2]) / 2;
+    }
+    else {
+        driftPpm = slopes[slopeCount / 2];
+    }
+    publishDriftEstimate(driftPpm, true);
+}
+
+// Updates the clock drift estimate with a newly received audio packet
+static void updateDriftEstimate(PRTP_PACKET rtp, uint64_t arrivalTimeUs) {
+    int64_t offsetUs;
+
+    if (!driftTimelineStarted) {
+        extendedRtpTimestamp = rtp->timestamp;
+        driftWindowStartMs = extendedRtpTimestamp;
+        driftWindowMin.hostTimeMs = extendedRtpTimestamp;
+        driftWindowMin.offsetUs = (int64_t)arrivalTimeUs - (extendedRtpTimestamp * 1000);
+        lastDriftOffsetUs = driftWindowMin.offsetUs;
+        driftTimelineStarted = true;
+        return;
+    }
+
+    // Ignore duplicate and out of order packets
+    int32_t timestampDeltaMs = (int32_t)(rtp->timestamp - (uint32_t)extendedRtpTimestamp);
+    if (timestampDeltaMs <= 0) {
+        return;
+    }
+
+    extendedRtpTimestamp += timestampDeltaMs;
+    offsetUs = (int64_t)arrivalTimeUs - (extendedRtpTimestamp * 1000) - driftRebaseUs;
+
+    // If the host's timestamps jumped relative to our clock, absorb the jump into the
+    // rebase offset and throw away the window it landed in. A single delayed packet
+    // causes a jump in each direction, which cancel out.
+    if (offsetUs - lastDriftOffsetUs > AUDIO_DRIFT_MAX_TRANSIT_JUMP_MS * 1000 ||
+            lastDriftOffsetUs - offsetUs > AUDIO_DRIFT_MAX_TRANSIT_JUMP_MS * 1000) {
+        Limelog("Audio timeline discontinuity detected; discarding current clock drift window\n");
+        driftRebaseUs += offsetUs - lastDriftOffsetUs;
+        offsetUs = lastDriftOffsetUs;
+
+        driftWindowStartMs = extendedRtpTimestamp;
+        driftWindowMin.hostTimeMs = extendedRtpTimestamp;
+        driftWindowMin.offsetUs = offsetUs;
+        resetPresentationClock(PRESENTATION_CLOCK_AUDIO);
+        return;
+    }
+    lastDriftOffsetUs = offsetUs;
+
+    if (offsetUs < driftWindowMin.offsetUs) {
+        driftWindowMin.hostTimeMs = extendedRtpTimestamp;
+        driftWindowMin.offsetUs = offsetUs;
+    }
+
+    if (extendedRtpTimestamp - driftWindowStartMs >= AUDIO_DRIFT_WINDOW_MS) {
+        // Store this window's minimum, replacing the oldest one if we're full
+        driftSamples[driftSampleIndex] = driftWindowMin;
+        driftSampleIndex = (driftSampleIndex + 1) % AUDIO_DRIFT_WINDOW_COUNT;
+        if (driftSampleCount < AUDIO_DRIFT_WINDOW_COUNT) {
+            driftSampleCount++;
+        }
+
+        if (driftSampleCount >= AUDIO_DRIFT_MIN_WINDOWS) {
+            computeDriftEstimate();
+        }
+
+        // Start the next window with this packet
+        driftWindowStartMs = extendedRtpTimestamp;
+        driftWindowMin.hostTimeMs = extendedRtpTimestamp;
+        driftWindowMin.offsetUs = offsetUs;
+    }
+}
+
+static void updateJitterBufferTarget(void) {
+    int jitterMs = (int)((PltAtomicLoad32(&interarrivalJitterUs) * AUDIO_JB_JITTER_MULTIPLIER + 999) / 1000);
+    int targetFrames = (jitterMs + AudioPacketDuration - 1) / AudioPacketDuration + underrunAdjustFrames;
+
+    if (targetFrames < 1) {
+        targetFrames = 1;
+    }
+    else if (targetFrames * AudioPacketDuration > AUDIO_JB_MAX_TARGET_MS) {
+        targetFrames = AUDIO_JB_MAX_TARGET_MS / AudioPacketDuration;
+    }
+
+    PltAtomicStore32(&targetDelayMs, (uint32_t)(targetFrames * AudioPacketDuration));
+}
+
+// Called by the decoder thread for each frame it takes from the queue
+static void trackJitterBufferPlayout(bool waitedForPacket, uint64_t waitTimeUs) {
+    // If we waited for longer than the target delay would have covered, the renderer would have run dry
+    if (waitedForPacket &&
+            waitTimeUs > (uint64_t)(targetDelayMs + AudioPacketDuration) * 1000 &&
+            waitTimeUs < AUDIO_JB_MAX_STALL_MS * 1000) {
+        PltAtomicStore32(&underruns, underruns + 1);
+        windowUnderruns++;
+    }
+
+    windowFrames++;
+    if (windowFrames * AudioPacketDuration >= AUDIO_JB_WINDOW_MS) {
+        if (windowUnderruns * 1000 > windowFrames * AUDIO_JB_MAX_UNDERRUN_PERMILLE) {
+            // Too many underruns, so add a frame of delay
+            if (underrunAdjustFrames * AudioPacketDuration < AUDIO_JB_MAX_TARGET_MS) {
+                underrunAdjustFrames++;
+            }
+        }
+        else if (windowUnderruns == 0 && underrunAdjustFrames > 0) {
+            // No underruns, so try a frame less delay
+            underrunAdjustFrames--;
+        }
+
+        updateJitterBufferTarget();
+
+        windowFrames = 0;
+        windowUnderruns = 0;
+    }
+}
+
+static bool dropOldestQueuedPacket(void) {
+    PQUEUED_AUDIO_PACKET packet;
+
+    if (LbqPollQueueElement(&packetQueue, (void**)&packet) != LBQ_SUCCESS) {
+        return false;
+    }
+
+    freePacket(packet);
+    return true;
 }
 
 static bool queuePacketToLbq(PQUEUED_AUDIO_PACKET* packet) {
     int err;
 
+    // If too much audio is pending, shrink the queue towards the target one frame at a time
+    if (packetsSinceLastDrop < AUDIO_JB_DROP_INTERVAL_PACKETS) {
+        packetsSinceLastDrop++;
+    }
+    else if (LbqGetItemCount(&packetQueue) * AudioPacketDuration >
+                 (int)PltAtomicLoad32(&targetDelayMs) + (AUDIO_JB_HYSTERESIS_FRAMES * AudioPacketDuration)) {
+        if (dropOldestQueuedPacket()) {
+            PltAtomicStore32(&framesDroppedLatency, framesDroppedLatency + 1);
+            packetsSinceLastDrop = 0;
+        }
+    }
+
     do {
         err = LbqOfferQueueItem(&packetQueue, *packet, &(*packet)->header.lentry);
         if (err == LBQ_SUCCESS) {
@@ -149,26 +519,37 @@ static bool queuePacketToLbq(PQUEUED_AUDIO_PACKET* packet) {
             *packet = NULL;
         }
         else if (err == LBQ_BOUND_EXCEEDED) {
-            Limelog("Audio packet queue overflow\n");
+            // Don't spam the log if the renderer is stalled
+            if (framesDroppedOverflow % 100 == 0) {
+                Limelog("Audio packet queue overflow\n");
+            }
+            PltAtomicStore32(&framesDroppedOverflow, framesDroppedOverflow + 1);
 
-            // The audio queue is full, so free all existing items and try again
-            freePacketList(LbqFlushQueueItems(&packetQueue));
+            // The audio queue is full, so drop the oldest frame and try again
+            dropOldestQueuedPacket();
         }
     } while (err == LBQ_BOUND_EXCEEDED);
 
     return err == LBQ_SUCCESS;
 }
 
-static void decodeInputData(PQUEUED_AUDIO_PACKET packet) {
+// Returns the Opus data for this packet in sampleData and sampleLength, decrypting it into
+// decryptedOpusData if necessary. Lost packets return NULL sampleData for packet loss concealment.
+// decryptedOpusData must have room for ROUND_TO_PKCS7_PADDED_LEN(MAX_PACKET_SIZE) bytes.
+// playoutRtpTimestamp always tracks the newest sample, so lost packets follow on from it.
+static bool getOpusData(PQUEUED_AUDIO_PACKET packet, unsigned char* decryptedOpusData, char** sampleData, int* sampleLength) {
     // If the packet size is zero, this is a placeholder for a missing
     // packet. Trigger packet loss concealment logic in libopus by
     // invoking the decoder with a NULL buffer.
     if (packet->header.size == 0) {
-        AudioCallbacks.decodeAndPlaySample(NULL, 0);
-        return;
+        playoutRtpTimestamp += AudioPacketDuration;
+        *sampleData = NULL;
+        *sampleLength = 0;
+        return true;
     }
 
     PRTP_PACKET rtp = (PRTP_PACKET)&packet->data[0];
+    playoutRtpTimestamp = rtp->timestamp;
     if (lastSeq != 0 && (unsigned short)(lastSeq + 1) != rtp->sequenceNumber) {
         Limelog("Network dropped audio data (expected %d, but received %d)\n", lastSeq + 1, rtp->sequenceNumber);
     }
@@ -177,7 +558,6 @@ static void decodeInputData(PQUEUED_AUDIO_PACKET packet) {
 
     if (AudioEncryptionEnabled) {
         // We must have room for the AES padding which may be written to the buffer
-        unsigned char decryptedOpusData[ROUND_TO_PKCS7_PADDED_LEN(MAX_PACKET_SIZE)];
         unsigned char iv[16] = { 0 };
         int dataLength = packet->header.size - sizeof(*rtp);
 
@@ -197,42 +577,82 @@ static void decodeInputData(PQUEUED_AUDIO_PACKET packet) {
                                decryptedOpusData, &dataLength)) {
             Limelog("Failed to decrypt audio packet (sequence number: %u)\n", rtp->sequenceNumber);
             LC_ASSERT_VT(false);
-            return;
+            return false;
         }
 
+        *sampleData = (char*)decryptedOpusData;
+        *sampleLength = dataLength;
+    }
+    else {
+        *sampleData = (char*)(rtp + 1);
+        *sampleLength = packet->header.size - sizeof(*rtp);
+    }
+
 #ifdef LC_DEBUG
-        if (opusHeaderByte == INVALID_OPUS_HEADER) {
-            opusHeaderByte = decryptedOpusData[0];
-            LC_ASSERT_VT(opusHeaderByte != INVALID_OPUS_HEADER);
-        }
-        else {
-            // Opus header should stay constant for the entire stream.
-            // If it doesn't, it may indicate that the RtpAudioQueue
-            // incorrectly recovered a data shard or the decryption
-            // of the audio packet failed. Sunshine violates this for
-            // surround sound in some cases, so just ignore it.
-            LC_ASSERT_VT(decryptedOpusData[0] == opusHeaderByte || IS_SUNSHINE());
-        }
+    if (opusHeaderByte == INVALID_OPUS_HEADER) {
+        opusHeaderByte = ((uint8_t*)*sampleData)[0];
+        LC_ASSERT_VT(opusHeaderByte != INVALID_OPUS_HEADER);
+    }
+    else {
+        // Opus header should stay constant for the entire stream.
+        // If it doesn't, it may indicate that the RtpAudioQueue
+        // incorrectly recovered a data shard or the decryption
+        // of the audio packet failed. Sunshine violates this for
+        // surround sound in some cases, so just ignore it.
+        LC_ASSERT_VT(((uint8_t*)*sampleData)[0] == opusHeaderByte || IS_SUNSHINE());
+    }
 #endif
 
-        AudioCallbacks.decodeAndPlaySample((char*)decryptedOpusData, dataLength);
+    return true;
+}
+
+static void decodeInputData(PQUEUED_AUDIO_PACKET packet) {
+    unsigned char decryptedOpusData[ROUND_TO_PKCS7_PADDED_LEN(MAX_PACKET_SIZE)];
+    char* sampleData;
+    int sampleLength;
+
+    if (getOpusData(packet, decryptedOpusData, &sampleData, &sampleLength)) {
+        submittedRtpTimestamp = playoutRtpTimestamp;
+        AudioCallbacks.decodeAndPlaySample(sampleData, sampleLength);
     }
-    else {
-#ifdef LC_DEBUG
-        if (opusHeaderByte == INVALID_OPUS_HEADER) {
-            opusHeaderByte = ((uint8_t*)(rtp + 1))[0];
-            LC_ASSERT_VT(opusHeaderByte != INVALID_OPUS_HEADER);
-        }
-        else {
-            // Opus header should stay constant for the entire stream.
-            // If it doesn't, it may indicate that the RtpAudioQueue
-            // incorrectly recovered a data shard. Sunshine violates
-            // this for surround sound in some cases, so just ignore it.
-            LC_ASSERT_VT(((uint8_t*)(rtp + 1))[0] == opusHeaderByte || IS_SUNSHINE());
+}
+
+// Drains the packets that are already queued behind firstPacket and submits them
+// to the renderer in a single call. This frees all of the packets.
+static void decodeInputBatch(PQUEUED_AUDIO_PACKET firstPacket) {
+    PQUEUED_AUDIO_PACKET packets[AUDIO_MAX_BATCH_SIZE];
+    AUDIO_SAMPLE_ENTRY samples[AUDIO_MAX_BATCH_SIZE];
+    int packetCount = 0;
+    int sampleCount = 0;
+
+    packets[packetCount++] = firstPacket;
+    while (packetCount < AUDIO_MAX_BATCH_SIZE &&
+           LbqPollQueueElement(&packetQueue, (void**)&packets[packetCount]) == LBQ_SUCCESS) {
+        trackJitterBufferPlayout(false, 0);
+        packetCount++;
+    }
+
+    uint32_t firstRtpTimestamp = 0;
+    for (int i = 0; i < packetCount; i++) {
+        if (getOpusData(packets[i], batchDecryptBuffers[sampleCount],
+                        &samples[sampleCount].sampleData, &samples[sampleCount].sampleLength)) {
+            if (sampleCount == 0) {
+                firstRtpTimestamp = playoutRtpTimestamp;
+            }
+            sampleCount++;
         }
-#endif
+    }
 
-        AudioCallbacks.decodeAndPlaySample((char*)(rtp + 1), packet->header.size - sizeof(*rtp));
+    if (sampleCount > 0) {
+        // Report the timestamp of the first sample in the batch, but keep
+        // playoutRtpTimestamp at the last one for the next batch
+        submittedRtpTimestamp = firstRtpTimestamp;
+        AudioCallbacks.decodeAndPlaySamples(samples, sampleCount);
+    }
+
+    // The sample data may point into the packets, so we can only free them now
+    for (int i = 0; i < packetCount; i++) {
+        freePacket(packets[i]);
     }
 }
 
@@ -243,6 +663,7 @@ static void AudioReceiveThreadProc(void* context) {
     bool useSelect;
     uint32_t packetsToDrop;
     int waitingForAudioMs;
+    uint64_t arrivalTimeUs;
 
     packet = NULL;
     packetsToDrop = 500 / AudioPacketDuration;
@@ -259,7 +680,7 @@ static void AudioReceiveThreadProc(void* context) {
     waitingForAudioMs = 0;
     while (!PltIsThreadInterrupted(&receiveThread)) {
         if (packet == NULL) {
-            packet = (PQUEUED_AUDIO_PACKET)malloc(sizeof(*packet));
+            packet = allocatePacket();
             if (packet == NULL) {
                 Limelog("Audio Receive: malloc() failed\n");
                 ListenerCallbacks.connectionTerminated(-1);
@@ -268,6 +689,7 @@ static void AudioReceiveThreadProc(void* context) {
         }
 
         packet->header.size = recvUdpSocket(rtpSocket, &packet->data[0], MAX_PACKET_SIZE, useSelect);
+        arrivalTimeUs = PltGetMicroseconds();
         if (packet->header.size < 0) {
             Limelog("Audio Receive: recvUdpSocket() failed: %d\n", (int)LastSocketError());
             ListenerCallbacks.connectionTerminated(LastSocketFail());
@@ -322,6 +744,16 @@ static void AudioReceiveThreadProc(void* context) {
         rtp->timestamp = BE32(rtp->timestamp);
         rtp->ssrc = BE32(rtp->ssrc);
 
+        if (rtp->packetType == 97) {
+            updateJitterEstimate(rtp, arrivalTimeUs);
+            updateDriftEstimate(rtp, arrivalTimeUs);
+            if (driftTimelineStarted) {
+                // Extend this packet's timestamp relative to the newest one, since it may be out of order
+                uint64_t hostTimeMs = extendedRtpTimestamp + (int32_t)(rtp->timestamp - (uint32_t)extendedRtpTimestamp);
+                addPresentationClockSample(PRESENTATION_CLOCK_AUDIO, hostTimeMs * 1000, arrivalTimeUs);
+            }
+        }
+
         queueStatus = RtpaAddPacket(&rtpAudioQueue, (PRTP_PACKET)&packet->data[0], (uint16_t)packet->header.size);
         if (RTPQ_HANDLE_NOW(queueStatus)) {
             if ((AudioCallbacks.capabilities & CAPABILITY_DIRECT_SUBMIT) == 0) {
@@ -347,15 +779,27 @@ static void AudioReceiveThreadProc(void* context) {
             if (RTPQ_PACKET_READY(queueStatus)) {
                 // If packets are ready, pull them and send them to the decoder
                 uint16_t length;
-                PQUEUED_AUDIO_PACKET queuedPacket;
-                while ((queuedPacket = (PQUEUED_AUDIO_PACKET)RtpaGetQueuedPacket(&rtpAudioQueue, sizeof(QUEUED_AUDIO_PACKET_HEADER), &length)) != NULL) {
+                PQUEUED_AUDIO_PACKET queuedPacket = NULL;
+                bool exiting = false;
+                for (;;) {
+                    if (queuedPacket == NULL) {
+                        queuedPacket = allocatePacket();
+                        if (queuedPacket == NULL) {
+                            break;
+                        }
+                    }
+
+                    if (!RtpaGetQueuedPacket(&rtpAudioQueue, (PRTP_PACKET)&queuedPacket->data[0], MAX_PACKET_SIZE, &length)) {
+                        break;
+                    }
+
                     // Populate header data (not preserved in queued packets)
                     queuedPacket->header.size = length;
 
                     if ((AudioCallbacks.capabilities & CAPABILITY_DIRECT_SUBMIT) == 0) {
                         if (!queuePacketToLbq(&queuedPacket)) {
                             // An exit signal was received
-                            free(queuedPacket);
+                            exiting = true;
                             break;
                         }
                         else {
@@ -364,13 +808,17 @@ static void AudioReceiveThreadProc(void* context) {
                         }
                     }
                     else {
+                        // The buffer can be reused for the next packet
                         decodeInputData(queuedPacket);
-                        free(queuedPacket);
                     }
                 }
 
-                // Break on exit
                 if (queuedPacket != NULL) {
+                    freePacket(queuedPacket);
+                }
+
+                // Break on exit
+                if (exiting) {
                     break;
                 }
             }
@@ -378,7 +826,7 @@ static void AudioReceiveThreadProc(void* context) {
     }
 
     if (packet != NULL) {
-        free(packet);
+        freePacket(packet);
     }
 }
 
@@ -387,15 +835,24 @@ static void AudioDecoderThreadProc(void* context) {
     PQUEUED_AUDIO_PACKET packet;
 
     while (!PltIsThreadInterrupted(&decoderThread)) {
+        bool queueWasEmpty = LbqGetItemCount(&packetQueue) == 0;
+        uint64_t waitStartUs = PltGetMicroseconds();
+
         err = LbqWaitForQueueElement(&packetQueue, (void**)&packet);
         if (err != LBQ_SUCCESS) {
             // An exit signal was received
             return;
         }
 
-        decodeInputData(packet);
+        trackJitterBufferPlayout(queueWasEmpty, PltGetMicroseconds() - waitStartUs);
 
-        free(packet);
+        if (AudioCallbacks.decodeAndPlaySamples != NULL) {
+            decodeInputBatch(packet);
+        }
+        else {
+            decodeInputData(packet);
+            freePacket(packet);
+        }
     }
 }
 
@@ -446,6 +903,9 @@ int startAudioStream(void* audioContext, int arFlags) {
 
     AudioCallbacks.start();
 
+    // The packet duration is known now that the RTSP handshake is complete
+    updateJitterBufferTarget();
+
     err = PltCreateThread("AudioRecv", AudioReceiveThreadProc, NULL, &receiveThread);
     if (err != 0) {
         AudioCallbacks.stop();
@@ -480,3 +940,39 @@ int LiGetPendingAudioDuration(void) {
 const RTP_AUDIO_STATS* LiGetRTPAudioStats(void) {
     return &rtpAudioQueue.stats;
 }
+
+void LiGetAudioJitterBufferStats(PAUDIO_JITTER_BUFFER_STATS stats) {
+    stats->interarrivalJitterUs = PltAtomicLoad32(&interarrivalJitterUs);
+    stats->targetDelayMs = PltAtomicLoad32(&targetDelayMs);
+    stats->underruns = PltAtomicLoad32(&underruns);
+    stats->framesDroppedLatency = PltAtomicLoad32(&framesDroppedLatency);
+    stats->framesDroppedOverflow = PltAtomicLoad32(&framesDroppedOverflow);
+}
+
+bool LiGetAudioClockDrift(float* driftPpm) {
+    uint32_t sequence;
+    float ppm;
+    bool valid;
+
+    do {
+        sequence = PltAtomicLoad32(&driftEstimateSequence);
+        if (sequence & 1) {
+            PltCpuRelax();
+            continue;
+        }
+
+        ppm = estimatedDriftPpm;
+        valid = driftEstimateValid;
+    } while ((sequence & 1) || PltAtomicLoad32(&driftEstimateSequence) != sequence);
+
+    if (!valid) {
+        return false;
+    }
+
+    *driftPpm = ppm;
+    return true;
+}
+
+uint32_t LiGetCurrentAudioRtpTimestamp(void) {
+    return submittedRtpTimestamp;
+}
@@ -0,0 +1,390 @@
+#include "Limelight-internal.h"
+
+// This is a receive-side delay gradient and loss based estimator modeled on
+// Google Congestion Control. Packets sharing an RTP timestamp (a video frame)
+// are sent by the host in one burst, so they form a packet group. A rising
+// trend in the difference between group arrival spacing and send spacing
+// means a queue is building somewhere on the path. Each group is timed by
+// the arrival of its first packet, since the spacing of later packets
+// depends on the frame size and would make every large frame (an IDR frame,
+// for example) look like a delay spike.
+
+// RTP packets use a 90 KHz presentation timestamp clock
+#define BWE_PTS_DIVISOR 90
+
+// Number of packet groups in the trendline regression window
+#define BWE_TRENDLINE_WINDOW 20
+
+// Smoothing applied to the accumulated delay before the regression
+#define BWE_TRENDLINE_SMOOTHING 0.9f
+
+// The trend is scaled by the number of deltas seen (up to this limit) and
+// by the gain below before being compared with the overuse threshold
+#define BWE_TRENDLINE_MAX_DELTAS 60
+#define BWE_TRENDLINE_GAIN 4.0f
+
+// Adaptive overuse threshold (in scaled ms) and its adaptation rates
+#define BWE_INITIAL_THRESHOLD 12.5f
+#define BWE_MIN_THRESHOLD 6.0f
+#define BWE_MAX_THRESHOLD 600.0f
+#define BWE_THRESHOLD_K_UP 0.0087f
+#define BWE_THRESHOLD_K_DOWN 0.039f
+#define BWE_MAX_THRESHOLD_ADAPT_STEP 15.0f
+
+// The trend must stay over the threshold this long to signal overuse
+#define BWE_OVERUSE_TIME_US 10000
+
+// Groups further apart than this are from a stall or pause in the stream,
+// which would otherwise look like a huge delay spike
+#define BWE_MAX_GROUP_GAP_US 1000000
+
+// Receive rate and loss are measured over windows of this length
+#define BWE_RATE_WINDOW_US 500000
+
+// On overuse, the estimate drops to this fraction of the receive rate
+#define BWE_DECREASE_FACTOR 0.85f
+
+// Don't decrease again until the previous decrease has had time to take effect
+#define BWE_DECREASE_INTERVAL_US 200000
+
+// Multiplicative increase per second while the path is not congested,
+// and the highest estimate relative to the measured receive rate
+#define BWE_INCREASE_PER_SEC 0.08f
+#define BWE_MAX_INCOMING_RATIO 1.5f
+
+// Loss above the high threshold reduces the estimate and signals congestion
+#define BWE_HIGH_LOSS_FRACTION 0.10f
+
+enum {
+    RATE_CONTROL_HOLD,
+    RATE_CONTROL_INCREASE,
+};
+
+typedef struct _BWE_TRENDLINE_SAMPLE {
+    float arrivalTimeMs;
+    float smoothedDelayMs;
+} BWE_TRENDLINE_SAMPLE, *PBWE_TRENDLINE_SAMPLE;
+
+// Only touched by the video receive thread
+static bool groupValid;
+static uint32_t groupRtpTimestamp;
+static uint64_t groupArrivalUs;
+static bool prevGroupValid;
+static uint32_t prevGroupRtpTimestamp;
+static uint64_t prevGroupArrivalUs;
+
+static BWE_TRENDLINE_SAMPLE trendlineSamples[BWE_TRENDLINE_WINDOW];
+static int trendlineSampleCount;
+static int trendlineNextSample;
+static uint32_t trendlineDeltaCount;
+static uint64_t trendlineFirstArrivalUs;
+static float accumulatedDelayMs;
+static float smoothedDelayMs;
+static float previousTrend;
+
+static float overuseThreshold;
+static uint64_t lastThresholdUpdateUs;
+static uint64_t overuseStartUs;
+static uint32_t overuseCount;
+static int delayState;
+
+static uint64_t rateWindowStartUs;
+static uint64_t rateWindowBytes;
+static uint32_t rateWindowPackets;
+static uint32_t rateWindowFirstSeq;
+static uint32_t highestSeq;
+static bool seqValid;
+static uint32_t incomingBps;
+static float lossFraction;
+
+static int rateControlState;
+static float estimatedBps;
+static uint64_t lastRateUpdateUs;
+static uint64_t lastDecreaseUs;
+
+// Read by LiGetBandwidthEstimate() without synchronization
+static BANDWIDTH_ESTIMATE currentEstimate;
+
+static void resetTrendline(void) {
+    trendlineSampleCount = 0;
+    trendlineNextSample = 0;
+    trendlineDeltaCount = 0;
+    accumulatedDelayMs = 0;
+    smoothedDelayMs = 0;
+    previousTrend = 0;
+    overuseStartUs = 0;
+    overuseCount = 0;
+    delayState = LI_CONGESTION_NORMAL;
+}
+
+void resetBandwidthEstimator(void) {
+    groupValid = false;
+    prevGroupValid = false;
+    resetTrendline();
+
+    overuseThreshold = BWE_INITIAL_THRESHOLD;
+    lastThresholdUpdateUs = 0;
+
+    rateWindowStartUs = 0;
+    rateWindowBytes = 0;
+    rateWindowPackets = 0;
+    seqValid = false;
+    incomingBps = 0;
+    lossFraction = 0;
+
+    rateControlState = RATE_CONTROL_HOLD;
+    estimatedBps = 0;
+    lastRateUpdateUs = 0;
+    lastDecreaseUs = 0;
+
+    memset(&currentEstimate, 0, sizeof(currentEstimate));
+}
+
+// Least squares slope of smoothed delay against arrival time
+static float getTrendlineSlope(void) {
+    float meanX = 0, meanY = 0;
+    float numerator = 0, denominator = 0;
+
+    for (int i = 0; i < trendlineSampleCount; i++) {
+        meanX += trendlineSamples[i].arrivalTimeMs;
+        meanY += trendlineSamples[i].smoothedDelayMs;
+    }
+    meanX /= trendlineSampleCount;
+    meanY /= trendlineSampleCount;
+
+    for (int i = 0; i < trendlineSampleCount; i++) {
+        float dx = trendlineSamples[i].arrivalTimeMs - meanX;
+        numerator += dx * (trendlineSamples[i].smoothedDelayMs - meanY);
+        denominator += dx * dx;
+    }
+
+    return denominator != 0 ? numerator / denominator : 0;
+}
+
+static void updateOveruseThreshold(float absTrend, uint64_t nowUs) {
+    float elapsedMs;
+
+    if (lastThresholdUpdateUs == 0) {
+        lastThresholdUpdateUs = nowUs;
+    }
+
+    // Don't let a sudden spike drag the threshold along with it
+    if (absTrend > overuseThreshold + BWE_MAX_THRESHOLD_ADAPT_STEP) {
+        lastThresholdUpdateUs = nowUs;
+        return;
+    }
+
+    elapsedMs = (nowUs - lastThresholdUpdateUs) / 1000.0f;
+    if (elapsedMs > 100) {
+        elapsedMs = 100;
+    }
+    lastThresholdUpdateUs = nowUs;
+
+    overuseThreshold += (absTrend < overuseThreshold ? BWE_THRESHOLD_K_DOWN : BWE_THRESHOLD_K_UP) *
+        (absTrend - overuseThreshold) * elapsedMs;
+    if (overuseThreshold < BWE_MIN_THRESHOLD) {
+        overuseThreshold = BWE_MIN_THRESHOLD;
+    }
+    else if (overuseThreshold > BWE_MAX_THRESHOLD) {
+        overuseThreshold = BWE_MAX_THRESHOLD;
+    }
+}
+
+static void detectOveruse(float trend, uint64_t nowUs) {
+    uint32_t deltas = trendlineDeltaCount < BWE_TRENDLINE_MAX_DELTAS ? trendlineDeltaCount : BWE_TRENDLINE_MAX_DELTAS;
+    float modifiedTrend = deltas * trend * BWE_TRENDLINE_GAIN;
+
+    if (modifiedTrend > overuseThreshold) {
+        if (overuseStartUs == 0) {
+            overuseStartUs = nowUs;
+        }
+        overuseCount++;
+
+        if (nowUs - overuseStartUs >= BWE_OVERUSE_TIME_US && overuseCount > 1 && trend >= previousTrend) {
+            delayState = LI_CONGESTION_OVERUSE;
+        }
+    }
+    else if (modifiedTrend < -overuseThreshold) {
+        overuseStartUs = 0;
+        overuseCount = 0;
+        delayState = LI_CONGESTION_UNDERUSE;
+    }
+    else {
+        overuseStartUs = 0;
+        overuseCount = 0;
+        delayState = LI_CONGESTION_NORMAL;
+    }
+
+    previousTrend = trend;
+    updateOveruseThreshold(modifiedTrend < 0 ? -modifiedTrend : modifiedTrend, nowUs);
+
+    currentEstimate.delayTrend = modifiedTrend;
+    currentEstimate.overuseThreshold = overuseThreshold;
+}
+
+static void updateRateControl(uint64_t nowUs) {
+    float elapsedSec = lastRateUpdateUs != 0 ? (nowUs - lastRateUpdateUs) / 1000000.0f : 0;
+
+    lastRateUpdateUs = nowUs;
+
+    // We need a receive rate measurement before we have anything to base an estimate on
+    if (incomingBps == 0) {
+        return;
+    }
+    else if (estimatedBps == 0) {
+        estimatedBps = (float)incomingBps;
+    }
+
+    if (delayState == LI_CONGESTION_OVERUSE) {
+        if (nowUs - lastDecreaseUs >= BWE_DECREASE_INTERVAL_US) {
+            estimatedBps = BWE_DECREASE_FACTOR * incomingBps;
+            lastDecreaseUs = nowUs;
+        }
+        rateControlState = RATE_CONTROL_HOLD;
+    }
+    else if (delayState == LI_CONGESTION_UNDERUSE) {
+        // Queues are draining, so the receive rate is temporarily inflated
+        rateControlState = RATE_CONTROL_HOLD;
+    }
+    else if (rateControlState == RATE_CONTROL_HOLD) {
+        rateControlState = RATE_CONTROL_INCREASE;
+    }
+    else {
+        if (elapsedSec > 1.0f) {
+            elapsedSec = 1.0f;
+        }
+        estimatedBps *= 1.0f + BWE_INCREASE_PER_SEC * elapsedSec;
+    }
+
+    if (estimatedBps > BWE_MAX_INCOMING_RATIO * incomingBps) {
+        estimatedBps = BWE_MAX_INCOMING_RATIO * incomingBps;
+    }
+}
+
+static void publishEstimate(void) {
+    currentEstimate.estimatedKbps = (uint32_t)(estimatedBps / 1000);
+    currentEstimate.incomingKbps = incomingBps / 1000;
+    currentEstimate.packetLossPercent = lossFraction * 100;
+    currentEstimate.congestionState = lossFraction > BWE_HIGH_LOSS_FRACTION ? LI_CONGESTION_OVERUSE : delayState;
+}
+
+// Called when all packets for the current group have (probably) arrived
+static void completePacketGroup(void) {
+    if (prevGroupValid) {
+        int64_t sendDeltaUs = ((int64_t)(int32_t)(groupRtpTimestamp - prevGroupRtpTimestamp) * 1000) / BWE_PTS_DIVISOR;
+        int64_t arrivalDeltaUs = (int64_t)(groupArrivalUs - prevGroupArrivalUs);
+
+        if (sendDeltaUs > BWE_MAX_GROUP_GAP_US || arrivalDeltaUs > BWE_MAX_GROUP_GAP_US) {
+            resetTrendline();
+        }
+        else {
+            PBWE_TRENDLINE_SAMPLE sample;
+
+            if (trendlineDeltaCount == 0) {
+                trendlineFirstArrivalUs = groupArrivalUs;
+            }
+            trendlineDeltaCount++;
+
+            accumulatedDelayMs += (arrivalDeltaUs - sendDeltaUs) / 1000.0f;
+            smoothedDelayMs = BWE_TRENDLINE_SMOOTHING * smoothedDelayMs +
+                (1 - BWE_TRENDLINE_SMOOTHING) * accumulatedDelayMs;
+
+            sample = &trendlineSamples[trendlineNextSample];
+            sample->arrivalTimeMs = (groupArrivalUs - trendlineFirstArrivalUs) / 1000.0f;
+            sample->smoothedDelayMs = smoothedDelayMs;
+            trendlineNextSample = (trendlineNextSample + 1) % BWE_TRENDLINE_WINDOW;
+            if (trendlineSampleCount < BWE_TRENDLINE_WINDOW) {
+                trendlineSampleCount++;
+            }
+
+            if (trendlineSampleCount == BWE_TRENDLINE_WINDOW) {
+                detectOveruse(getTrendlineSlope(), groupArrivalUs);
+            }
+        }
+    }
+
+    prevGroupRtpTimestamp = groupRtpTimestamp;
+    prevGroupArrivalUs = groupArrivalUs;
+    prevGroupValid = true;
+
+    updateRateControl(groupArrivalUs);
+    publishEstimate();
+}
+
+static void updateRateWindow(uint64_t arrivalTimeUs) {
+    uint64_t elapsedUs;
+    uint32_t expectedPackets;
+
+    if (rateWindowStartUs == 0) {
+        rateWindowStartUs = arrivalTimeUs;
+        return;
+    }
+
+    elapsedUs = arrivalTimeUs - rateWindowStartUs;
+    if (elapsedUs < BWE_RATE_WINDOW_US) {
+        return;
+    }
+
+    incomingBps = (uint32_t)((rateWindowBytes * 8 * 1000000) / elapsedUs);
+
+    expectedPackets = highestSeq - rateWindowFirstSeq + 1;
+    if (expectedPackets > rateWindowPackets) {
+        lossFraction = (float)(expectedPackets - rateWindowPackets) / expectedPackets;
+    }
+    else {
+        lossFraction = 0;
+    }
+
+    // Heavy loss caps the estimate even if delay looks fine, since a
+    // policer or shallow buffer drops packets before delay builds up
+    if (lossFraction > BWE_HIGH_LOSS_FRACTION && estimatedBps != 0) {
+        float lossLimitBps = incomingBps * (1 - lossFraction / 2);
+        if (estimatedBps > lossLimitBps) {
+            estimatedBps = lossLimitBps;
+        }
+    }
+
+    rateWindowStartUs = arrivalTimeUs;
+    rateWindowBytes = 0;
+    rateWindowPackets = 0;
+    rateWindowFirstSeq = highestSeq + 1;
+}
+
+void bandwidthEstimatorAddPacket(uint16_t sequenceNumber, uint32_t rtpTimestamp, int length, uint64_t arrivalTimeUs) {
+    // Extend the sequence number to 32 bits so loss spans window boundaries correctly
+    if (!seqValid) {
+        highestSeq = sequenceNumber;
+        rateWindowFirstSeq = sequenceNumber;
+        seqValid = true;
+    }
+    else if (isBefore16((uint16_t)highestSeq, sequenceNumber)) {
+        highestSeq += U16(sequenceNumber - (uint16_t)highestSeq);
+    }
+
+    updateRateWindow(arrivalTimeUs);
+    rateWindowBytes += length;
+    rateWindowPackets++;
+
+    if (!groupValid) {
+        groupRtpTimestamp = rtpTimestamp;
+        groupArrivalUs = arrivalTimeUs;
+        groupValid = true;
+    }
+    else if ((int32_t)(rtpTimestamp - groupRtpTimestamp) > 0) {
+        completePacketGroup();
+        groupRtpTimestamp = rtpTimestamp;
+        groupArrivalUs = arrivalTimeUs;
+    }
+    // Later packets in this group and reordered packets from an earlier group
+    // count towards rate and loss only
+}
+
+bool LiGetBandwidthEstimate(PBANDWIDTH_ESTIMATE estimate) {
+    // Torn reads are acceptable here
+    if (currentEstimate.estimatedKbps == 0) {
+        return false;
+    }
+
+    *estimate = currentEstimate;
+    return true;
+}
@@ -0,0 +1,179 @@
+#include "Limelight-internal.h"
+
+// Signals are smoothed with this time constant, so the score reacts to
+// a burst of loss within a few frames but doesn't flicker on a single one.
+#define CQ_TIME_CONSTANT_US 250000
+
+// Minimum interval between connectionQualityUpdate() callbacks
+#define CQ_UPDATE_INTERVAL_US 100000
+
+// RFC 3550 interarrival jitter gain
+#define CQ_JITTER_GAIN 16
+
+// Larger arrival deviations are from a stall rather than jitter
+#define CQ_MAX_TRANSIT_DELTA_US 1000000
+
+// Each signal takes away up to its weight from a perfect score of 100
+// once it reaches its limit. Below the floor, it takes away nothing.
+#define CQ_LOSS_WEIGHT 35
+#define CQ_LOSS_LIMIT_PERCENT 10.0f
+#define CQ_FEC_RECOVERY_WEIGHT 10
+#define CQ_FEC_RECOVERY_LIMIT_PERCENT 50.0f
+#define CQ_JITTER_WEIGHT 20
+#define CQ_JITTER_LIMIT_US 20000.0f
+#define CQ_RTT_WEIGHT 10
+#define CQ_RTT_FLOOR_MS 20.0f
+#define CQ_RTT_LIMIT_MS 200.0f
+#define CQ_RTT_VARIANCE_WEIGHT 10
+#define CQ_RTT_VARIANCE_LIMIT_MS 50.0f
+#define CQ_DECODE_QUEUE_WEIGHT 15
+#define CQ_DECODE_QUEUE_FLOOR 1.0f
+#define CQ_DECODE_QUEUE_LIMIT 5.0f
+
+// Only touched by the video receive thread
+static float packetLossEwma;
+static float fecRecoveryEwma;
+static float decodeQueueEwma;
+static uint64_t lastBlockTimeUs;
+static uint64_t lastUpdateTimeUs;
+static uint64_t lastFrameArrivalUs;
+static uint32_t lastFrameRtpTimestamp;
+static uint32_t jitterUs;
+static bool lastFrameValid;
+
+// Read by LiGetConnectionQuality() without synchronization
+static CONNECTION_QUALITY currentQuality;
+
+void resetConnectionQuality(void) {
+    packetLossEwma = 0;
+    fecRecoveryEwma = 0;
+    decodeQueueEwma = 0;
+    lastBlockTimeUs = 0;
+    lastUpdateTimeUs = 0;
+    lastFrameArrivalUs = 0;
+    lastFrameRtpTimestamp = 0;
+    jitterUs = 0;
+    lastFrameValid = false;
+    memset(&currentQuality, 0, sizeof(currentQuality));
+}
+
+// Returns the weight to give a new sample that arrived elapsedUs after the last one
+static float getEwmaAlpha(uint64_t elapsedUs) {
+    if (elapsedUs >= CQ_TIME_CONSTANT_US) {
+        return 1.0f;
+    }
+
+    return (float)elapsedUs / CQ_TIME_CONSTANT_US;
+}
+
+static float getPenalty(float value, float floor, float limit, int weight) {
+    if (value <= floor) {
+        return 0;
+    }
+    else if (value >= limit) {
+        return (float)weight;
+    }
+
+    return weight * (value - floor) / (limit - floor);
+}
+
+static void updateConnectionQuality(uint64_t nowUs) {
+    CONNECTION_QUALITY quality;
+    uint32_t rttMs, rttVarianceMs;
+    float penalty;
+
+    if (nowUs - lastUpdateTimeUs < CQ_UPDATE_INTERVAL_US) {
+        return;
+    }
+    lastUpdateTimeUs = nowUs;
+
+    if (!LiGetEstimatedRttInfo(&rttMs, &rttVarianceMs)) {
+        rttMs = rttVarianceMs = 0;
+    }
+
+    quality.packetLossPercent = packetLossEwma * 100;
+    quality.fecRecoveryPercent = fecRecoveryEwma * 100;
+    quality.jitterUs = jitterUs / CQ_JITTER_GAIN;
+    quality.rttMs = rttMs;
+    quality.rttVarianceMs = rttVarianceMs;
+    quality.decodeQueueDepth = decodeQueueEwma;
+
+    penalty = getPenalty(quality.packetLossPercent, 0, CQ_LOSS_LIMIT_PERCENT, CQ_LOSS_WEIGHT);
+    penalty += getPenalty(quality.fecRecoveryPercent, 0, CQ_FEC_RECOVERY_LIMIT_PERCENT, CQ_FEC_RECOVERY_WEIGHT);
+    penalty += getPenalty((float)quality.jitterUs, 0, CQ_JITTER_LIMIT_US, CQ_JITTER_WEIGHT);
+    penalty += getPenalty((float)rttMs, CQ_RTT_FLOOR_MS, CQ_RTT_LIMIT_MS, CQ_RTT_WEIGHT);
+    penalty += getPenalty((float)rttVarianceMs, 0, CQ_RTT_VARIANCE_LIMIT_MS, CQ_RTT_VARIANCE_WEIGHT);
+    penalty += getPenalty(quality.decodeQueueDepth, CQ_DECODE_QUEUE_FLOOR, CQ_DECODE_QUEUE_LIMIT, CQ_DECODE_QUEUE_WEIGHT);
+    quality.score = 100 - (int)(penalty + 0.5f);
+
+    currentQuality = quality;
+    ListenerCallbacks.connectionQualityUpdate(&quality);
+}
+
+// Called by the video queue when it is done with an FEC block. If the block
+// was completed, only missing data shards are known to be lost, since we stop
+// counting parity shards once we have enough to recover the block.
+void connectionQualityFecBlockFinished(uint32_t dataShards, uint32_t parityShards,
+                                       uint32_t receivedDataShards, uint32_t receivedParityShards,
+                                       bool completed) {
+    uint64_t nowUs = PltGetMicroseconds();
+    float loss, alpha;
+    int pendingFrames;
+
+    if (dataShards == 0) {
+        return;
+    }
+
+    if (completed) {
+        loss = (float)(dataShards - receivedDataShards) / dataShards;
+    }
+    else {
+        loss = 1.0f - (float)(receivedDataShards + receivedParityShards) / (dataShards + parityShards);
+    }
+
+    pendingFrames = LiGetPendingVideoFrames();
+    if (pendingFrames < 0) {
+        pendingFrames = 0;
+    }
+
+    alpha = lastBlockTimeUs != 0 ? getEwmaAlpha(nowUs - lastBlockTimeUs) : 1.0f;
+    lastBlockTimeUs = nowUs;
+
+    packetLossEwma += alpha * (loss - packetLossEwma);
+    fecRecoveryEwma += alpha * ((completed && receivedDataShards != dataShards ? 1.0f : 0.0f) - fecRecoveryEwma);
+    decodeQueueEwma += alpha * (pendingFrames - decodeQueueEwma);
+
+    updateConnectionQuality(nowUs);
+}
+
+// Called by the video queue when the first packet of a new frame arrives
+void connectionQualityFrameArrived(uint32_t rtpTimestamp, uint64_t arrivalTimeUs) {
+    if (lastFrameValid) {
+        // Difference between the arrival spacing and the host's capture spacing
+        int64_t transitDeltaUs = (int64_t)(arrivalTimeUs - lastFrameArrivalUs) -
+            ((int64_t)(int32_t)(rtpTimestamp - lastFrameRtpTimestamp) * 1000) / 90;
+        if (transitDeltaUs < 0) {
+            transitDeltaUs = -transitDeltaUs;
+        }
+        if (transitDeltaUs > CQ_MAX_TRANSIT_DELTA_US) {
+            transitDeltaUs = CQ_MAX_TRANSIT_DELTA_US;
+        }
+
+        // jitterUs is kept scaled by CQ_JITTER_GAIN to avoid losing precision
+        jitterUs += (uint32_t)transitDeltaUs - (jitterUs + CQ_JITTER_GAIN / 2) / CQ_JITTER_GAIN;
+    }
+
+    lastFrameArrivalUs = arrivalTimeUs;
+    lastFrameRtpTimestamp = rtpTimestamp;
+    lastFrameValid = true;
+}
+
+bool LiGetConnectionQuality(PCONNECTION_QUALITY quality) {
+    // Torn reads are acceptable here
+    if (lastUpdateTimeUs == 0) {
+        return false;
+    }
+
+    *quality = currentQuality;
+    return true;
+}
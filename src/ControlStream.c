@@ -90,9 +90,63 @@ typedef struct _QUEUED_ASYNC_CALLBACK {
 static SOCKET ctlSock = INVALID_SOCKET;
 static ENetHost* client;
 static ENetPeer* peer;
-static PLT_MUTEX enetMutex;
 static bool usePeriodicPing;
 
+// The control receive thread owns the ENet host. Other threads queue their messages
+// for it to send, and it sleeps until the ENet socket is readable, a message is queued
+// (signalled through the wake socket), or the next ENet timer is due.
+typedef struct _ENET_SEND_REQUEST {
+    struct _ENET_SEND_REQUEST* next;
+    ENetPacket* packet;
+    uint64_t queueTimeUs;
+    volatile bool packetFreed;
+    bool waiting;
+    int state;
+    short ptype;
+    short paylen;
+    uint8_t channelId;
+    uint32_t flags;
+    bool moreData;
+    bool traced;
+    INPUT_LATENCY_TRACE trace;
+} ENET_SEND_REQUEST, *PENET_SEND_REQUEST;
+
+#define SEND_REQUEST_PENDING 0
+#define SEND_REQUEST_SENT 1
+#define SEND_REQUEST_FAILED 2
+#define SEND_REQUEST_ABANDONED 3 // The sender stopped waiting
+
+#define MAX_QUEUED_ENET_SEND_REQUESTS 256
+
+static MPMC_RING_QUEUE enetSendQueue;
+static SOCKET enetWakeSocket = INVALID_SOCKET;
+static volatile uint32_t enetIoThreadParked;
+static volatile uint32_t enetFlushRequested;
+static volatile uint32_t enetIoThreadExited;
+
+// Only touched by the control receive thread
+static PENET_SEND_REQUEST awaitingSendRequests;
+static bool enetSendsDeferred;
+
+// Input messages handed to ENet that haven't been written to the socket yet
+#define MAX_SENT_INPUT_TRACES 32
+static INPUT_LATENCY_TRACE sentInputTraces[MAX_SENT_INPUT_TRACES];
+static int sentInputTraceCount;
+
+// Messages sent with moreData are held back at most this long to share
+// a datagram with the rest of their batch
+#define MAX_SEND_DEFERRAL_MS 1
+
+// Protects the state of requests with a waiting sender and the send completion stats
+static PLT_MUTEX sendCompletionMutex;
+static PLT_COND sendCompletionCond;
+
+// Don't block senders longer than this waiting for a reliable packet to be sent
+#define RELIABLE_SEND_WAIT_MS 10
+
+static LATENCY_HISTOGRAM sendCompletionHistogram;
+static uint32_t sendCompletionTimeouts;
+
 static PLT_THREAD lossStatsThread;
 static PLT_THREAD invalidateRefFramesThread;
 static PLT_THREAD requestIdrFrameThread;
@@ -299,12 +353,34 @@ static bool supportsIdrFrameRequest;
 
 // Initializes the control stream
 int initializeControlStream(void) {
+    int err;
+
+    err = MrqInitializeQueue(&enetSendQueue, MAX_QUEUED_ENET_SEND_REQUESTS);
+    if (err != 0) {
+        return err;
+    }
+
     stopping = false;
     PltCreateEvent(&idrFrameRequiredEvent);
+    initializeRecoveryPolicy();
     LbqInitializeLinkedBlockingQueue(&referenceFrameControlQueue, 20);
     LbqInitializeLinkedBlockingQueue(&frameFecStatusQueue, 8); // Limits number of frame status reports per periodic ping interval
     LbqInitializeLinkedBlockingQueue(&asyncCallbackQueue, 30);
-    PltCreateMutex(&enetMutex);
+    PltCreateMutex(&sendCompletionMutex);
+    PltCreateConditionVariable(&sendCompletionCond, &sendCompletionMutex);
+    enetIoThreadParked = 0;
+    enetFlushRequested = 0;
+    enetIoThreadExited = 0;
+    awaitingSendRequests = NULL;
+    enetSendsDeferred = false;
+    sentInputTraceCount = 0;
+    LhInitializeHistogram(&sendCompletionHistogram);
+    sendCompletionTimeouts = 0;
+
+    if (AppVersionQuad[0] >= 5) {
+        // If this fails, the control receive thread will poll for queued messages instead
+        enetWakeSocket = createLoopbackWakeSocket();
+    }
 
     encryptedControlStream = APP_VERSION_AT_LEAST(7, 1, 431);
 
@@ -354,6 +430,8 @@ int initializeControlStream(void) {
     usePeriodicPing = APP_VERSION_AT_LEAST(7, 1, 415);
     encryptionCtx = PltCreateCryptoContext();
     decryptionCtx = PltCreateCryptoContext();
+    PltSetCryptoContextStatsType(encryptionCtx, CRYPTO_STATS_TYPE_CONTROL);
+    PltSetCryptoContextStatsType(decryptionCtx, CRYPTO_STATS_TYPE_CONTROL);
     hdrEnabled = false;
     memset(&hdrMetadata, 0, sizeof(hdrMetadata));
 
@@ -376,43 +454,51 @@ void destroyControlStream(void) {
     PltDestroyCryptoContext(encryptionCtx);
     PltDestroyCryptoContext(decryptionCtx);
     PltCloseEvent(&idrFrameRequiredEvent);
+    destroyRecoveryPolicy();
     freeBasicLbqList(LbqDestroyLinkedBlockingQueue(&referenceFrameControlQueue));
     freeBasicLbqList(LbqDestroyLinkedBlockingQueue(&frameFecStatusQueue));
     freeBasicLbqList(LbqDestroyLinkedBlockingQueue(&asyncCallbackQueue));
 
-    PltDeleteMutex(&enetMutex);
+    // Free any messages that were queued after the control receive thread stopped
+    PENET_SEND_REQUEST request;
+    while (MrqReclaimQueueElement(&enetSendQueue, (void**)&request)) {
+        free(request);
+    }
+    MrqDestroyQueue(&enetSendQueue);
+
+    PltDeleteConditionVariable(&sendCompletionCond);
+    PltDeleteMutex(&sendCompletionMutex);
+
+    if (enetWakeSocket != INVALID_SOCKET) {
+        closeSocket(enetWakeSocket);
+        enetWakeSocket = INVALID_SOCKET;
+    }
 }
 
-static void queueFrameInvalidationTuple(uint32_t startFrame, uint32_t endFrame) {
-    LC_ASSERT(startFrame <= endFrame);
+// Wakes the RFI thread to send the loss range collected by the recovery policy
+static void queueFrameInvalidation(void) {
+    PQUEUED_REFERENCE_FRAME_CONTROL qfit;
 
-    if (isReferenceFrameInvalidationEnabled()) {
-        PQUEUED_REFERENCE_FRAME_CONTROL qfit;
-        qfit = malloc(sizeof(*qfit));
-        if (qfit != NULL) {
-            *qfit = (QUEUED_REFERENCE_FRAME_CONTROL){
-                .startFrame = startFrame,
-                .endFrame = endFrame,
-                .invalidate = true,
-            };
-            if (LbqOfferQueueItem(&referenceFrameControlQueue, qfit, &qfit->entry) == LBQ_BOUND_EXCEEDED) {
-                // Too many invalidation tuples, so we need an IDR frame now
-                Limelog("RFI range list reached maximum size limit\n");
-                free(qfit);
-                LiRequestIdrFrame();
-            }
-        }
-        else {
-            LiRequestIdrFrame();
+    LC_ASSERT(isReferenceFrameInvalidationEnabled());
+
+    qfit = malloc(sizeof(*qfit));
+    if (qfit != NULL) {
+        *qfit = (QUEUED_REFERENCE_FRAME_CONTROL){
+            .invalidate = true,
+        };
+        if (LbqOfferQueueItem(&referenceFrameControlQueue, qfit, &qfit->entry) == LBQ_BOUND_EXCEEDED) {
+            // Too many reference frame control messages, so we need an IDR frame now
+            Limelog("RFI range list reached maximum size limit\n");
+            free(qfit);
+            requestIdrFrameForRecovery(LI_RECOVERY_TRIGGER_QUEUE_FULL);
         }
     }
     else {
-        LiRequestIdrFrame();
+        requestIdrFrameForRecovery(LI_RECOVERY_TRIGGER_QUEUE_FULL);
     }
 }
 
-// Request an IDR frame on demand by the decoder
-void LiRequestIdrFrame(void) {
+static void sendIdrFrameRequest(void) {
     // Any reference frame invalidation requests should be dropped now.
     // We require a full IDR frame to recover.
     freeBasicLbqList(LbqFlushQueueItems(&referenceFrameControlQueue));
@@ -421,9 +507,41 @@ void LiRequestIdrFrame(void) {
     PltSetEvent(&idrFrameRequiredEvent);
 }
 
-// Invalidate reference frames lost by the network
+// Request an IDR frame for the specified LI_RECOVERY_TRIGGER_* reason
+void requestIdrFrameForRecovery(uint8_t trigger) {
+    recoveryPolicyIdrRequested(trigger);
+    sendIdrFrameRequest();
+}
+
+// Request an IDR frame on demand by the decoder
+void LiRequestIdrFrame(void) {
+    requestIdrFrameForRecovery(LI_RECOVERY_TRIGGER_CLIENT);
+}
+
+// Recover from reference frames lost by the network
 void connectionDetectedFrameLoss(uint32_t startFrame, uint32_t endFrame) {
-    queueFrameInvalidationTuple(startFrame, endFrame);
+    LC_ASSERT(startFrame <= endFrame);
+
+    switch (recoveryPolicyFrameLoss(startFrame, endFrame)) {
+    case LI_RECOVERY_ACTION_RFI:
+    case LI_RECOVERY_ACTION_LTR:
+        queueFrameInvalidation();
+        break;
+    case LI_RECOVERY_ACTION_IDR:
+        sendIdrFrameRequest();
+        break;
+    default:
+        // Already covered by a recovery in progress
+        break;
+    }
+}
+
+// Called periodically so an RFI request that the host never answers is
+// escalated to an IDR frame request even if no more frames arrive
+static void checkRfiRecoveryTimeout(void) {
+    if (isReferenceFrameInvalidationEnabled() && recoveryPolicyCheckRfiTimeout()) {
+        sendIdrFrameRequest();
+    }
 }
 
 // When we receive a frame, update the number of our current frame
@@ -446,7 +564,11 @@ void connectionReceivedCompleteFrame(uint32_t frameIndex, bool frameIsLTR) {
                 LC_ASSERT(false);
                 Limelog("Couldn't queue LTR ACK because the list has reached maximum size limit\n");
                 free(qfit);
-                LiRequestIdrFrame();
+                requestIdrFrameForRecovery(LI_RECOVERY_TRIGGER_QUEUE_FULL);
+            }
+            else {
+                // The host can recover from this frame once it receives the ACK
+                recoveryPolicyLtrAcknowledged(frameIndex);
             }
         }
     }
@@ -669,8 +791,7 @@ static void enetPacketFreeCb(ENetPacket* packet) {
     }
 }
 
-
-// Must be called with enetMutex held
+// Must be called on the control receive thread
 static bool isPacketSentWaitingForAck(ENetPacket* packet) {
     ENetOutgoingCommand* outgoingCommand = NULL;
     ENetListIterator currentCommand;
@@ -689,76 +810,112 @@ static bool isPacketSentWaitingForAck(ENetPacket* packet) {
     return false;
 }
 
-static bool sendMessageEnet(short ptype, short paylen, const void* payload, uint8_t channelId, uint32_t flags, bool moreData) {
-    ENetPacket* enetPacket;
-    int err;
+static void signalEnetWakeSocket(void) {
+    if (enetWakeSocket != INVALID_SOCKET) {
+        char wake = 0;
+        send(enetWakeSocket, &wake, sizeof(wake), 0);
+    }
+}
 
-    LC_ASSERT(AppVersionQuad[0] >= 5);
+static void wakeEnetIoThread(void) {
+    // Only pay for the wakeup if the control receive thread is asleep
+    if (PltAtomicCompareExchange32(&enetIoThreadParked, 1, 0)) {
+        signalEnetWakeSocket();
+    }
+}
 
-    // Only send reliable packets to GFE
-    if (!IS_SUNSHINE()) {
-        flags = ENET_PACKET_FLAG_RELIABLE;
+static void interruptControlReceiveThread(void) {
+    PltInterruptThread(&controlReceiveThread);
+    signalEnetWakeSocket();
+}
+
+// Hands a finished request back to its sender or frees it if nobody is waiting
+static void completeSendRequest(PENET_SEND_REQUEST request, int state) {
+    // ENet must not touch the request after it's gone
+    if (request->packet != NULL && !request->packetFreed) {
+        request->packet->userData = NULL;
+        request->packet->freeCallback = NULL;
+    }
+
+    if (!request->waiting) {
+        free(request);
+        return;
+    }
+
+    PltLockMutex(&sendCompletionMutex);
+    if (request->state == SEND_REQUEST_ABANDONED) {
+        PltUnlockMutex(&sendCompletionMutex);
+        free(request);
+        return;
     }
 
+    request->state = state;
+    LhAddSample(&sendCompletionHistogram, PltGetMicroseconds() - request->queueTimeUs);
+    PltBroadcastConditionVariable(&sendCompletionCond);
+    PltUnlockMutex(&sendCompletionMutex);
+}
+
+// Must be called on the control receive thread (or after it has exited)
+static void submitSendRequest(PENET_SEND_REQUEST request) {
+    ENetPacket* enetPacket;
+    uint8_t channelId = request->channelId;
+
     if (encryptedControlStream) {
         PNVCTL_ENCRYPTED_PACKET_HEADER encPacket;
         PNVCTL_ENET_PACKET_HEADER_V2 packet;
         char tempBuffer[256];
 
         enetPacket = enet_packet_create(NULL,
-                                        sizeof(*encPacket) + AES_GCM_TAG_LENGTH + sizeof(*packet) + paylen,
-                                        flags);
+                                        sizeof(*encPacket) + AES_GCM_TAG_LENGTH + sizeof(*packet) + request->paylen,
+                                        request->flags);
         if (enetPacket == NULL) {
-            return false;
+            completeSendRequest(request, SEND_REQUEST_FAILED);
+            return;
         }
 
-        // We (ab)use the enetMutex to protect currentEnetSequenceNumber and the cipherContext
-        // used inside encryptControlMessage().
-        PltLockMutex(&enetMutex);
-
+        // currentEnetSequenceNumber and the cipherContext used inside encryptControlMessage()
+        // are only used by the thread that owns the ENet host.
         encPacket = (PNVCTL_ENCRYPTED_PACKET_HEADER)enetPacket->data;
         encPacket->encryptedHeaderType = 0x0001;
-        encPacket->length = sizeof(encPacket->seq) + AES_GCM_TAG_LENGTH + sizeof(*packet) + paylen;
+        encPacket->length = sizeof(encPacket->seq) + AES_GCM_TAG_LENGTH + sizeof(*packet) + request->paylen;
         encPacket->seq = currentEnetSequenceNumber++;
 
         // Construct the plaintext data for encryption
-        LC_ASSERT(sizeof(*packet) + paylen < sizeof(tempBuffer));
+        LC_ASSERT(sizeof(*packet) + request->paylen < sizeof(tempBuffer));
         packet = (PNVCTL_ENET_PACKET_HEADER_V2)tempBuffer;
-        packet->type = ptype;
-        packet->payloadLength = paylen;
-        memcpy(&packet[1], payload, paylen);
+        packet->type = request->ptype;
+        packet->payloadLength = request->paylen;
+        memcpy(&packet[1], &request[1], request->paylen);
 
         // Encrypt the data into the final packet (and byteswap for BE machines)
         if (!encryptControlMessage(encPacket, packet)) {
             Limelog("Failed to encrypt control stream message\n");
             enet_packet_destroy(enetPacket);
-            PltUnlockMutex(&enetMutex);
-            return false;
+            completeSendRequest(request, SEND_REQUEST_FAILED);
+            return;
         }
-
-        // enetMutex still locked here
     }
     else {
         PNVCTL_ENET_PACKET_HEADER_V1 packet;
-        enetPacket = enet_packet_create(NULL, sizeof(*packet) + paylen,
-                                        flags);
+        enetPacket = enet_packet_create(NULL, sizeof(*packet) + request->paylen,
+                                        request->flags);
         if (enetPacket == NULL) {
-            return false;
+            completeSendRequest(request, SEND_REQUEST_FAILED);
+            return;
         }
 
         packet = (PNVCTL_ENET_PACKET_HEADER_V1)enetPacket->data;
-        packet->type = LE16(ptype);
-        memcpy(&packet[1], payload, paylen);
-
-        PltLockMutex(&enetMutex);
+        packet->type = LE16(request->ptype);
+        memcpy(&packet[1], &request[1], request->paylen);
     }
 
-    volatile bool packetFreed = false;
-
     // Set a callback to use to let us know if the packet has been freed.
     // Freeing can only happen when the packet is acked or send fails.
-    enetPacket->userData = (void*)&packetFreed;
-    enetPacket->freeCallback = enetPacketFreeCb;
+    if (request->waiting) {
+        request->packet = enetPacket;
+        enetPacket->userData = (void*)&request->packetFreed;
+        enetPacket->freeCallback = enetPacketFreeCb;
+    }
 
     // Always use channel 0 for GFE and if the requested channel exceeds
     // the peer's supported channel count.
@@ -767,55 +924,241 @@ static bool sendMessageEnet(short ptype, short paylen, const void* payload, uint
     }
 
     // Queue the packet to be sent
-    err = enet_peer_send(peer, channelId, enetPacket);
-    bool packetQueued = (err == 0);
-
-    // If there is no more data coming soon, send the packet now
-    if (!moreData && packetQueued) {
-        err = enet_host_service(client, NULL, 0);
-
-        // Wait until the packet is actually sent to provide backpressure on senders
-        if (flags & ENET_PACKET_FLAG_RELIABLE) {
-            // Don't wait longer than 10 milliseconds to avoid blocking callers for too long
-            for (int i = 0; err >= 0 && i < 10; i++) {
-                // Break on disconnected, acked/freed, or sent (pending ack).
-                if (peer->state != ENET_PEER_STATE_CONNECTED || packetFreed || isPacketSentWaitingForAck(enetPacket)) {
-                    break;
-                }
+    if (enet_peer_send(peer, channelId, enetPacket) < 0) {
+        Limelog("Failed to send ENet control packet\n");
+        enet_packet_destroy(enetPacket);
+        request->packet = NULL;
+        completeSendRequest(request, SEND_REQUEST_FAILED);
+        return;
+    }
 
-                // Release the lock before sleeping to allow another thread to send/receive
-                PltUnlockMutex(&enetMutex);
-                PltSleepMs(1);
-                PltLockMutex(&enetMutex);
+    if (request->traced) {
+        request->trace.handoffTimeUs = PltGetMicroseconds();
 
-                // Try to send the packet again
-                err = enet_host_service(client, NULL, 0);
-            }
+        // If too many messages are waiting, just count this one as written now
+        if (sentInputTraceCount < MAX_SENT_INPUT_TRACES) {
+            sentInputTraces[sentInputTraceCount++] = request->trace;
+        }
+        else {
+            recordInputLatencyTrace(&request->trace, request->trace.handoffTimeUs);
+        }
+    }
 
-            if (err >= 0 && peer->state == ENET_PEER_STATE_CONNECTED && !packetFreed && !isPacketSentWaitingForAck(enetPacket)) {
-                Limelog("Control message took over 10 ms to send (net latency: %u ms | packet loss: %f%%)\n",
-                        peer->roundTripTime, peer->packetLoss / (float)ENET_PEER_PACKET_LOSS_SCALE);
-            }
+    if (request->waiting) {
+        request->next = awaitingSendRequests;
+        awaitingSendRequests = request;
+    }
+    else {
+        free(request);
+    }
+}
+
+// Writes out the datagrams carrying any input messages handed to ENet and records
+// their latency. Must be called on the control receive thread.
+static void flushSentInputTraces(void) {
+    uint64_t flushTimeUs;
+
+    if (sentInputTraceCount == 0) {
+        return;
+    }
+
+    enet_host_flush(client);
+    flushTimeUs = PltGetMicroseconds();
+
+    for (int i = 0; i < sentInputTraceCount; i++) {
+        recordInputLatencyTrace(&sentInputTraces[i], flushTimeUs);
+    }
+    sentInputTraceCount = 0;
+}
+
+// Hands all queued messages to ENet. Must be called on the control receive thread.
+static void processEnetSendQueue(void) {
+    PENET_SEND_REQUEST request;
+
+    // Check for a flush first, since it covers any message queued before it
+    bool flush = PltAtomicCompareExchange32(&enetFlushRequested, 1, 0);
+
+    while (MrqPollQueueElement(&enetSendQueue, (void**)&request) == LBQ_SUCCESS) {
+        enetSendsDeferred = request->moreData;
+        submitSendRequest(request);
+    }
+
+    if (flush) {
+        enetSendsDeferred = false;
+    }
+}
+
+// Releases senders whose packets have left. Must be called on the control receive thread
+// after servicing the host, or with complete set to release all of them.
+static void completeAwaitingSendRequests(bool complete) {
+    PENET_SEND_REQUEST* link = &awaitingSendRequests;
+
+    while (*link != NULL) {
+        PENET_SEND_REQUEST request = *link;
+
+        // Complete on disconnected, acked/freed, or sent (pending ack).
+        if (complete || peer->state != ENET_PEER_STATE_CONNECTED ||
+                request->packetFreed || isPacketSentWaitingForAck(request->packet)) {
+            *link = request->next;
+            completeSendRequest(request, SEND_REQUEST_SENT);
+        }
+        else {
+            link = &request->next;
         }
     }
+}
+
+// Waits for the ENet socket to become readable or for another thread to queue
+// a message. Returns true if the ENet host needs to be serviced.
+static bool waitForEnetIo(int timeoutMs) {
+    struct pollfd pfds[2];
+    int nfds = 1;
+    int err;
+
+    PltAtomicStore32(&enetIoThreadParked, 1);
+
+    // Senders check the parked flag after queuing and we check the queue after
+    // setting the flag, so at least one of us will see the other.
+    if (MrqGetItemCount(&enetSendQueue) > 0 || PltAtomicLoad32(&enetFlushRequested)) {
+        PltAtomicStore32(&enetIoThreadParked, 0);
+        return false;
+    }
 
-    // Remove the free callback now that the packet was sent
-    if (!packetFreed) {
-        enetPacket->userData = NULL;
-        enetPacket->freeCallback = NULL;
+    pfds[0].fd = client->socket;
+    pfds[0].events = POLLIN;
+    if (enetWakeSocket != INVALID_SOCKET) {
+        pfds[1].fd = enetWakeSocket;
+        pfds[1].events = POLLIN;
+        nfds++;
+    }
+    else if (timeoutMs > 1) {
+        // We can't be woken up, so poll the queue instead
+        timeoutMs = 1;
     }
 
-    PltUnlockMutex(&enetMutex);
+    err = pollSockets(pfds, nfds, timeoutMs);
+    PltAtomicStore32(&enetIoThreadParked, 0);
 
-    if (err < 0) {
-        Limelog("Failed to send ENet control packet\n");
-        if (!packetQueued) {
-            enet_packet_destroy(enetPacket);
+    if (err > 0 && nfds > 1 && (pfds[1].revents & POLLIN)) {
+        char buffer[16];
+
+        // Drain all wakeups, since we'll process the whole queue anyway
+        while (recv(enetWakeSocket, buffer, sizeof(buffer), 0) > 0);
+    }
+
+    // Let ENet report any socket error
+    return err < 0 || (err > 0 && (pfds[0].revents & (POLLIN | POLLERR | POLLHUP)));
+}
+
+static bool queueEnetSendRequest(short ptype, short paylen, const void* payload, uint8_t channelId, uint32_t flags, bool moreData,
+                                 PINPUT_LATENCY_TRACE trace) {
+    PENET_SEND_REQUEST request;
+    uint64_t deadlineUs;
+    bool waiting;
+    int state;
+    int err;
+
+    LC_ASSERT(AppVersionQuad[0] >= 5);
+
+    // Only send reliable packets to GFE
+    if (!IS_SUNSHINE()) {
+        flags = ENET_PACKET_FLAG_RELIABLE;
+    }
+
+    // Nobody will send this if the control receive thread is gone
+    if (PltAtomicLoad32(&enetIoThreadExited)) {
+        return false;
+    }
+
+    request = malloc(sizeof(*request) + paylen);
+    if (request == NULL) {
+        return false;
+    }
+
+    request->next = NULL;
+    request->packet = NULL;
+    request->queueTimeUs = PltGetMicroseconds();
+    request->packetFreed = false;
+    request->state = SEND_REQUEST_PENDING;
+    request->ptype = ptype;
+    request->paylen = paylen;
+    request->channelId = channelId;
+    request->flags = flags;
+    request->moreData = moreData;
+    request->traced = trace != NULL;
+    if (trace != NULL) {
+        request->trace = *trace;
+    }
+    memcpy(&request[1], payload, paylen);
+
+    // If there is no more data coming soon, wait until the packet is actually
+    // sent to provide backpressure on senders. The control receive thread frees
+    // requests that nobody is waiting on, so we can't look at those once queued.
+    waiting = !moreData && (flags & ENET_PACKET_FLAG_RELIABLE);
+    request->waiting = waiting;
+
+    while ((err = MrqOfferQueueItem(&enetSendQueue, request)) == LBQ_BOUND_EXCEEDED) {
+        if (PltAtomicLoad32(&enetIoThreadExited)) {
+            break;
         }
+
+        // Give the control receive thread a chance to catch up
+        wakeEnetIoThread();
+        PltSleepMs(1);
+    }
+    if (err != LBQ_SUCCESS) {
+        free(request);
         return false;
     }
 
-    return true;
+    wakeEnetIoThread();
+
+    if (!waiting) {
+        return true;
+    }
+
+    // Don't wait longer than 10 milliseconds to avoid blocking callers for too long
+    deadlineUs = request->queueTimeUs + (RELIABLE_SEND_WAIT_MS * 1000);
+
+    PltLockMutex(&sendCompletionMutex);
+    while (request->state == SEND_REQUEST_PENDING && !PltAtomicLoad32(&enetIoThreadExited)) {
+        uint64_t now = PltGetMicroseconds();
+        if (now >= deadlineUs) {
+            break;
+        }
+
+        PltWaitForConditionVariableTimeout(&sendCompletionCond, &sendCompletionMutex,
+                                           (uint32_t)((deadlineUs - now + 999) / 1000));
+    }
+
+    state = request->state;
+    if (state == SEND_REQUEST_PENDING) {
+        bool exited = PltAtomicLoad32(&enetIoThreadExited) != 0;
+
+        // Whoever takes the request off the queue will free it
+        request->state = SEND_REQUEST_ABANDONED;
+
+        if (!exited) {
+            // We're not synchronized with the control receive thread, but these are just for logging
+            Limelog("Control message took over %d ms to send (net latency: %u ms | packet loss: %f%%)\n",
+                    RELIABLE_SEND_WAIT_MS, peer->roundTripTime, peer->packetLoss / (float)ENET_PEER_PACKET_LOSS_SCALE);
+            sendCompletionTimeouts++;
+            LhAddSample(&sendCompletionHistogram, PltGetMicroseconds() - request->queueTimeUs);
+        }
+
+        PltUnlockMutex(&sendCompletionMutex);
+
+        // If the control receive thread is gone, this message will never be handed to ENet
+        return !exited;
+    }
+    PltUnlockMutex(&sendCompletionMutex);
+
+    free(request);
+    return state == SEND_REQUEST_SENT;
+}
+
+static bool sendMessageEnet(short ptype, short paylen, const void* payload, uint8_t channelId, uint32_t flags, bool moreData) {
+    return queueEnetSendRequest(ptype, paylen, payload, channelId, flags, moreData, NULL);
 }
 
 static bool sendMessageTcp(short ptype, short paylen, const void* payload) {
@@ -847,7 +1190,7 @@ static bool sendMessageAndForget(short ptype, short paylen, const void* payload,
     bool ret;
 
     // Unlike regular sockets, ENet sockets aren't safe to invoke from multiple
-    // threads at once. We have to synchronize them with a lock.
+    // threads at once, so these are handed to the control receive thread.
     if (AppVersionQuad[0] >= 5) {
         ret = sendMessageEnet(ptype, paylen, payload, channelId, flags, moreData);
     }
@@ -1064,6 +1407,11 @@ static void queueAsyncCallback(PNVCTL_ENET_PACKET_HEADER_V1 ctlHdr, int packetLe
         BbGet16(&bb, &queuedCb->data.setMotionEventState.reportRateHz);
         BbGet8(&bb, &queuedCb->data.setMotionEventState.motionType);
 
+        // Enforce the requested rate ourselves in case the client doesn't
+        setMotionEventReportRate(queuedCb->data.setMotionEventState.controllerNumber,
+                                 queuedCb->data.setMotionEventState.motionType,
+                                 queuedCb->data.setMotionEventState.reportRateHz);
+
         queuedCb->typeIndex = IDX_SET_MOTION_EVENT;
     }
     else if (ctlHdr->type == packetTypes[IDX_SET_RGB_LED]) {
@@ -1101,29 +1449,46 @@ static void queueAsyncCallback(PNVCTL_ENET_PACKET_HEADER_V1 ctlHdr, int packetLe
     }
 }
 
-static void controlReceiveThreadFunc(void* context) {
+static void controlReceiveLoop(void) {
+    uint64_t sendDeferralDeadlineMs = 0;
     int err;
 
-    // This is only used for ENet
-    if (AppVersionQuad[0] < 5) {
-        return;
-    }
-
     while (!PltIsThreadInterrupted(&controlReceiveThread)) {
         ENetEvent event;
         enet_uint32 waitTimeMs;
 
-        PltLockMutex(&enetMutex);
+        // Hand any messages queued by other threads to ENet
+        processEnetSendQueue();
+
+        // Servicing the host would send messages queued with moreData in a datagram
+        // of their own, so give the rest of their batch a moment to arrive.
+        if (enetSendsDeferred) {
+            uint64_t now = PltGetMillis();
+
+            if (sendDeferralDeadlineMs == 0) {
+                sendDeferralDeadlineMs = now + MAX_SEND_DEFERRAL_MS;
+            }
+            if (now < sendDeferralDeadlineMs && !waitForEnetIo((int)(sendDeferralDeadlineMs - now))) {
+                continue;
+            }
+        }
+        enetSendsDeferred = false;
+        sendDeferralDeadlineMs = 0;
+
+        // Servicing the host may return a received event before it sends anything
+        flushSentInputTraces();
 
-        // Poll for new packets and process retransmissions
+        // Poll for new packets, send queued messages, and process retransmissions
         err = serviceEnetHost(client, &event, 0);
+        completeAwaitingSendRequests(false);
 
         // Compute the next time we need to wake up to handle
         // the RTO timer or a ping.
         if (err == 0) {
             if (ENET_TIME_LESS(peer->nextTimeout, client->serviceTime)) {
-                // This can happen when we have no unacked reliable messages
-                waitTimeMs = 10;
+                // This can happen when we have no unacked reliable messages. We'll
+                // be woken up if anything is queued to send, so just wait for a ping.
+                waitTimeMs = peer->pingInterval;
             }
             else {
                 // We add 1 ms just to ensure we're unlikely to undershoot the sleep() and have to
@@ -1149,13 +1514,10 @@ static void controlReceiveThreadFunc(void* context) {
             }
         }
 
-        PltUnlockMutex(&enetMutex);
-
         if (err == 0) {
             // Handle a pending disconnect after unsuccessfully polling
             // for new events to handle.
             if (disconnectPending) {
-                PltLockMutex(&enetMutex);
                 // Wait 100 ms for pending receives after a disconnect and
                 // 1 second for the pending disconnect to be processed after
                 // removing the intercept callback.
@@ -1168,27 +1530,21 @@ static void controlReceiveThreadFunc(void* context) {
                         // 1 second for this disconnect to be processed before
                         // we tear down the connection anyway.
                         client->intercept = NULL;
-                        PltUnlockMutex(&enetMutex);
                         continue;
                     }
                     else {
                         // The 1 second timeout has expired with no disconnect event
                         // retransmission after the first notification. We can only
                         // assume the server died tragically, so go ahead and tear down.
-                        PltUnlockMutex(&enetMutex);
                         Limelog("Disconnect event timeout expired\n");
                         ListenerCallbacks.connectionTerminated(-1);
                         return;
                     }
                 }
-                else {
-                    PltUnlockMutex(&enetMutex);
-                }
             }
             else {
-                // No events ready - wait for readability or a local RTO timer to expire
-                enet_uint32 condition = ENET_SOCKET_WAIT_RECEIVE;
-                enet_socket_wait(client->socket, &condition, waitTimeMs);
+                // No events ready - wait for readability, a queued message, or a local RTO timer to expire
+                waitForEnetIo((int)waitTimeMs);
                 continue;
             }
         }
@@ -1367,9 +1723,7 @@ static void controlReceiveThreadFunc(void* context) {
                 // message once it sends this message, so we mark the peer as fully
                 // disconnected now to avoid delays waiting for an ack that will
                 // never arrive.
-                PltLockMutex(&enetMutex);
                 enet_peer_disconnect_now(peer, 0);
-                PltUnlockMutex(&enetMutex);
                 ListenerCallbacks.connectionTerminated((int)terminationErrorCode);
                 free(ctlHdr);
                 return;
@@ -1385,6 +1739,21 @@ static void controlReceiveThreadFunc(void* context) {
     }
 }
 
+static void controlReceiveThreadFunc(void* context) {
+    // This is only used for ENet
+    if (AppVersionQuad[0] >= 5) {
+        controlReceiveLoop();
+
+        // Nobody is left to wait for these packets to be sent
+        completeAwaitingSendRequests(true);
+    }
+
+    PltLockMutex(&sendCompletionMutex);
+    PltAtomicStore32(&enetIoThreadExited, 1);
+    PltBroadcastConditionVariable(&sendCompletionCond);
+    PltUnlockMutex(&sendCompletionMutex);
+}
+
 static void lossStatsThreadFunc(void* context) {
     BYTE_BUFFER byteBuffer;
 
@@ -1438,6 +1807,8 @@ static void lossStatsThreadFunc(void* context) {
                 return;
             }
 
+            checkRfiRecoveryTimeout();
+
             // Wait a bit
             PltSleepMsInterruptible(&lossStatsThread, PERIODIC_PING_INTERVAL_MS);
         }
@@ -1479,6 +1850,8 @@ static void lossStatsThreadFunc(void* context) {
                 return;
             }
 
+            checkRfiRecoveryTimeout();
+
             // Wait a bit
             PltSleepMsInterruptible(&lossStatsThread, LOSS_REPORT_INTERVAL_MS);
         }
@@ -1596,16 +1969,7 @@ static void referenceFrameControlFunc(void* context) {
 
         do {
             if (qfit->invalidate) {
-                if (!invalidate) {
-                    invalidateStartFrame = qfit->startFrame;
-                    invalidateEndFrame = qfit->endFrame;
-                    invalidate = true;
-                }
-                else {
-                    // Aggregate all lost frames into one range
-                    LC_ASSERT(qfit->endFrame >= invalidateEndFrame);
-                    invalidateEndFrame = qfit->endFrame;
-                }
+                invalidate = true;
             }
             else {
                 // Send LTR frame ACK
@@ -1614,7 +1978,9 @@ static void referenceFrameControlFunc(void* context) {
             free(qfit);
         } while (LbqPollQueueElement(&referenceFrameControlQueue, (void**)&qfit) == LBQ_SUCCESS);
 
-        if (invalidate) {
+        // The recovery policy has merged all lost frames into one range. There may be
+        // nothing left to send if an IDR frame request superseded it in the meantime.
+        if (invalidate && recoveryPolicyTakeRfiRange(&invalidateStartFrame, &invalidateEndFrame)) {
             // Send the reference frame invalidation request
             requestInvalidateReferenceFrames(invalidateStartFrame, invalidateEndFrame);
         }
@@ -1631,11 +1997,27 @@ static void requestIdrFrameFunc(void* context) {
             return;
         }
 
+        // Repeating our request before the host has had a chance to answer the last
+        // one just adds more IDR frames to a network that is already struggling.
+        uint32_t holdoffMs = recoveryPolicyGetIdrHoldoffMs();
+        if (holdoffMs != 0) {
+            PltSleepMsInterruptible(&requestIdrFrameThread, holdoffMs);
+            if (stopping) {
+                return;
+            }
+
+            // The IDR frame may have arrived while we were waiting
+            if (!recoveryPolicyIsIdrPending()) {
+                continue;
+            }
+        }
+
         // Any pending RFI requests and LTR frame ACK messages are now redundant
         freeBasicLbqList(LbqFlushQueueItems(&referenceFrameControlQueue));
 
         // Request the IDR frame
         requestIdrFrame();
+        recoveryPolicyIdrSent();
     }
 }
 
@@ -1656,7 +2038,7 @@ int stopControlStream(void) {
 
     PltInterruptThread(&lossStatsThread);
     PltInterruptThread(&requestIdrFrameThread);
-    PltInterruptThread(&controlReceiveThread);
+    interruptControlReceiveThread();
     PltInterruptThread(&asyncCallbackThread);
 
     PltJoinThread(&lossStatsThread);
@@ -1671,6 +2053,10 @@ int stopControlStream(void) {
     }
 
     if (peer != NULL) {
+        // The control receive thread is gone, so hand ENet anything it didn't get to
+        processEnetSendQueue();
+        completeAwaitingSendRequests(true);
+
         // Gracefully disconnect to ensure the remote host receives all of our final
         // outbound traffic, including any key up events that might be sent.
         gracefullyDisconnectEnetPeer(client, peer, CONTROL_STREAM_LINGER_TIMEOUT_SEC * 1000);
@@ -1690,11 +2076,13 @@ int stopControlStream(void) {
 }
 
 // Called by the input stream to send a packet for Gen 5+ servers
-int sendInputPacketOnControlStream(unsigned char* data, int length, uint8_t channelId, uint32_t flags, bool moreData) {
+int sendInputPacketOnControlStream(unsigned char* data, int length, uint8_t channelId, uint32_t flags, bool moreData,
+                                   PINPUT_LATENCY_TRACE trace) {
     LC_ASSERT(AppVersionQuad[0] >= 5);
 
-    // Send the input data (no reply expected)
-    if (sendMessageAndForget(packetTypes[IDX_INPUT_DATA], length, data, channelId, flags, moreData) == 0) {
+    // Send the input data (no reply expected). The latency trace is
+    // completed by the control receive thread once the data is sent.
+    if (!queueEnetSendRequest(packetTypes[IDX_INPUT_DATA], length, data, channelId, flags, moreData, trace)) {
         return -1;
     }
 
@@ -1704,30 +2092,32 @@ int sendInputPacketOnControlStream(unsigned char* data, int length, uint8_t chan
 // Called by the input stream to flush queued packets before a batching wait
 void flushInputOnControlStream(void) {
     if (AppVersionQuad[0] >= 5) {
-        PltLockMutex(&enetMutex);
-        enet_host_flush(client);
-        PltUnlockMutex(&enetMutex);
+        PltAtomicStore32(&enetFlushRequested, 1);
+        wakeEnetIoThread();
     }
 }
 
 bool isControlDataInTransit(void) {
-    bool ret = false;
+    // Messages still waiting for the control receive thread haven't even been sent yet
+    if (MrqGetItemCount(&enetSendQueue) > 0) {
+        return true;
+    }
 
-    PltLockMutex(&enetMutex);
+    // We're not synchronized with the control receive thread here, but a stale
+    // answer just means the caller polls once more.
     if (peer != NULL && peer->state == ENET_PEER_STATE_CONNECTED) {
         if (peer->reliableDataInTransit != 0) {
-            ret = true;
+            return true;
         }
     }
-    PltUnlockMutex(&enetMutex);
 
-    return ret;
+    return false;
 }
 
 bool LiGetEstimatedRttInfo(uint32_t* estimatedRtt, uint32_t* estimatedRttVariance) {
     bool ret = false;
 
-    // We do not acquire enetMutex here because we're just reading metrics
+    // We do not synchronize with the control receive thread here because we're just reading metrics
     // and observing a torn write every once in a while is totally fine.
     // The peer pointer points to memory reserved inside the client object,
     // so it's guaranteed that it will never go away underneath us.
@@ -1746,6 +2136,28 @@ bool LiGetEstimatedRttInfo(uint32_t* estimatedRtt, uint32_t* estimatedRttVarianc
     return ret;
 }
 
+bool LiGetControlSendCompletionLatency(uint32_t* p50Us, uint32_t* p90Us, uint32_t* p99Us, uint32_t* timeouts) {
+    // As above, torn reads of these metrics are acceptable
+    if (sendCompletionHistogram.sampleCount == 0) {
+        return false;
+    }
+
+    if (p50Us != NULL) {
+        *p50Us = LhGetPercentile(&sendCompletionHistogram, 50);
+    }
+    if (p90Us != NULL) {
+        *p90Us = LhGetPercentile(&sendCompletionHistogram, 90);
+    }
+    if (p99Us != NULL) {
+        *p99Us = LhGetPercentile(&sendCompletionHistogram, 99);
+    }
+    if (timeouts != NULL) {
+        *timeouts = sendCompletionTimeouts;
+    }
+
+    return true;
+}
+
 // Starts the control stream
 int startControlStream(void) {
     int err;
@@ -1884,7 +2296,7 @@ int startControlStream(void) {
             ConnectionInterrupted = true;
         }
 
-        PltInterruptThread(&controlReceiveThread);
+        interruptControlReceiveThread();
         PltJoinThread(&controlReceiveThread);
 
         if (ctlSock != INVALID_SOCKET) {
@@ -1918,7 +2330,7 @@ int startControlStream(void) {
             ConnectionInterrupted = true;
         }
 
-        PltInterruptThread(&controlReceiveThread);
+        interruptControlReceiveThread();
         PltJoinThread(&controlReceiveThread);
 
         if (ctlSock != INVALID_SOCKET) {
@@ -1945,7 +2357,7 @@ int startControlStream(void) {
             ConnectionInterrupted = true;
         }
 
-        PltInterruptThread(&controlReceiveThread);
+        interruptControlReceiveThread();
         PltJoinThread(&controlReceiveThread);
 
         if (ctlSock != INVALID_SOCKET) {
@@ -1975,7 +2387,7 @@ int startControlStream(void) {
         PltInterruptThread(&lossStatsThread);
         PltJoinThread(&lossStatsThread);
 
-        PltInterruptThread(&controlReceiveThread);
+        interruptControlReceiveThread();
         PltJoinThread(&controlReceiveThread);
 
         if (ctlSock != INVALID_SOCKET) {
@@ -2007,7 +2419,7 @@ int startControlStream(void) {
         PltInterruptThread(&lossStatsThread);
         PltJoinThread(&lossStatsThread);
 
-        PltInterruptThread(&controlReceiveThread);
+        interruptControlReceiveThread();
         PltJoinThread(&controlReceiveThread);
 
         PltInterruptThread(&requestIdrFrameThread);
@@ -2045,7 +2457,7 @@ int startControlStream(void) {
             PltInterruptThread(&lossStatsThread);
             PltJoinThread(&lossStatsThread);
 
-            PltInterruptThread(&controlReceiveThread);
+            interruptControlReceiveThread();
             PltJoinThread(&controlReceiveThread);
 
             PltInterruptThread(&requestIdrFrameThread);
@@ -8,8 +8,8 @@ static bool needsBatchedScroll;
 static int batchedScrollDelta;
 static PPLT_CRYPTO_CONTEXT cryptoContext;
 
-static LINKED_BLOCKING_QUEUE packetQueue;
-static LINKED_BLOCKING_QUEUE packetHolderFreeList;
+static MPMC_RING_QUEUE packetQueue;
+static MPMC_RING_QUEUE packetHolderFreeList;
 static PLT_THREAD inputSendThread;
 
 static float absCurrentPosX;
@@ -21,6 +21,14 @@ static float absCurrentPosY;
 // Accelerometer and gyro
 #define MAX_MOTION_EVENTS 2
 
+// Interval between motion reports the host asked for with each sensor's
+// set motion event message (0 if unlimited) and the time the next report
+// is due. Times are the low 32 bits of PltGetMicroseconds() so they can be
+// updated atomically by any thread reporting motion events. They wrap every
+// ~71 minutes, so a deadline is only ever compared within two intervals of now.
+static volatile uint32_t motionReportIntervalUs[MAX_GAMEPADS][MAX_MOTION_EVENTS];
+static volatile uint32_t motionReportDeadlineUs[MAX_GAMEPADS][MAX_MOTION_EVENTS];
+
 static uint8_t currentPenButtonState;
 
 #define CLAMP(val, min, max) (((val) < (min)) ? (min) : (((val) > (max)) ? (max) : (val)))
@@ -37,21 +45,68 @@ static uint8_t currentPenButtonState;
 #define LI_WHEEL_DELTA 120
 
 // If we try to send more than one stylus or mouse motion event
-// per millisecond, we'll wait a little bit to try to batch with
+// per batching interval, we'll wait a little bit to try to batch with
 // the next one. This batching wait paradoxically _decreases_
 // effective input latency by avoiding packet queuing in ENet.
-#define MOUSE_BATCHING_INTERVAL_MS 1
-#define PEN_BATCHING_INTERVAL_MS 1
+#define DEFAULT_INPUT_BATCHING_INTERVAL_US 1000
+static uint64_t inputBatchingIntervalUs;
+
+// Updated by the input send thread and read by any thread, so each counter is
+// modified atomically.
+static INPUT_BATCHING_STATS inputBatchingStats;
+
+// Messages handed to ENet since it was last flushed. Only touched by the input send thread.
+static uint32_t unflushedMessageCount;
+static uint64_t batchingWindowStartUs;
+static uint64_t batchingWindowEndUs;
+static LATENCY_HISTOGRAM batchingDelayHistogram;
+
+// Written by the control receive thread for messages sent over ENet,
+// otherwise by the input thread
+static LATENCY_HISTOGRAM inputLatencyHistograms[LI_INPUT_LATENCY_TYPE_COUNT][LI_INPUT_LATENCY_STAGE_COUNT];
 
 // Don't batch up/down/cancel events
 #define TOUCH_EVENT_IS_BATCHABLE(x) ((x) == LI_TOUCH_EVENT_HOVER || (x) == LI_TOUCH_EVENT_MOVE)
 
+// Motion events are merged into a queued packet holder until the input thread
+// latches it for sending. Each open batch is tracked in openBatches so that
+// any thread can merge into it without taking a lock.
+#define BATCH_RELATIVE_MOUSE 0
+#define BATCH_ABSOLUTE_MOUSE 1
+#define BATCH_CONTROLLER_BASE 2
+#define BATCH_MOTION_BASE (BATCH_CONTROLLER_BASE + MAX_GAMEPADS)
+#define BATCH_COUNT (BATCH_MOTION_BASE + (MAX_GAMEPADS * MAX_MOTION_EVENTS))
+#define NO_BATCH -1
+
+#define BATCH_STATE_OPEN 0
+#define BATCH_STATE_MERGING 1 // Another event is being merged in
+#define BATCH_STATE_LATCHED 2 // Closed for merging
+
+// Number of times to spin waiting for a merge to finish before sleeping
+#define BATCH_LATCH_SPIN_COUNT 100
+
 // Contains input stream packets
 typedef struct _PACKET_HOLDER {
-    LINKED_BLOCKING_QUEUE_ENTRY entry;
     uint32_t enetPacketFlags;
     uint8_t channelId;
 
+    int batchIndex;
+    volatile uint32_t batchState;
+    uint32_t batchedEvents;
+
+    // Relative mouse deltas can exceed the range of a single packet
+    int relativeDeltaX, relativeDeltaY;
+
+    // Time the first event in this packet was queued and the time
+    // the input thread picked it up
+    uint64_t enqueueTimeUs;
+    uint64_t dequeueTimeUs;
+
+    // Earliest time the input thread may send this packet (0 to send it right away)
+    // and the next packet held by the input thread until its send time
+    uint64_t sendTimeUs;
+    struct _PACKET_HOLDER* nextHeld;
+
     // The union must be the last member since we abuse the NV_UNICODE_PACKET
     // text field to store variable length data which gets split before being
     // sent to the host.
@@ -76,32 +131,46 @@ typedef struct _PACKET_HOLDER {
     } packet;
 } PACKET_HOLDER, *PPACKET_HOLDER;
 
-static PLT_MUTEX batchedInputMutex;
-static PPACKET_HOLDER currentQueuedControllerPacket[MAX_GAMEPADS];
-static struct {
-    float x, y, z;
-    bool dirty; // Update ready to send (queued packet holder in packetQueue)
-} currentGamepadSensorState[MAX_GAMEPADS][MAX_MOTION_EVENTS];
-static struct {
-    int deltaX, deltaY;
-    bool dirty; // Update ready to send (queued packet holder in packetQueue)
-} currentRelativeMouseState;
-static struct {
-    int x, y;
-    int width, height;
-    bool dirty; // Update ready to send (queued packet holder in packetQueue)
-} currentAbsoluteMouseState;
+static void* volatile openBatches[BATCH_COUNT];
+
+// Motion packets that arrived before the host's requested report rate allows
+// them to be sent, ordered by send time. Only touched by the input send thread.
+static PPACKET_HOLDER heldPackets;
+
+// Packet holders are preallocated, so they remain valid for threads that are
+// still looking at an open batch after it has been sent and freed.
+static PPACKET_HOLDER packetHolderPool;
 
 // Initializes the input stream
 int initializeInputStream(void) {
+    int err;
+
     memcpy(currentAesIv, StreamConfig.remoteInputAesIv, sizeof(currentAesIv));
 
     // Set a high maximum queue size limit to ensure input isn't dropped
     // while the input send thread is blocked for short periods.
-    LbqInitializeLinkedBlockingQueue(&packetQueue, MAX_QUEUED_INPUT_PACKETS);
-    LbqInitializeLinkedBlockingQueue(&packetHolderFreeList, MAX_QUEUED_INPUT_PACKETS);
+    err = MrqInitializeQueue(&packetQueue, MAX_QUEUED_INPUT_PACKETS);
+    if (err != 0) {
+        return err;
+    }
+
+    err = MrqInitializeQueue(&packetHolderFreeList, MAX_QUEUED_INPUT_PACKETS);
+    if (err != 0) {
+        MrqDestroyQueue(&packetQueue);
+        return err;
+    }
+
+    // If this allocation fails, we'll just allocate holders as needed
+    packetHolderPool = malloc(MAX_QUEUED_INPUT_PACKETS * sizeof(*packetHolderPool));
+    if (packetHolderPool != NULL) {
+        for (int i = 0; i < MAX_QUEUED_INPUT_PACKETS; i++) {
+            packetHolderPool[i].batchState = BATCH_STATE_LATCHED;
+            MrqOfferQueueItem(&packetHolderFreeList, &packetHolderPool[i]);
+        }
+    }
 
     cryptoContext = PltCreateCryptoContext();
+    PltSetCryptoContextStatsType(cryptoContext, CRYPTO_STATS_TYPE_INPUT);
     encryptedControlStream = APP_VERSION_AT_LEAST(7, 1, 431);
 
     // FIXME: Unsure if this is exactly right, but it's probably good enough.
@@ -118,43 +187,67 @@ int initializeInputStream(void) {
     // Start with the virtual mouse centered
     absCurrentPosX = absCurrentPosY = 0.5f;
 
-    memset(currentGamepadSensorState, 0, sizeof(currentGamepadSensorState));
-    memset(&currentRelativeMouseState, 0, sizeof(currentRelativeMouseState));
-    memset(&currentAbsoluteMouseState, 0, sizeof(currentAbsoluteMouseState));
-    PltCreateMutex(&batchedInputMutex);
+    memset((void*)openBatches, 0, sizeof(openBatches));
+    memset((void*)motionReportIntervalUs, 0, sizeof(motionReportIntervalUs));
+    memset((void*)motionReportDeadlineUs, 0, sizeof(motionReportDeadlineUs));
+
+    if (StreamConfig.inputBatchingIntervalUs > 0) {
+        inputBatchingIntervalUs = (uint64_t)StreamConfig.inputBatchingIntervalUs;
+    }
+    else {
+        inputBatchingIntervalUs = DEFAULT_INPUT_BATCHING_INTERVAL_US;
+    }
+
+    batchingWindowStartUs = batchingWindowEndUs = 0;
+    memset(&inputBatchingStats, 0, sizeof(inputBatchingStats));
+    unflushedMessageCount = 0;
+    heldPackets = NULL;
+    LhInitializeHistogram(&batchingDelayHistogram);
+
+    for (int i = 0; i < LI_INPUT_LATENCY_TYPE_COUNT; i++) {
+        for (int j = 0; j < LI_INPUT_LATENCY_STAGE_COUNT; j++) {
+            LhInitializeHistogram(&inputLatencyHistograms[i][j]);
+        }
+    }
 
     return 0;
 }
 
+static bool isPooledPacketHolder(PPACKET_HOLDER holder) {
+    return packetHolderPool != NULL &&
+           (uintptr_t)holder >= (uintptr_t)&packetHolderPool[0] &&
+           (uintptr_t)holder < (uintptr_t)&packetHolderPool[MAX_QUEUED_INPUT_PACKETS];
+}
+
 // Destroys and cleans up the input stream
 void destroyInputStream(void) {
-    PLINKED_BLOCKING_QUEUE_ENTRY entry, nextEntry;
+    PPACKET_HOLDER holder;
 
     PltDestroyCryptoContext(cryptoContext);
 
-    entry = LbqDestroyLinkedBlockingQueue(&packetQueue);
-
-    while (entry != NULL) {
-        nextEntry = entry->flink;
-
-        // The entry is stored in the data buffer
-        free(entry->data);
-
-        entry = nextEntry;
+    // The input send thread has exited, so nothing else will send these
+    while (heldPackets != NULL) {
+        holder = heldPackets;
+        heldPackets = holder->nextHeld;
+        if (!isPooledPacketHolder(holder)) {
+            free(holder);
+        }
     }
 
-    entry = LbqDestroyLinkedBlockingQueue(&packetHolderFreeList);
-
-    while (entry != NULL) {
-        nextEntry = entry->flink;
-
-        // The entry is stored in the data buffer
-        free(entry->data);
+    while (MrqReclaimQueueElement(&packetQueue, (void**)&holder)) {
+        if (!isPooledPacketHolder(holder)) {
+            free(holder);
+        }
+    }
+    MrqDestroyQueue(&packetQueue);
 
-        entry = nextEntry;
+    while (MrqReclaimQueueElement(&packetHolderFreeList, (void**)&holder)) {
+        LC_ASSERT(isPooledPacketHolder(holder));
     }
+    MrqDestroyQueue(&packetHolderFreeList);
 
-    PltDeleteMutex(&batchedInputMutex);
+    free(packetHolderPool);
+    packetHolderPool = NULL;
 }
 
 static int encryptData(unsigned char* plaintext, int plaintextLen,
@@ -195,8 +288,12 @@ static int encryptData(unsigned char* plaintext, int plaintextLen,
 static void freePacketHolder(PPACKET_HOLDER holder) {
     LC_ASSERT(holder->packet.header.size != 0);
 
-    // Place the packet holder back into the free list if it's a standard size entry
-    if (PACKET_SIZE(holder) > (int)sizeof(*holder) || LbqOfferQueueItem(&packetHolderFreeList, holder, &holder->entry) != LBQ_SUCCESS) {
+    // Place the packet holder back into the free list if it came from the pool. If the
+    // free list has been shut down, the pool will be freed with the input stream.
+    if (isPooledPacketHolder(holder)) {
+        MrqOfferQueueItem(&packetHolderFreeList, holder);
+    }
+    else {
         free(holder);
     }
 }
@@ -210,31 +307,193 @@ static PPACKET_HOLDER allocatePacketHolder(int extraLength) {
     if (extraLength > 0) {
         // We over-allocate here a bit since we're always adding sizeof(*holder),
         // but this is on purpose. It allows us assume we have a full holder even
-        // if packetLength < sizeof(*holder) and put this allocation into the free
-        // list.
-        return malloc(sizeof(*holder) + extraLength);
+        // if packetLength < sizeof(*holder).
+        holder = malloc(sizeof(*holder) + extraLength);
+    }
+    else {
+        // Grab an entry from the free list (if available)
+        err = MrqPollQueueElement(&packetHolderFreeList, (void**)&holder);
+        if (err == LBQ_INTERRUPTED) {
+            // We're shutting down. Don't bother allocating.
+            return NULL;
+        }
+        else if (err != LBQ_SUCCESS) {
+            LC_ASSERT(err == LBQ_NO_ELEMENT);
+
+            // Otherwise we'll have to allocate
+            holder = malloc(sizeof(*holder));
+        }
     }
 
-    // Grab an entry from the free list (if available)
-    err = LbqPollQueueElement(&packetHolderFreeList, (void**)&holder);
-    if (err == LBQ_SUCCESS) {
-        return holder;
+    if (holder != NULL) {
+        holder->enqueueTimeUs = PltGetMicroseconds();
+        holder->sendTimeUs = 0;
+
+        // Pooled holders are already latched, but a thread that's racing to merge
+        // into a stale batch may still be looking at this one.
+        holder->batchIndex = NO_BATCH;
+        PltAtomicStore32(&holder->batchState, BATCH_STATE_LATCHED);
+    }
+
+    return holder;
+}
+
+// Stops any more events from being merged into a batch holder
+static void latchBatchHolder(PPACKET_HOLDER holder) {
+    if (holder->batchIndex == NO_BATCH) {
+        return;
     }
-    else if (err == LBQ_INTERRUPTED) {
-        // We're shutting down. Don't bother allocating.
+
+    // Other threads only hold a batch for the few instructions it takes to merge an event,
+    // but they may be preempted while doing so. Don't burn a whole timeslice waiting on them.
+    for (int spins = 0; !PltAtomicCompareExchange32(&holder->batchState, BATCH_STATE_OPEN, BATCH_STATE_LATCHED); spins++) {
+        if (spins < BATCH_LATCH_SPIN_COUNT) {
+            PltCpuRelax();
+        }
+        else {
+            PltSleepUs(1);
+        }
+    }
+
+    // Later events will start a new batch. It's possible that the enqueuing code already
+    // moved on to a new batch because something (like a button change) forced it to end
+    // this one, so we must only clear the open batch if it's still this holder.
+    PltAtomicCompareExchangePtr(&openBatches[holder->batchIndex], holder, NULL);
+}
+
+// Takes ownership of the open batch to merge a new event into it. Returns NULL
+// if there is no open batch.
+static PPACKET_HOLDER beginBatchMerge(int batchIndex) {
+    PPACKET_HOLDER holder = PltAtomicLoadPtr(&openBatches[batchIndex]);
+
+    if (holder == NULL || !PltAtomicCompareExchange32(&holder->batchState, BATCH_STATE_OPEN, BATCH_STATE_MERGING)) {
         return NULL;
     }
-    else {
-        LC_ASSERT(err == LBQ_NO_ELEMENT);
 
-        // Otherwise we'll have to allocate
-        return malloc(sizeof(*holder));
+    // The holder may have been sent and reused for another batch after we loaded
+    // it, so make sure it's still the open batch now that nobody else can latch it.
+    if (PltAtomicLoadPtr(&openBatches[batchIndex]) != holder) {
+        PltAtomicStore32(&holder->batchState, BATCH_STATE_OPEN);
+        return NULL;
     }
+
+    return holder;
+}
+
+static void endBatchMerge(PPACKET_HOLDER holder, bool merged) {
+    if (merged) {
+        holder->batchedEvents++;
+    }
+    PltAtomicStore32(&holder->batchState, BATCH_STATE_OPEN);
+}
+
+// Queues a packet holder and opens a batch for later events to be merged into it
+static int queueBatchHolder(PPACKET_HOLDER holder, int batchIndex) {
+    int err;
+
+    holder->batchedEvents = 1;
+
+    // Holders from outside the pool are freed after they're sent, so they can't
+    // be left where another thread could still find them.
+    if (isPooledPacketHolder(holder)) {
+        holder->batchIndex = batchIndex;
+        PltAtomicStore32(&holder->batchState, BATCH_STATE_OPEN);
+        PltAtomicStorePtr(&openBatches[batchIndex], holder);
+    }
+
+    err = MrqOfferQueueItem(&packetQueue, holder);
+    if (err != LBQ_SUCCESS) {
+        LC_ASSERT(err == LBQ_BOUND_EXCEEDED);
+        Limelog("Input queue reached maximum size limit\n");
+
+        // Any events merged in the meantime are lost, but the next one will start a new batch
+        latchBatchHolder(holder);
+        freePacketHolder(holder);
+    }
+
+    return err;
+}
+
+// Returns the LI_INPUT_LATENCY_* event type of the packet or -1 if it isn't traced
+static int getInputLatencyEventType(PPACKET_HOLDER holder) {
+    switch (holder->channelId) {
+    case CTRL_CHANNEL_KEYBOARD:
+    case CTRL_CHANNEL_UTF8:
+        return LI_INPUT_LATENCY_KEYBOARD;
+    case CTRL_CHANNEL_MOUSE:
+        // Buttons and scroll events share the mouse channel with motion
+        if (holder->packet.header.magic == LE32(MOUSE_MOVE_ABS_MAGIC) ||
+            holder->packet.header.magic == LE32(AppVersionQuad[0] >= 5 ? MOUSE_MOVE_REL_MAGIC_GEN5 : MOUSE_MOVE_REL_MAGIC)) {
+            return LI_INPUT_LATENCY_MOUSE_MOTION;
+        }
+        return LI_INPUT_LATENCY_MOUSE_BUTTON;
+    case CTRL_CHANNEL_PEN:
+        return LI_INPUT_LATENCY_PEN;
+    case CTRL_CHANNEL_TOUCH:
+        return LI_INPUT_LATENCY_TOUCH;
+    default:
+        if (holder->channelId >= CTRL_CHANNEL_SENSOR_BASE) {
+            return LI_INPUT_LATENCY_MOTION_SENSOR;
+        }
+        else if (holder->channelId >= CTRL_CHANNEL_GAMEPAD_BASE) {
+            return LI_INPUT_LATENCY_CONTROLLER;
+        }
+        return -1;
+    }
+}
+
+// Called once the message has been written to the socket. For messages sent over
+// ENet, this happens on the control receive thread.
+void recordInputLatencyTrace(PINPUT_LATENCY_TRACE trace, uint64_t flushTimeUs) {
+    PLATENCY_HISTOGRAM histograms = inputLatencyHistograms[trace->eventType];
+
+    LhAddSample(&histograms[LI_INPUT_LATENCY_STAGE_QUEUE], trace->dequeueTimeUs - trace->enqueueTimeUs);
+    LhAddSample(&histograms[LI_INPUT_LATENCY_STAGE_BATCH], trace->readyTimeUs - trace->dequeueTimeUs);
+    LhAddSample(&histograms[LI_INPUT_LATENCY_STAGE_SEND], trace->handoffTimeUs - trace->readyTimeUs);
+    LhAddSample(&histograms[LI_INPUT_LATENCY_STAGE_FLUSH], flushTimeUs - trace->handoffTimeUs);
+    LhAddSample(&histograms[LI_INPUT_LATENCY_STAGE_TOTAL], flushTimeUs - trace->enqueueTimeUs);
+}
+
+// Returns false if this type of packet isn't traced
+static bool initializeInputLatencyTrace(PPACKET_HOLDER holder, uint64_t readyTimeUs, PINPUT_LATENCY_TRACE trace) {
+    trace->eventType = getInputLatencyEventType(holder);
+    if (trace->eventType < 0) {
+        return false;
+    }
+
+    trace->enqueueTimeUs = holder->enqueueTimeUs;
+    trace->dequeueTimeUs = holder->dequeueTimeUs;
+    trace->readyTimeUs = readyTimeUs;
+    trace->handoffTimeUs = 0;
+    return true;
+}
+
+static void addInputBatchingStat(uint32_t* counter, uint32_t count) {
+    PltAtomicAdd32((volatile uint32_t*)counter, count);
+}
+
+// Called when the messages handed to ENet since the last flush are written out.
+// Every message after the first one shared its datagram with an earlier message.
+static void countFlushedMessages(void) {
+    if (unflushedMessageCount > 1) {
+        addInputBatchingStat(&inputBatchingStats.datagramsSaved, unflushedMessageCount - 1);
+    }
+    unflushedMessageCount = 0;
+}
+
+static void flushBatchedInput(void) {
+    flushInputOnControlStream();
+    countFlushedMessages();
 }
 
 static bool sendInputPacket(PPACKET_HOLDER holder, bool moreData) {
+    INPUT_LATENCY_TRACE trace;
+    PINPUT_LATENCY_TRACE tracePtr;
     SOCK_RET err;
 
+    // The control receive thread finishes the trace when it writes the datagram
+    tracePtr = initializeInputLatencyTrace(holder, PltGetMicroseconds(), &trace) ? &trace : NULL;
+
     // On GFE 3.22, the entire control stream is encrypted (and support for separate RI encrypted)
     // has been removed. We send the plaintext packet through and the control stream code will do
     // the encryption.
@@ -243,7 +502,8 @@ static bool sendInputPacket(PPACKET_HOLDER holder, bool moreData) {
                                                         PACKET_SIZE(holder),
                                                         holder->channelId,
                                                         holder->enetPacketFlags,
-                                                        moreData);
+                                                        moreData,
+                                                        tracePtr);
         if (err < 0) {
             Limelog("Input: sendInputPacketOnControlStream() failed: %d\n", (int) err);
             ListenerCallbacks.connectionTerminated(err);
@@ -278,6 +538,12 @@ static bool sendInputPacket(PPACKET_HOLDER holder, bool moreData) {
                 ListenerCallbacks.connectionTerminated(LastSocketFail());
                 return false;
             }
+
+            // The TCP input socket doesn't hold messages back
+            if (tracePtr != NULL) {
+                trace.handoffTimeUs = PltGetMicroseconds();
+                recordInputLatencyTrace(&trace, trace.handoffTimeUs);
+            }
         }
         else {
             // For reasons that I can't understand, NVIDIA decides to use the last 16
@@ -294,7 +560,8 @@ static bool sendInputPacket(PPACKET_HOLDER holder, bool moreData) {
                                                             (int)(encryptedSize + sizeof(encryptedLengthPrefix)),
                                                             holder->channelId,
                                                             holder->enetPacketFlags,
-                                                            moreData);
+                                                            moreData,
+                                                            tracePtr);
             if (err < 0) {
                 Limelog("Input: sendInputPacketOnControlStream() failed: %d\n", (int) err);
                 ListenerCallbacks.connectionTerminated(err);
@@ -303,6 +570,15 @@ static bool sendInputPacket(PPACKET_HOLDER holder, bool moreData) {
         }
     }
 
+    // Deferring the flush lets ENet put this message in the same datagram as the next one,
+    // but that only saves anything if another message is sent before the flush happens.
+    if (AppVersionQuad[0] >= 5) {
+        unflushedMessageCount++;
+        if (!moreData) {
+            countFlushedMessages();
+        }
+    }
+
     return true;
 }
 
@@ -319,7 +595,93 @@ static void floatToNetfloat(float in, netfloat out) {
     }
 }
 
+// Waits for the end of the current batching window and returns the current time. Motion
+// packets of all types share a single window, so everything that arrives during the window
+// leaves together at its end and ENet can bundle it into one datagram. Packets that arrive
+// while no window is open go out immediately and open a new one.
+static uint64_t waitForBatchingWindow(uint64_t firstEventTimeUs) {
+    uint64_t now = PltGetMicroseconds();
+
+    if (now >= batchingWindowEndUs) {
+        batchingWindowStartUs = now;
+        batchingWindowEndUs = now + inputBatchingIntervalUs;
+    }
+    else if (firstEventTimeUs >= batchingWindowStartUs) {
+        // Get any input that's already waiting out the door before we sleep
+        flushBatchedInput();
+
+        // Some platforms may wake up early, so keep sleeping until we reach the deadline
+        do {
+            PltSleepUs(batchingWindowEndUs - now);
+            now = PltGetMicroseconds();
+        } while (now < batchingWindowEndUs);
+
+        addInputBatchingStat(&inputBatchingStats.delayedPackets, 1);
+
+        // Anything that arrives from here on waits for the next window
+        batchingWindowStartUs = batchingWindowEndUs;
+        batchingWindowEndUs += inputBatchingIntervalUs;
+    }
+
+    // Otherwise this packet was already queued when the window opened, so it can
+    // go out right away alongside the packet that opened it.
+    return now;
+}
+
+static void recordBatchedPacket(uint32_t* packets, uint32_t* events, uint32_t mergedEvents,
+                                uint64_t firstEventTimeUs, uint64_t sendTimeUs) {
+    addInputBatchingStat(packets, 1);
+    addInputBatchingStat(events, mergedEvents);
+    if (mergedEvents > inputBatchingStats.maxEventsPerPacket) {
+        PltAtomicStore32((volatile uint32_t*)&inputBatchingStats.maxEventsPerPacket, mergedEvents);
+    }
+
+    LhAddSample(&batchingDelayHistogram, sendTimeUs - firstEventTimeUs);
+}
+
 // Input thread proc
+// Holds a packet until its send time. Later events keep merging into it
+// because it isn't latched until it's sent.
+static void holdPacket(PPACKET_HOLDER holder) {
+    PPACKET_HOLDER* link = &heldPackets;
+
+    while (*link != NULL && (*link)->sendTimeUs <= holder->sendTimeUs) {
+        link = &(*link)->nextHeld;
+    }
+
+    holder->nextHeld = *link;
+    *link = holder;
+}
+
+// Returns the next packet to send, which is either a held packet that is now due or
+// the next packet in the queue. While packets are held, the queue is polled no less
+// often than once per batching interval so other input isn't delayed behind them.
+static int waitForInputPacket(PPACKET_HOLDER* holder) {
+    for (;;) {
+        uint64_t now;
+        int err;
+
+        if (heldPackets == NULL) {
+            return MrqWaitForQueueElement(&packetQueue, (void**)holder);
+        }
+
+        now = PltGetMicroseconds();
+        if (heldPackets->sendTimeUs <= now) {
+            *holder = heldPackets;
+            heldPackets = heldPackets->nextHeld;
+            return LBQ_SUCCESS;
+        }
+
+        err = MrqPollQueueElement(&packetQueue, (void**)holder);
+        if (err != LBQ_NO_ELEMENT) {
+            return err;
+        }
+
+        PltSleepUs(heldPackets->sendTimeUs - now < inputBatchingIntervalUs ?
+                   heldPackets->sendTimeUs - now : inputBatchingIntervalUs);
+    }
+}
+
 static void inputSendThreadProc(void* context) {
     SOCK_RET err;
     PPACKET_HOLDER holder;
@@ -335,98 +697,79 @@ static void inputSendThreadProc(void* context) {
         relMouseMagicLE = LE32(MOUSE_MOVE_REL_MAGIC);
     }
 
-    uint64_t lastMousePacketTime = 0;
-    uint64_t lastPenPacketTime = 0;
-
     while (!PltIsThreadInterrupted(&inputSendThread)) {
-        err = LbqWaitForQueueElement(&packetQueue, (void**)&holder);
+        err = waitForInputPacket(&holder);
         if (err != LBQ_SUCCESS) {
             return;
         }
 
-        // If it's a multi-controller packet, latch it by clearing currentQueuedControllerPacket.
-        // This will prevent another thread from batching additional data into it while we're
-        // trying to send it.
-        if (holder->packet.header.magic == multiControllerMagicLE) {
-            short controllerNumber = LE16(holder->packet.multiController.controllerNumber);
+        holder->dequeueTimeUs = PltGetMicroseconds();
 
-            PltLockMutex(&batchedInputMutex);
-
-            // It's possible that the enqueuing code already moved on to batching into a new
-            // packet because something (like a button change) forced it to end the batch.
-            // We only need to stop batching into the current packet we're sending here, so
-            // it's fine if the input code continues to update a later packet concurrently.
-            if (holder == currentQueuedControllerPacket[controllerNumber]) {
-                currentQueuedControllerPacket[controllerNumber] = NULL;
-            }
+        // Motion packets that arrived ahead of the host's report rate wait for their deadline
+        if (holder->sendTimeUs > holder->dequeueTimeUs) {
+            addInputBatchingStat(&inputBatchingStats.motionPacketsHeld, 1);
+            holdPacket(holder);
+            continue;
+        }
 
-            PltUnlockMutex(&batchedInputMutex);
+        // If it's a multi-controller packet, latch it to prevent another thread from
+        // batching additional data into it while we're trying to send it.
+        if (holder->packet.header.magic == multiControllerMagicLE) {
+            latchBatchHolder(holder);
         }
         // If it's a relative mouse move packet, we can do batching
         else if (holder->packet.header.magic == relMouseMagicLE) {
-            uint64_t now = PltGetMillis();
-
-            // Delay for batching if required
-            if (now < lastMousePacketTime + MOUSE_BATCHING_INTERVAL_MS) {
-                flushInputOnControlStream();
-                PltSleepMs((int)(lastMousePacketTime + MOUSE_BATCHING_INTERVAL_MS - now));
-                now = PltGetMillis();
-            }
+            uint64_t now = waitForBatchingWindow(holder->enqueueTimeUs);
+            int deltaX, deltaY;
 
-            PltLockMutex(&batchedInputMutex);
+            // The deltas can't change after the holder is latched
+            latchBatchHolder(holder);
+            deltaX = holder->relativeDeltaX;
+            deltaY = holder->relativeDeltaY;
 
             // Send as many packets as it takes to get the entire delta through
-            while (currentRelativeMouseState.deltaX != 0 || currentRelativeMouseState.deltaY != 0) {
+            while (deltaX != 0 || deltaY != 0) {
                 bool more = false;
 
-                if (currentRelativeMouseState.deltaX < INT16_MIN) {
+                if (deltaX < INT16_MIN) {
                     holder->packet.mouseMoveRel.deltaX = BE16(INT16_MIN);
-                    currentRelativeMouseState.deltaX -= INT16_MIN;
+                    deltaX -= INT16_MIN;
                     more = true;
                 }
-                else if (currentRelativeMouseState.deltaX > INT16_MAX) {
+                else if (deltaX > INT16_MAX) {
                     holder->packet.mouseMoveRel.deltaX = BE16(INT16_MAX);
-                    currentRelativeMouseState.deltaX -= INT16_MAX;
+                    deltaX -= INT16_MAX;
                     more = true;
                 }
                 else {
-                    holder->packet.mouseMoveRel.deltaX = BE16(currentRelativeMouseState.deltaX);
-                    currentRelativeMouseState.deltaX = 0;
+                    holder->packet.mouseMoveRel.deltaX = BE16(deltaX);
+                    deltaX = 0;
                 }
 
-                if (currentRelativeMouseState.deltaY < INT16_MIN) {
+                if (deltaY < INT16_MIN) {
                     holder->packet.mouseMoveRel.deltaY = BE16(INT16_MIN);
-                    currentRelativeMouseState.deltaY -= INT16_MIN;
+                    deltaY -= INT16_MIN;
                     more = true;
                 }
-                else if (currentRelativeMouseState.deltaY > INT16_MAX) {
+                else if (deltaY > INT16_MAX) {
                     holder->packet.mouseMoveRel.deltaY = BE16(INT16_MAX);
-                    currentRelativeMouseState.deltaY -= INT16_MAX;
+                    deltaY -= INT16_MAX;
                     more = true;
                 }
                 else {
-                    holder->packet.mouseMoveRel.deltaY = BE16(currentRelativeMouseState.deltaY);
-                    currentRelativeMouseState.deltaY = 0;
+                    holder->packet.mouseMoveRel.deltaY = BE16(deltaY);
+                    deltaY = 0;
                 }
 
-                // Don't hold the batching lock while we're doing network I/O
-                PltUnlockMutex(&batchedInputMutex);
-
                 // Encrypt and send the split packet
-                if (!sendInputPacket(holder, more)) {
+                if (!sendInputPacket(holder, more || MrqGetItemCount(&packetQueue) > 0)) {
                     freePacketHolder(holder);
                     return;
                 }
-
-                PltLockMutex(&batchedInputMutex);
             }
 
-            // The state change is no longer pending
-            currentRelativeMouseState.dirty = false;
-
-            PltUnlockMutex(&batchedInputMutex);
-
-            lastMousePacketTime = now;
+            recordBatchedPacket(&inputBatchingStats.mousePackets, &inputBatchingStats.mouseEvents,
+                                holder->batchedEvents, holder->enqueueTimeUs, now);
 
             // We sent everything we needed in the loop above, so we can just free the
             // holder of the original packet and wait for another input event.
@@ -435,52 +778,25 @@ static void inputSendThreadProc(void* context) {
         }
         // If it's an absolute mouse move packet, we should only send the latest
         else if (holder->packet.header.magic == LE32(MOUSE_MOVE_ABS_MAGIC)) {
-            uint64_t now = PltGetMillis();
+            uint64_t now = waitForBatchingWindow(holder->enqueueTimeUs);
 
-            // Delay for batching if required
-            if (now < lastMousePacketTime + MOUSE_BATCHING_INTERVAL_MS) {
-                flushInputOnControlStream();
-                PltSleepMs((int)(lastMousePacketTime + MOUSE_BATCHING_INTERVAL_MS - now));
-                now = PltGetMillis();
-            }
-
-            PltLockMutex(&batchedInputMutex);
-
-            // Populate the packet with the latest state
-            holder->packet.mouseMoveAbs.x = BE16(currentAbsoluteMouseState.x);
-            holder->packet.mouseMoveAbs.y = BE16(currentAbsoluteMouseState.y);
-
-            // There appears to be a rounding error in GFE's scaling calculation which prevents
-            // the cursor from reaching the far edge of the screen when streaming at smaller
-            // resolutions with a higher desktop resolution (like streaming 720p with a desktop
-            // resolution of 1080p, or streaming 720p/1080p with a desktop resolution of 4K).
-            // Subtracting one from the reference dimensions seems to work around this issue.
-            holder->packet.mouseMoveAbs.width = BE16(currentAbsoluteMouseState.width - 1);
-            holder->packet.mouseMoveAbs.height = BE16(currentAbsoluteMouseState.height - 1);
-
-            // The state change is no longer pending
-            currentAbsoluteMouseState.dirty = false;
+            // The packet already has the latest position
+            latchBatchHolder(holder);
 
-            PltUnlockMutex(&batchedInputMutex);
-
-            lastMousePacketTime = now;
+            recordBatchedPacket(&inputBatchingStats.mousePackets, &inputBatchingStats.mouseEvents,
+                                holder->batchedEvents, holder->enqueueTimeUs, now);
         }
         // If it's a pen packet, we should only send the latest move or hover events
         else if (holder->packet.header.magic == LE32(SS_PEN_MAGIC) && TOUCH_EVENT_IS_BATCHABLE(holder->packet.pen.eventType)) {
-            uint64_t now = PltGetMillis();
-
-            // Delay for batching if required
-            if (now < lastPenPacketTime + PEN_BATCHING_INTERVAL_MS) {
-                flushInputOnControlStream();
-                PltSleepMs((int)(lastPenPacketTime + PEN_BATCHING_INTERVAL_MS - now));
-                now = PltGetMillis();
-            }
+            uint64_t firstEventTimeUs = holder->enqueueTimeUs;
+            uint64_t now = waitForBatchingWindow(firstEventTimeUs);
+            uint32_t mergedEvents = 1;
 
             for (;;) {
                 PPACKET_HOLDER penBatchHolder;
 
                 // Peek at the next packet
-                if (LbqPeekQueueElement(&packetQueue, (void**)&penBatchHolder) != LBQ_SUCCESS) {
+                if (MrqPeekQueueElement(&packetQueue, (void**)&penBatchHolder) != LBQ_SUCCESS) {
                     break;
                 }
 
@@ -496,52 +812,30 @@ static void inputSendThreadProc(void* context) {
                 }
 
                 // Remove the next packet
-                if (LbqPollQueueElement(&packetQueue, (void**)&penBatchHolder) != LBQ_SUCCESS) {
+                if (MrqPollQueueElement(&packetQueue, (void**)&penBatchHolder) != LBQ_SUCCESS) {
                     break;
                 }
 
                 // Replace the current packet with the new one
+                penBatchHolder->enqueueTimeUs = firstEventTimeUs;
+                penBatchHolder->dequeueTimeUs = holder->dequeueTimeUs;
                 freePacketHolder(holder);
                 holder = penBatchHolder;
+                mergedEvents++;
             }
 
-            lastPenPacketTime = now;
+            recordBatchedPacket(&inputBatchingStats.penPackets, &inputBatchingStats.penEvents,
+                                mergedEvents, firstEventTimeUs, now);
         }
         // If it's a motion packet, only send the latest for each sensor type
         else if (holder->packet.header.magic == LE32(SS_CONTROLLER_MOTION_MAGIC)) {
-            uint8_t controllerNumber = holder->packet.controllerMotion.controllerNumber;
-            uint8_t motionType = holder->packet.controllerMotion.motionType;
-
-            LC_ASSERT(controllerNumber < MAX_GAMEPADS);
-            LC_ASSERT(motionType - 1 < MAX_MOTION_EVENTS);
-
-            PltLockMutex(&batchedInputMutex);
+            uint64_t now = waitForBatchingWindow(holder->enqueueTimeUs);
 
-            // LI_MOTION_TYPE_* values are 1-based, so we have to subtract 1 to index into our state array
-            float x = currentGamepadSensorState[controllerNumber][motionType - 1].x;
-            float y = currentGamepadSensorState[controllerNumber][motionType - 1].y;
-            float z = currentGamepadSensorState[controllerNumber][motionType - 1].z;
+            // The packet already has the latest sensor values
+            latchBatchHolder(holder);
 
-            // Motion events are so rapid that we can just drop any events that are lost in transit,
-            // but we will treat (0, 0, 0) as a special value for gyro events to allow clients to
-            // reliably set the gyro to a null state when sensor events are halted due to focus loss
-            // or similar client-side constraints.
-            if (motionType == LI_MOTION_TYPE_GYRO && x == 0.0f && y == 0.0f && z == 0.0f) {
-                holder->enetPacketFlags = ENET_PACKET_FLAG_RELIABLE;
-            }
-            else {
-                holder->enetPacketFlags = 0;
-            }
-
-            // Populate the packet with the latest state
-            floatToNetfloat(x, holder->packet.controllerMotion.x);
-            floatToNetfloat(y, holder->packet.controllerMotion.y);
-            floatToNetfloat(z, holder->packet.controllerMotion.z);
-
-            // The state change is no longer pending
-            currentGamepadSensorState[controllerNumber][motionType - 1].dirty = false;
-
-            PltUnlockMutex(&batchedInputMutex);
+            recordBatchedPacket(&inputBatchingStats.motionPackets, &inputBatchingStats.motionEvents,
+                                holder->batchedEvents, holder->enqueueTimeUs, now);
         }
         // If it's a UTF-8 text packet, we may need to split it into a several packets to send
         else if (holder->packet.header.magic == LE32(UTF8_TEXT_EVENT_MAGIC)) {
@@ -553,7 +847,7 @@ static void inputSendThreadProc(void* context) {
             // and UTF-8 text events with each other. We need to make sure any previous keyboard events
             // have been processed prior to sending these UTF-8 events to avoid interference between
             // the two (especially with modifier keys).
-            flushInputOnControlStream();
+            flushBatchedInput();
             while (!PltIsThreadInterrupted(&inputSendThread) && isControlDataInTransit()) {
                 PltSleepMs(10);
             }
@@ -606,7 +900,7 @@ static void inputSendThreadProc(void* context) {
         }
 
         // Encrypt and send the input packet
-        if (!sendInputPacket(holder, LbqGetItemCount(&packetQueue) > 0)) {
+        if (!sendInputPacket(holder, MrqGetItemCount(&packetQueue) > 0)) {
             freePacketHolder(holder);
             return;
         }
@@ -637,7 +931,7 @@ static int sendEnableHaptics(void) {
     holder->packet.haptics.header.magic = LE32(ENABLE_HAPTICS_MAGIC);
     holder->packet.haptics.enable = LE16(1);
 
-    err = LbqOfferQueueItem(&packetQueue, holder, &holder->entry);
+    err = MrqOfferQueueItem(&packetQueue, holder);
     if (err != LBQ_SUCCESS) {
         LC_ASSERT(err == LBQ_BOUND_EXCEEDED);
         Limelog("Input queue reached maximum size limit\n");
@@ -684,11 +978,11 @@ int startInputStream(void) {
 int stopInputStream(void) {
     // No more packets should be queued now
     initialized = false;
-    LbqSignalQueueShutdown(&packetHolderFreeList);
+    MrqSignalQueueShutdown(&packetHolderFreeList);
 
     // Signal the input send thread to drain all pending
     // input packets before shutting down.
-    LbqSignalQueueDrain(&packetQueue);
+    MrqSignalQueueDrain(&packetQueue);
     PltJoinThread(&inputSendThread);
 
     if (inputSock != INVALID_SOCKET) {
@@ -706,7 +1000,6 @@ int stopInputStream(void) {
 // Send a mouse move event to the streaming machine
 int LiSendMouseMoveEvent(short deltaX, short deltaY) {
     PPACKET_HOLDER holder;
-    int err;
 
     if (!initialized) {
         return -2;
@@ -716,58 +1009,52 @@ int LiSendMouseMoveEvent(short deltaX, short deltaY) {
         return 0;
     }
 
-    PltLockMutex(&batchedInputMutex);
-
-    // Combine the previous deltas with the new one
-    currentRelativeMouseState.deltaX += deltaX;
-    currentRelativeMouseState.deltaY += deltaY;
-
-    // Queue a packet holder if this is the only pending relative mouse event
-    if (!currentRelativeMouseState.dirty) {
-        // Set the dirty flag to claim ownership of inserting the packet holder
-        // and unlock to allow other threads to enqueue or process input.
-        currentRelativeMouseState.dirty = true;
-        PltUnlockMutex(&batchedInputMutex);
-
-        holder = allocatePacketHolder(0);
-        if (holder == NULL) {
-            currentRelativeMouseState.dirty = false;
-            return -1;
-        }
-
-        holder->channelId = CTRL_CHANNEL_MOUSE;
-
-        // TODO: Send this as unreliable sequenced when we have a delayed reliable retransmission thread
-        // and protocol updates to allow us to determine which unreliable messages were dropped.
-        holder->enetPacketFlags = ENET_PACKET_FLAG_RELIABLE;
+    // Combine the new deltas with the queued ones if there's a pending relative mouse event
+    holder = beginBatchMerge(BATCH_RELATIVE_MOUSE);
+    if (holder != NULL) {
+        holder->relativeDeltaX += deltaX;
+        holder->relativeDeltaY += deltaY;
+        endBatchMerge(holder, true);
+        return 0;
+    }
 
-        holder->packet.mouseMoveRel.header.size = BE32(sizeof(NV_REL_MOUSE_MOVE_PACKET) - sizeof(uint32_t));
-        if (AppVersionQuad[0] >= 5) {
-            holder->packet.mouseMoveRel.header.magic = LE32(MOUSE_MOVE_REL_MAGIC_GEN5);
-        }
-        else {
-            holder->packet.mouseMoveRel.header.magic = LE32(MOUSE_MOVE_REL_MAGIC);
-        }
+    holder = allocatePacketHolder(0);
+    if (holder == NULL) {
+        return -1;
+    }
 
-        // Remaining fields are set in the input thread based on the latest currentRelativeMouseState values
+    holder->channelId = CTRL_CHANNEL_MOUSE;
 
-        err = LbqOfferQueueItem(&packetQueue, holder, &holder->entry);
-        if (err != LBQ_SUCCESS) {
-            LC_ASSERT(err == LBQ_BOUND_EXCEEDED);
-            Limelog("Input queue reached maximum size limit\n");
-            freePacketHolder(holder);
+    // TODO: Send this as unreliable sequenced when we have a delayed reliable retransmission thread
+    // and protocol updates to allow us to determine which unreliable messages were dropped.
+    holder->enetPacketFlags = ENET_PACKET_FLAG_RELIABLE;
 
-            // We weren't able to insert the entry, so let the next call try again
-            currentRelativeMouseState.dirty = false;
-        }
+    holder->packet.mouseMoveRel.header.size = BE32(sizeof(NV_REL_MOUSE_MOVE_PACKET) - sizeof(uint32_t));
+    if (AppVersionQuad[0] >= 5) {
+        holder->packet.mouseMoveRel.header.magic = LE32(MOUSE_MOVE_REL_MAGIC_GEN5);
     }
     else {
-        // There's already a packet holder queued to send this event
-        PltUnlockMutex(&batchedInputMutex);
-        err = 0;
+        holder->packet.mouseMoveRel.header.magic = LE32(MOUSE_MOVE_REL_MAGIC);
     }
 
-    return err;
+    // The deltas are set in the input thread based on the total of all batched events
+    holder->relativeDeltaX = deltaX;
+    holder->relativeDeltaY = deltaY;
+
+    return queueBatchHolder(holder, BATCH_RELATIVE_MOUSE);
+}
+
+static void setAbsoluteMousePosition(PPACKET_HOLDER holder, short x, short y, short referenceWidth, short referenceHeight) {
+    holder->packet.mouseMoveAbs.x = BE16(x);
+    holder->packet.mouseMoveAbs.y = BE16(y);
+
+    // There appears to be a rounding error in GFE's scaling calculation which prevents
+    // the cursor from reaching the far edge of the screen when streaming at smaller
+    // resolutions with a higher desktop resolution (like streaming 720p with a desktop
+    // resolution of 1080p, or streaming 720p/1080p with a desktop resolution of 4K).
+    // Subtracting one from the reference dimensions seems to work around this issue.
+    holder->packet.mouseMoveAbs.width = BE16(referenceWidth - 1);
+    holder->packet.mouseMoveAbs.height = BE16(referenceHeight - 1);
 }
 
 // Send a mouse position update to the streaming machine
@@ -779,24 +1066,16 @@ int LiSendMousePositionEvent(short x, short y, short referenceWidth, short refer
         return -2;
     }
 
-    PltLockMutex(&batchedInputMutex);
-
-    // Overwrite the previous mouse location with the new one
-    currentAbsoluteMouseState.x = x;
-    currentAbsoluteMouseState.y = y;
-    currentAbsoluteMouseState.width = referenceWidth;
-    currentAbsoluteMouseState.height = referenceHeight;
-
-    // Queue a packet holder if this is the only pending absolute mouse event
-    if (!currentAbsoluteMouseState.dirty) {
-        // Set the dirty flag to claim ownership of inserting the packet holder
-        // and unlock to allow other threads to enqueue or process input.
-        currentAbsoluteMouseState.dirty = true;
-        PltUnlockMutex(&batchedInputMutex);
-
+    // Overwrite the previous mouse location if there's a pending absolute mouse event
+    holder = beginBatchMerge(BATCH_ABSOLUTE_MOUSE);
+    if (holder != NULL) {
+        setAbsoluteMousePosition(holder, x, y, referenceWidth, referenceHeight);
+        endBatchMerge(holder, true);
+        err = 0;
+    }
+    else {
         holder = allocatePacketHolder(0);
         if (holder == NULL) {
-            currentAbsoluteMouseState.dirty = false;
             return -1;
         }
 
@@ -808,23 +1087,9 @@ int LiSendMousePositionEvent(short x, short y, short referenceWidth, short refer
         holder->packet.mouseMoveAbs.header.size = BE32(sizeof(NV_ABS_MOUSE_MOVE_PACKET) - sizeof(uint32_t));
         holder->packet.mouseMoveAbs.header.magic = LE32(MOUSE_MOVE_ABS_MAGIC);
         holder->packet.mouseMoveAbs.unused = 0;
+        setAbsoluteMousePosition(holder, x, y, referenceWidth, referenceHeight);
 
-        // Remaining fields are set in the input thread based on the latest currentAbsoluteMouseState values
-
-        err = LbqOfferQueueItem(&packetQueue, holder, &holder->entry);
-        if (err != LBQ_SUCCESS) {
-            LC_ASSERT(err == LBQ_BOUND_EXCEEDED);
-            Limelog("Input queue reached maximum size limit\n");
-            freePacketHolder(holder);
-
-            // We weren't able to insert the entry, so let the next call try again
-            currentAbsoluteMouseState.dirty = false;
-        }
-    }
-    else {
-        // There's already a packet holder queued to send this event
-        PltUnlockMutex(&batchedInputMutex);
-        err = 0;
+        err = queueBatchHolder(holder, BATCH_ABSOLUTE_MOUSE);
     }
 
     // This is not thread safe, but it's not a big deal because callers that want to
@@ -872,7 +1137,7 @@ int LiSendMouseButtonEvent(char action, int button) {
     holder->packet.mouseButton.header.magic = LE32(holder->packet.mouseButton.header.magic);
     holder->packet.mouseButton.button = (uint8_t)button;
 
-    err = LbqOfferQueueItem(&packetQueue, holder, &holder->entry);
+    err = MrqOfferQueueItem(&packetQueue, holder);
     if (err != LBQ_SUCCESS) {
         LC_ASSERT(err == LBQ_BOUND_EXCEEDED);
         Limelog("Input queue reached maximum size limit\n");
@@ -950,7 +1215,7 @@ int LiSendKeyboardEvent2(short keyCode, char keyAction, char modifiers, char fla
     holder->packet.keyboard.modifiers = modifiers;
     holder->packet.keyboard.zero2 = 0;
 
-    err = LbqOfferQueueItem(&packetQueue, holder, &holder->entry);
+    err = MrqOfferQueueItem(&packetQueue, holder);
     if (err != LBQ_SUCCESS) {
         LC_ASSERT(err == LBQ_BOUND_EXCEEDED);
         Limelog("Input queue reached maximum size limit\n");
@@ -985,7 +1250,7 @@ int LiSendUtf8TextEvent(const char *text, unsigned int length) {
     holder->packet.unicode.header.magic = LE32(UTF8_TEXT_EVENT_MAGIC);
     memcpy(holder->packet.unicode.text, text, length);
 
-    err = LbqOfferQueueItem(&packetQueue, holder, &holder->entry);
+    err = MrqOfferQueueItem(&packetQueue, holder);
     if (err != LBQ_SUCCESS) {
         LC_ASSERT(err == LBQ_BOUND_EXCEEDED);
         Limelog("Input queue reached maximum size limit\n");
@@ -1037,33 +1302,26 @@ static int sendControllerEventInternal(short controllerNumber, short activeGamep
         controllerNumber %= MAX_GAMEPADS;
     }
 
-    // The batched input mutex protects against the enqueued packet being processed
-    // and freed from underneath us when we're trying to update it.
-    PltLockMutex(&batchedInputMutex);
-
-    // Start with the currently enqueued controller packet (if any)
-    holder = currentQueuedControllerPacket[controllerNumber];
+    // Start with the currently enqueued controller packet (if any). Owning the batch
+    // prevents the enqueued packet from being sent and freed from underneath us
+    // while we're trying to update it.
+    //
+    // We do not support batching with the legacy controller packet format.
+    holder = AppVersionQuad[0] > 3 ? beginBatchMerge(BATCH_CONTROLLER_BASE + controllerNumber) : NULL;
 
     // Check that this current input is compatible with the current batch
     if (holder) {
-        // We do not support batching with the legacy controller packet format
-        LC_ASSERT(AppVersionQuad[0] > 3);
-
         // If this new packet has different button flags, end the batch to ensure the
         // host receives the exact axis values present at the time of the button press.
         if (holder->packet.multiController.buttonFlags != LE16((short)buttonFlags) ||
             holder->packet.multiController.buttonFlags2 != (IS_SUNSHINE() ? LE16((short)(buttonFlags >> 16)) : 0)) {
             // Pretend there wasn't a currently queued controller packet
+            endBatchMerge(holder, false);
             holder = NULL;
         }
     }
 
     if (!holder) {
-        // Because we're not using the currently queued packet, it's safe
-        // to unlock here without having to worry about the input thread
-        // touching our packet holder behind our back.
-        PltUnlockMutex(&batchedInputMutex);
-
         holder = allocatePacketHolder(0);
         if (holder == NULL) {
             return -1;
@@ -1077,11 +1335,6 @@ static int sendControllerEventInternal(short controllerNumber, short activeGamep
 
         // Remember that we need to enqueue this holder since it's new
         enqueueHolder = true;
-
-        // Reacquire the batched input mutex before making it visible to
-        // the input thread by storing this in the input queue or in the
-        // currentQueuedControllerPacket array.
-        PltLockMutex(&batchedInputMutex);
     }
 
     if (AppVersionQuad[0] == 3) {
@@ -1126,37 +1379,26 @@ static int sendControllerEventInternal(short controllerNumber, short activeGamep
         holder->packet.multiController.tailA = LE16(MC_TAIL_A);
         holder->packet.multiController.buttonFlags2 = IS_SUNSHINE() ? LE16((short)(buttonFlags >> 16)) : 0;
         holder->packet.multiController.tailB = LE16(MC_TAIL_B);
-
-        if (enqueueHolder) {
-            // Make this new packet holder the current enqueued packet
-            currentQueuedControllerPacket[controllerNumber] = holder;
-        }
     }
 
-    // We can unlock the batched input mutex before enqueuing the new holder because
-    // the input thread only cares if currentQueuedControllerPacket is equal to the
-    // holder it's currently processing. Since it cannot be processing the holder
-    // until we enqueue it, there's no risk here of it processing/freeing the
-    // holder when we're still touching it.
-    //
-    // Unlocking early saves a context switch in the common case where the newly
-    // queued packet wakes up the input thread which then immediately blocks on
-    // the batched input mutex until this thread runs again to release it.
-    PltUnlockMutex(&batchedInputMutex);
-
-    if (enqueueHolder) {
+    if (!enqueueHolder) {
+        // The packet holder we updated was already enqueued
+        endBatchMerge(holder, true);
+        err = 0;
+    }
+    else if (AppVersionQuad[0] > 3) {
+        // Enqueue the new packet holder and make it the current batch
+        err = queueBatchHolder(holder, BATCH_CONTROLLER_BASE + controllerNumber);
+    }
+    else {
         // Enqueue the new packet holder
-        err = LbqOfferQueueItem(&packetQueue, holder, &holder->entry);
+        err = MrqOfferQueueItem(&packetQueue, holder);
         if (err != LBQ_SUCCESS) {
             LC_ASSERT(err == LBQ_BOUND_EXCEEDED);
             Limelog("Input queue reached maximum size limit\n");
             freePacketHolder(holder);
         }
     }
-    else {
-        // The packet holder we updated was already enqueued
-        err = 0;
-    }
 
     return err;
 }
@@ -1230,7 +1472,7 @@ int LiSendHighResScrollEvent(short scrollAmount) {
             holder->packet.scroll.scrollAmt2 = holder->packet.scroll.scrollAmt1;
             holder->packet.scroll.zero3 = 0;
 
-            err = LbqOfferQueueItem(&packetQueue, holder, &holder->entry);
+            err = MrqOfferQueueItem(&packetQueue, holder);
             if (err != LBQ_SUCCESS) {
                 LC_ASSERT(err == LBQ_BOUND_EXCEEDED);
                 Limelog("Input queue reached maximum size limit\n");
@@ -1263,7 +1505,7 @@ int LiSendHighResScrollEvent(short scrollAmount) {
         holder->packet.scroll.scrollAmt2 = holder->packet.scroll.scrollAmt1;
         holder->packet.scroll.zero3 = 0;
 
-        err = LbqOfferQueueItem(&packetQueue, holder, &holder->entry);
+        err = MrqOfferQueueItem(&packetQueue, holder);
         if (err != LBQ_SUCCESS) {
             LC_ASSERT(err == LBQ_BOUND_EXCEEDED);
             Limelog("Input queue reached maximum size limit\n");
@@ -1309,7 +1551,7 @@ int LiSendHighResHScrollEvent(short scrollAmount) {
     holder->packet.hscroll.header.magic = LE32(SS_HSCROLL_MAGIC);
     holder->packet.hscroll.scrollAmount = BE16(scrollAmount);
 
-    err = LbqOfferQueueItem(&packetQueue, holder, &holder->entry);
+    err = MrqOfferQueueItem(&packetQueue, holder);
     if (err != LBQ_SUCCESS) {
         LC_ASSERT(err == LBQ_BOUND_EXCEEDED);
         Limelog("Input queue reached maximum size limit\n");
@@ -1360,7 +1602,7 @@ int LiSendTouchEvent(uint8_t eventType, uint32_t pointerId, float x, float y, fl
     floatToNetfloat(contactAreaMajor, holder->packet.touch.contactAreaMajor);
     floatToNetfloat(contactAreaMinor, holder->packet.touch.contactAreaMinor);
 
-    err = LbqOfferQueueItem(&packetQueue, holder, &holder->entry);
+    err = MrqOfferQueueItem(&packetQueue, holder);
     if (err != LBQ_SUCCESS) {
         LC_ASSERT(err == LBQ_BOUND_EXCEEDED);
         Limelog("Input queue reached maximum size limit\n");
@@ -1413,7 +1655,7 @@ int LiSendPenEvent(uint8_t eventType, uint8_t toolType, uint8_t penButtons,
     floatToNetfloat(contactAreaMajor, holder->packet.pen.contactAreaMajor);
     floatToNetfloat(contactAreaMinor, holder->packet.pen.contactAreaMinor);
 
-    err = LbqOfferQueueItem(&packetQueue, holder, &holder->entry);
+    err = MrqOfferQueueItem(&packetQueue, holder);
     if (err != LBQ_SUCCESS) {
         LC_ASSERT(err == LBQ_BOUND_EXCEEDED);
         Limelog("Input queue reached maximum size limit\n");
@@ -1458,7 +1700,7 @@ int LiSendControllerArrivalEvent(uint8_t controllerNumber, uint16_t activeGamepa
         holder->packet.controllerArrival.capabilities = LE16(capabilities);
         holder->packet.controllerArrival.supportedButtonFlags = LE32(supportedButtonFlags);
 
-        err = LbqOfferQueueItem(&packetQueue, holder, &holder->entry);
+        err = MrqOfferQueueItem(&packetQueue, holder);
         if (err != LBQ_SUCCESS) {
             LC_ASSERT(err == LBQ_BOUND_EXCEEDED);
             Limelog("Input queue reached maximum size limit\n");
@@ -1510,7 +1752,7 @@ int LiSendControllerTouchEvent2(uint8_t controllerNumber, uint8_t eventType, uin
     floatToNetfloat(y, holder->packet.controllerTouch.y);
     floatToNetfloat(pressure, holder->packet.controllerTouch.pressure);
 
-    err = LbqOfferQueueItem(&packetQueue, holder, &holder->entry);
+    err = MrqOfferQueueItem(&packetQueue, holder);
     if (err != LBQ_SUCCESS) {
         LC_ASSERT(err == LBQ_BOUND_EXCEEDED);
         Limelog("Input queue reached maximum size limit\n");
@@ -1524,9 +1766,86 @@ int LiSendControllerTouchEvent(uint8_t controllerNumber, uint8_t eventType, uint
     return LiSendControllerTouchEvent2(controllerNumber, eventType, 0, pointerId, x, y, pressure);
 }
 
+static void setControllerMotion(PPACKET_HOLDER holder, uint8_t motionType, float x, float y, float z) {
+    // Motion events are so rapid that we can just drop any events that are lost in transit,
+    // but we will treat (0, 0, 0) as a special value for gyro events to allow clients to
+    // reliably set the gyro to a null state when sensor events are halted due to focus loss
+    // or similar client-side constraints.
+    if (motionType == LI_MOTION_TYPE_GYRO && x == 0.0f && y == 0.0f && z == 0.0f) {
+        holder->enetPacketFlags = ENET_PACKET_FLAG_RELIABLE;
+    }
+    else {
+        holder->enetPacketFlags = 0;
+    }
+
+    floatToNetfloat(x, holder->packet.controllerMotion.x);
+    floatToNetfloat(y, holder->packet.controllerMotion.y);
+    floatToNetfloat(z, holder->packet.controllerMotion.z);
+}
+
+// Called by the control stream when the host requests a motion report rate
+void setMotionEventReportRate(uint16_t controllerNumber, uint8_t motionType, uint16_t reportRateHz) {
+    if (controllerNumber >= MAX_GAMEPADS || motionType - 1 >= MAX_MOTION_EVENTS) {
+        return;
+    }
+
+    // A rate of 0 asks the client to stop reporting, which is up to the client
+    PltAtomicStore32(&motionReportIntervalUs[controllerNumber][motionType - 1],
+                     reportRateHz != 0 ? 1000000 / reportRateHz : 0);
+
+    // Start the new schedule with the next sample
+    PltAtomicStore32(&motionReportDeadlineUs[controllerNumber][motionType - 1],
+                     (uint32_t)PltGetMicroseconds());
+}
+
+// Claims the next motion report for the sensor and returns the time it may be sent.
+// Reports are due on a fixed schedule at the host's requested rate. A sample that
+// arrives before its report is due is held until the deadline, and later samples
+// are merged into it, so the latest sample is always reported on time.
+static uint64_t claimMotionReport(uint8_t controllerNumber, uint8_t motionType) {
+    volatile uint32_t* deadline = &motionReportDeadlineUs[controllerNumber][motionType - 1];
+    uint32_t intervalUs = PltAtomicLoad32(&motionReportIntervalUs[controllerNumber][motionType - 1]);
+    uint64_t now = PltGetMicroseconds();
+    uint32_t nowUs = (uint32_t)now;
+
+    if (intervalUs == 0) {
+        return now;
+    }
+
+    for (;;) {
+        uint32_t currentDeadline = PltAtomicLoad32(deadline);
+        uint32_t aheadUs = currentDeadline - nowUs;
+        uint32_t nextDeadline;
+        uint64_t reportTimeUs;
+
+        // A pending deadline is never more than two intervals away (one if the
+        // report due at it hasn't been claimed yet). Anything further is stale
+        // because the clock wrapped or the interval got shorter.
+        if (aheadUs != 0 && aheadUs <= 2 * intervalUs) {
+            reportTimeUs = now + aheadUs;
+            nextDeadline = currentDeadline + intervalUs;
+        }
+        // If we've fallen more than a report behind (or sensor events stopped
+        // for a while), restart the schedule rather than sending a burst.
+        else if (nowUs - currentDeadline >= intervalUs) {
+            reportTimeUs = now;
+            nextDeadline = nowUs + intervalUs;
+        }
+        else {
+            reportTimeUs = now;
+            nextDeadline = currentDeadline + intervalUs;
+        }
+
+        // Only one of any racing threads gets the report for this deadline
+        if (PltAtomicCompareExchange32(deadline, currentDeadline, nextDeadline)) {
+            return reportTimeUs;
+        }
+    }
+}
+
 int LiSendControllerMotionEvent(uint8_t controllerNumber, uint8_t motionType, float x, float y, float z) {
     PPACKET_HOLDER holder;
-    int err;
+    int batchIndex;
 
     if (!initialized) {
         return -2;
@@ -1546,53 +1865,39 @@ int LiSendControllerMotionEvent(uint8_t controllerNumber, uint8_t motionType, fl
     // Sunshine supports up to 16 controllers
     controllerNumber %= MAX_GAMEPADS;
 
-    PltLockMutex(&batchedInputMutex);
-
-    currentGamepadSensorState[controllerNumber][motionType - 1].x = x;
-    currentGamepadSensorState[controllerNumber][motionType - 1].y = y;
-    currentGamepadSensorState[controllerNumber][motionType - 1].z = z;
+    // LI_MOTION_TYPE_* values are 1-based, so we have to subtract 1 to index into our batches
+    batchIndex = BATCH_MOTION_BASE + (controllerNumber * MAX_MOTION_EVENTS) + (motionType - 1);
 
-    // Queue a packet holder if this is the only pending sensor event
-    if (!currentGamepadSensorState[controllerNumber][motionType - 1].dirty) {
-        // Set the dirty flag to claim ownership of inserting the packet holder
-        // and unlock to allow other threads to enqueue or process input.
-        currentGamepadSensorState[controllerNumber][motionType - 1].dirty = true;
-        PltUnlockMutex(&batchedInputMutex);
-
-        holder = allocatePacketHolder(0);
-        if (holder == NULL) {
-            currentGamepadSensorState[controllerNumber][motionType - 1].dirty = false;
-            return -1;
-        }
-
-        // Send each controller on a separate channel specific to motion sensors
-        holder->channelId = CTRL_CHANNEL_SENSOR_BASE + controllerNumber;
+    // Overwrite the previous sensor values if there's a pending event for this sensor
+    holder = beginBatchMerge(batchIndex);
+    if (holder != NULL) {
+        setControllerMotion(holder, motionType, x, y, z);
+        endBatchMerge(holder, true);
+        return 0;
+    }
 
-        holder->packet.controllerMotion.header.size = BE32(sizeof(SS_CONTROLLER_MOTION_PACKET) - sizeof(uint32_t));
-        holder->packet.controllerMotion.header.magic = LE32(SS_CONTROLLER_MOTION_MAGIC);
-        holder->packet.controllerMotion.controllerNumber = controllerNumber;
-        holder->packet.controllerMotion.motionType = motionType;
-        memset(holder->packet.controllerMotion.zero, 0, sizeof(holder->packet.controllerMotion.zero));
+    holder = allocatePacketHolder(0);
+    if (holder == NULL) {
+        return -1;
+    }
 
-        // Remaining fields are set in the input thread based on the latest currentGamepadSensorState values
+    // Hold samples that arrive before the next report is due, except for the
+    // null gyro state which must always get through (see setControllerMotion())
+    if (!(motionType == LI_MOTION_TYPE_GYRO && x == 0.0f && y == 0.0f && z == 0.0f)) {
+        holder->sendTimeUs = claimMotionReport(controllerNumber, motionType);
+    }
 
-        err = LbqOfferQueueItem(&packetQueue, holder, &holder->entry);
-        if (err != LBQ_SUCCESS) {
-            LC_ASSERT(err == LBQ_BOUND_EXCEEDED);
-            Limelog("Input queue reached maximum size limit\n");
-            freePacketHolder(holder);
+    // Send each controller on a separate channel specific to motion sensors
+    holder->channelId = CTRL_CHANNEL_SENSOR_BASE + controllerNumber;
 
-            // We weren't able to insert the entry, so let the next call try again
-            currentGamepadSensorState[controllerNumber][motionType - 1].dirty = false;
-        }
-    }
-    else {
-        // There's already a packet holder queued to send this event
-        PltUnlockMutex(&batchedInputMutex);
-        err = 0;
-    }
+    holder->packet.controllerMotion.header.size = BE32(sizeof(SS_CONTROLLER_MOTION_PACKET) - sizeof(uint32_t));
+    holder->packet.controllerMotion.header.magic = LE32(SS_CONTROLLER_MOTION_MAGIC);
+    holder->packet.controllerMotion.controllerNumber = controllerNumber;
+    holder->packet.controllerMotion.motionType = motionType;
+    memset(holder->packet.controllerMotion.zero, 0, sizeof(holder->packet.controllerMotion.zero));
+    setControllerMotion(holder, motionType, x, y, z);
 
-    return err;
+    return queueBatchHolder(holder, batchIndex);
 }
 
 int LiSendControllerBatteryEvent(uint8_t controllerNumber, uint8_t batteryState, uint8_t batteryPercentage) {
@@ -1627,7 +1932,7 @@ int LiSendControllerBatteryEvent(uint8_t controllerNumber, uint8_t batteryState,
     holder->packet.controllerBattery.batteryPercentage = batteryPercentage;
     memset(holder->packet.controllerBattery.zero, 0, sizeof(holder->packet.controllerBattery.zero));
 
-    err = LbqOfferQueueItem(&packetQueue, holder, &holder->entry);
+    err = MrqOfferQueueItem(&packetQueue, holder);
     if (err != LBQ_SUCCESS) {
         LC_ASSERT(err == LBQ_BOUND_EXCEEDED);
         Limelog("Input queue reached maximum size limit\n");
@@ -1636,3 +1941,69 @@ int LiSendControllerBatteryEvent(uint8_t controllerNumber, uint8_t batteryState,
 
     return err;
 }
+
+static uint32_t readInputBatchingStat(uint32_t* counter) {
+    return PltAtomicLoad32((volatile uint32_t*)counter);
+}
+
+bool LiGetInputBatchingStats(PINPUT_BATCHING_STATS stats) {
+    stats->mousePackets = readInputBatchingStat(&inputBatchingStats.mousePackets);
+    stats->mouseEvents = readInputBatchingStat(&inputBatchingStats.mouseEvents);
+    stats->penPackets = readInputBatchingStat(&inputBatchingStats.penPackets);
+    stats->penEvents = readInputBatchingStat(&inputBatchingStats.penEvents);
+    stats->motionPackets = readInputBatchingStat(&inputBatchingStats.motionPackets);
+    stats->motionEvents = readInputBatchingStat(&inputBatchingStats.motionEvents);
+    stats->motionPacketsHeld = readInputBatchingStat(&inputBatchingStats.motionPacketsHeld);
+    stats->maxEventsPerPacket = readInputBatchingStat(&inputBatchingStats.maxEventsPerPacket);
+    stats->delayedPackets = readInputBatchingStat(&inputBatchingStats.delayedPackets);
+    stats->datagramsSaved = readInputBatchingStat(&inputBatchingStats.datagramsSaved);
+
+    return stats->mousePackets != 0 || stats->penPackets != 0 || stats->motionPackets != 0;
+}
+
+bool LiGetInputBatchingDelay(uint32_t* p50Us, uint32_t* p90Us, uint32_t* p99Us) {
+    // We don't synchronize with the input send thread here because we're just
+    // reading metrics and observing a torn write every once in a while is fine.
+    if (batchingDelayHistogram.sampleCount == 0) {
+        return false;
+    }
+
+    if (p50Us != NULL) {
+        *p50Us = LhGetPercentile(&batchingDelayHistogram, 50);
+    }
+    if (p90Us != NULL) {
+        *p90Us = LhGetPercentile(&batchingDelayHistogram, 90);
+    }
+    if (p99Us != NULL) {
+        *p99Us = LhGetPercentile(&batchingDelayHistogram, 99);
+    }
+
+    return true;
+}
+
+bool LiGetInputLatency(int eventType, int stage, uint32_t* p50Us, uint32_t* p90Us, uint32_t* p99Us) {
+    PLATENCY_HISTOGRAM histogram;
+
+    if (eventType < 0 || eventType >= LI_INPUT_LATENCY_TYPE_COUNT ||
+        stage < 0 || stage >= LI_INPUT_LATENCY_STAGE_COUNT) {
+        return false;
+    }
+
+    // As above, torn reads of these metrics are acceptable
+    histogram = &inputLatencyHistograms[eventType][stage];
+    if (histogram->sampleCount == 0) {
+        return false;
+    }
+
+    if (p50Us != NULL) {
+        *p50Us = LhGetPercentile(histogram, 50);
+    }
+    if (p90Us != NULL) {
+        *p90Us = LhGetPercentile(histogram, 90);
+    }
+    if (p99Us != NULL) {
+        *p99Us = LhGetPercentile(histogram, 99);
+    }
+
+    return true;
+}
@@ -0,0 +1,98 @@
+#include "LatencyHistogram.h"
+
+static int getBucketIndex(uint32_t value) {
+    int msb;
+
+    // Values below the first full power of 2 get their own buckets
+    if (value < (1U << LH_SUB_BUCKET_BITS)) {
+        return (int)value;
+    }
+
+    msb = 31;
+    while (!(value & (1U << msb))) {
+        msb--;
+    }
+
+    return ((msb - LH_SUB_BUCKET_BITS + 1) << LH_SUB_BUCKET_BITS) +
+           (int)((value >> (msb - LH_SUB_BUCKET_BITS)) & ((1U << LH_SUB_BUCKET_BITS) - 1));
+}
+
+// Returns the largest value that maps to the specified bucket
+static uint32_t getBucketUpperBound(int index) {
+    int msb;
+    uint32_t subBucket;
+
+    if (index < (1 << LH_SUB_BUCKET_BITS)) {
+        return (uint32_t)index;
+    }
+
+    msb = (index >> LH_SUB_BUCKET_BITS) + LH_SUB_BUCKET_BITS - 1;
+    subBucket = (uint32_t)index & ((1U << LH_SUB_BUCKET_BITS) - 1);
+
+    return (1U << msb) + ((subBucket + 1) << (msb - LH_SUB_BUCKET_BITS)) - 1;
+}
+
+void LhInitializeHistogram(PLATENCY_HISTOGRAM histogram) {
+    memset(histogram, 0, sizeof(*histogram));
+}
+
+void LhAddSample(PLATENCY_HISTOGRAM histogram, uint64_t sampleUs) {
+    uint32_t value = sampleUs > LH_MAX_SAMPLE_US ? LH_MAX_SAMPLE_US : (uint32_t)sampleUs;
+
+    LC_ASSERT(getBucketIndex(value) < LH_BUCKET_COUNT);
+    histogram->buckets[getBucketIndex(value)]++;
+    histogram->sampleCount++;
+    if (value > histogram->maxSampleUs) {
+        histogram->maxSampleUs = value;
+    }
+}
+
+// Halves the weight of all existing samples, so old samples gradually lose their influence
+void LhDecayHistogram(PLATENCY_HISTOGRAM histogram) {
+    int highestBucket = -1;
+
+    histogram->sampleCount = 0;
+    for (int i = 0; i < LH_BUCKET_COUNT; i++) {
+        histogram->buckets[i] /= 2;
+        histogram->sampleCount += histogram->buckets[i];
+        if (histogram->buckets[i] != 0) {
+            highestBucket = i;
+        }
+    }
+
+    // Let the maximum come back down if its samples have aged out
+    if (highestBucket < 0) {
+        histogram->maxSampleUs = 0;
+    }
+    else if (getBucketUpperBound(highestBucket) < histogram->maxSampleUs) {
+        histogram->maxSampleUs = getBucketUpperBound(highestBucket);
+    }
+}
+
+// Returns 0 if the histogram is empty
+uint32_t LhGetPercentile(PLATENCY_HISTOGRAM histogram, int percentile) {
+    uint64_t threshold;
+    uint64_t seen = 0;
+
+    LC_ASSERT(percentile >= 0 && percentile <= 100);
+
+    if (histogram->sampleCount == 0) {
+        return 0;
+    }
+
+    // Find the first bucket where the cumulative count reaches the percentile
+    threshold = ((uint64_t)histogram->sampleCount * percentile + 99) / 100;
+    if (threshold == 0) {
+        threshold = 1;
+    }
+
+    for (int i = 0; i < LH_BUCKET_COUNT; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= threshold) {
+            uint32_t upperBound = getBucketUpperBound(i);
+            return upperBound < histogram->maxSampleUs ? upperBound : histogram->maxSampleUs;
+        }
+    }
+
+    return histogram->maxSampleUs;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "Platform.h"
+
+// Log-linear histogram of latency samples in microseconds. Each power of 2
+// is split into 4 buckets, so reported percentiles are within 25% of the
+// true value. Samples above LH_MAX_SAMPLE_US are clamped.
+#define LH_SUB_BUCKET_BITS 2
+#define LH_MAX_SAMPLE_US ((1U << 24) - 1)
+#define LH_BUCKET_COUNT (((24 - LH_SUB_BUCKET_BITS + 1) << LH_SUB_BUCKET_BITS))
+
+typedef struct _LATENCY_HISTOGRAM {
+    uint32_t buckets[LH_BUCKET_COUNT];
+    uint32_t sampleCount;
+    uint32_t maxSampleUs;
+} LATENCY_HISTOGRAM, *PLATENCY_HISTOGRAM;
+
+void LhInitializeHistogram(PLATENCY_HISTOGRAM histogram);
+void LhAddSample(PLATENCY_HISTOGRAM histogram, uint64_t sampleUs);
+void LhDecayHistogram(PLATENCY_HISTOGRAM histogram);
+uint32_t LhGetPercentile(PLATENCY_HISTOGRAM histogram, int percentile);
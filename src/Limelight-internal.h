@@ -10,6 +10,9 @@
 #include "RtpAudioQueue.h"
 #include "RtpVideoQueue.h"
 #include "ByteBuffer.h"
+#include "SpscRingQueue.h"
+#include "MpmcRingQueue.h"
+#include "LatencyHistogram.h"
 
 #include <enet/enet.h>
 
@@ -114,28 +117,39 @@ void setRecorderCallbacks(PDECODER_RENDERER_CALLBACKS drCallbacks, PAUDIO_RENDER
 
 char* getSdpPayloadForStreamConfig(int rtspClientVersion, int* length);
 
+// Timestamps of an input message on its way to the host for LiGetInputLatency()
+typedef struct _INPUT_LATENCY_TRACE {
+    int eventType;
+    uint64_t enqueueTimeUs;
+    uint64_t dequeueTimeUs;
+    uint64_t readyTimeUs;
+    uint64_t handoffTimeUs;
+} INPUT_LATENCY_TRACE, *PINPUT_LATENCY_TRACE;
+
 int initializeControlStream(void);
 int startControlStream(void);
 int stopControlStream(void);
 void destroyControlStream(void);
 void connectionDetectedFrameLoss(uint32_t startFrame, uint32_t endFrame);
+void requestIdrFrameForRecovery(uint8_t trigger);
 void connectionReceivedCompleteFrame(uint32_t frameIndex, bool frameIsLTR);
 void connectionSawFrame(uint32_t frameIndex);
 void connectionSendFrameFecStatus(PSS_FRAME_FEC_STATUS fecStatus);
-int sendInputPacketOnControlStream(unsigned char* data, int length, uint8_t channelId, uint32_t flags, bool moreData);
+int sendInputPacketOnControlStream(unsigned char* data, int length, uint8_t channelId, uint32_t flags, bool moreData,
+                                   PINPUT_LATENCY_TRACE trace);
 void flushInputOnControlStream(void);
 bool isControlDataInTransit(void);
 
 int performRtspHandshake(PSERVER_INFORMATION serverInfo);
 
-void initializeVideoDepacketizer(int pktSize);
+int initializeVideoDepacketizer(int pktSize);
 void destroyVideoDepacketizer(void);
 void queueRtpPacket(PRTPV_QUEUE_ENTRY queueEntry);
 void stopVideoDepacketizer(void);
 void requestDecoderRefresh(void);
 void notifyFrameLost(unsigned int frameNumber, bool speculative);
 
-void initializeVideoStream(void);
+int initializeVideoStream(void);
 void destroyVideoStream(void);
 void notifyKeyFrameReceived(void);
 int startVideoStream(void* rendererContext, int drFlags);
@@ -147,7 +161,36 @@ void destroyAudioStream(void);
 int startAudioStream(void* audioContext, int arFlags);
 void stopAudioStream(void);
 
+#define PRESENTATION_CLOCK_AUDIO 0
+#define PRESENTATION_CLOCK_VIDEO 1
+#define PRESENTATION_CLOCK_STREAM_COUNT 2
+void resetPresentationClock(int streamIndex);
+void addPresentationClockSample(int streamIndex, uint64_t hostTimeUs, uint64_t localTimeUs);
+
+void resetConnectionQuality(void);
+void connectionQualityFecBlockFinished(uint32_t dataShards, uint32_t parityShards,
+                                       uint32_t receivedDataShards, uint32_t receivedParityShards,
+                                       bool completed);
+void connectionQualityFrameArrived(uint32_t rtpTimestamp, uint64_t arrivalTimeUs);
+
+void initializeRecoveryPolicy(void);
+void destroyRecoveryPolicy(void);
+int recoveryPolicyFrameLoss(uint32_t startFrame, uint32_t endFrame);
+bool recoveryPolicyTakeRfiRange(uint32_t* startFrame, uint32_t* endFrame);
+bool recoveryPolicyCheckRfiTimeout(void);
+void recoveryPolicyIdrRequested(uint8_t trigger);
+uint32_t recoveryPolicyGetIdrHoldoffMs(void);
+bool recoveryPolicyIsIdrPending(void);
+void recoveryPolicyIdrSent(void);
+void recoveryPolicyLtrAcknowledged(uint32_t frameIndex);
+void recoveryPolicyFrameReceived(uint32_t frameIndex, bool idrFrame, int frameSize);
+
+void resetBandwidthEstimator(void);
+void bandwidthEstimatorAddPacket(uint16_t sequenceNumber, uint32_t rtpTimestamp, int length, uint64_t arrivalTimeUs);
+
 int initializeInputStream(void);
 void destroyInputStream(void);
 int startInputStream(void);
 int stopInputStream(void);
+void setMotionEventReportRate(uint16_t controllerNumber, uint8_t motionType, uint16_t reportRateHz);
+void recordInputLatencyTrace(PINPUT_LATENCY_TRACE trace, uint64_t flushTimeUs);
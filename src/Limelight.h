@@ -100,13 +100,56 @@ typedef struct _STREAM_CONFIGURATION {
     // in /launch and /resume requests.
     char remoteInputAesKey[16];
     char remoteInputAesIv[16];
+
+    // Specifies how queued video frames are handled when the video renderer is unable
+    // to keep up with the stream. See VIDEO_QUEUE_POLICY constants below. This has no
+    // effect for renderers that set CAPABILITY_DIRECT_SUBMIT.
+    int videoQueuePolicy;
+
+    // If specified, the maximum time in milliseconds that a frame may wait in the
+    // video frame queue when using VIDEO_QUEUE_POLICY_BOUNDED_LATENCY. If not set,
+    // a default of 50 ms is used.
+    int videoQueueMaxLatencyMs;
+
+    // If specified, the length in microseconds of the window used to batch mouse, pen, and
+    // controller motion packets. Motion events arriving within a window are merged and sent
+    // together at its end. Values below 1000 are useful for high polling rate mice. If not set,
+    // a default of 1000 us is used.
+    int inputBatchingIntervalUs;
 } STREAM_CONFIGURATION, *PSTREAM_CONFIGURATION;
 
+// Discards all queued frames and requests an IDR frame when the video frame queue
+// overflows. This is the default policy.
+#define VIDEO_QUEUE_POLICY_FLUSH_AND_IDR  0
+
+// Discards all queued frames when the video frame queue overflows, then recovers
+// with reference frame invalidation if the renderer supports it. An IDR frame is
+// requested only if RFI is not possible.
+#define VIDEO_QUEUE_POLICY_OVERFLOW_RFI   1
+
+// Keeps the oldest queued frame within videoQueueMaxLatencyMs. P-frames reference the
+// frames before them, so queued frames can't simply be skipped. Once the oldest frame
+// misses the deadline, an IDR frame is requested (at most once per second) and every
+// frame still queued when it arrives is discarded in its favor. Queue overflow is
+// handled as with VIDEO_QUEUE_POLICY_OVERFLOW_RFI.
+#define VIDEO_QUEUE_POLICY_BOUNDED_LATENCY 2
+
+// Trims the queue down to the newest decodable frame. This works like
+// VIDEO_QUEUE_POLICY_BOUNDED_LATENCY with no latency budget: as soon as a frame arrives
+// while another is still queued, an IDR frame is requested (at most once per second),
+// and every frame still queued when it arrives is discarded in its favor. Renderers that
+// consume frames on their own vsync-driven schedule should decode every frame they
+// dequeue but only present the last one available (see LiGetPendingVideoFrames()).
+// Queue overflow is handled as with VIDEO_QUEUE_POLICY_OVERFLOW_RFI.
+#define VIDEO_QUEUE_POLICY_LATEST_FRAME_ONLY 3
+
 // Use this function to zero the stream configuration when allocated on the stack or heap
 void LiInitializeStreamConfiguration(PSTREAM_CONFIGURATION streamConfig);
 
 // These identify codec configuration data in the buffer lists
 // of frames identified as IDR frames for H.264 and HEVC formats.
+// For AV1, the temporal delimiter and sequence header OBUs at the
+// start of a key frame are placed in a BUFFER_TYPE_SPS buffer.
 // For other codecs, all data is marked as BUFFER_TYPE_PICDATA.
 #define BUFFER_TYPE_PICDATA  0x00
 #define BUFFER_TYPE_SPS      0x01
@@ -123,7 +166,7 @@ typedef struct _LENTRY {
     // Size of data in bytes (never <= 0)
     int length;
 
-    // Buffer type (listed above, only set for H.264 and HEVC formats)
+    // Buffer type (listed above, only set for H.264, HEVC, and AV1 formats)
     int bufferType;
 } LENTRY, *PLENTRY;
 
@@ -356,6 +399,22 @@ typedef void(*AudioRendererCleanup)(void);
 // This callback provides Opus audio data to be decoded and played. sampleLength is in bytes.
 typedef void(*AudioRendererDecodeAndPlaySample)(char* sampleData, int sampleLength);
 
+typedef struct _AUDIO_SAMPLE_ENTRY {
+    // Opus data for this frame or NULL if the frame was lost and
+    // the decoder should perform packet loss concealment instead
+    char* sampleData;
+
+    // Size of sampleData in bytes (0 for lost frames)
+    int sampleLength;
+} AUDIO_SAMPLE_ENTRY, *PAUDIO_SAMPLE_ENTRY;
+
+// This optional callback provides a batch of consecutive Opus frames to be decoded and played
+// in order. If set, it is called instead of decodeAndPlaySample with all frames that are pending
+// when the decoder thread wakes up, which reduces the number of callbacks for short frame durations.
+// It is not used by renderers that set CAPABILITY_DIRECT_SUBMIT. The sample data is only valid
+// until the callback returns.
+typedef void(*AudioRendererDecodeAndPlaySamples)(PAUDIO_SAMPLE_ENTRY samples, int sampleCount);
+
 typedef struct _AUDIO_RENDERER_CALLBACKS {
     AudioRendererInit init;
     AudioRendererStart start;
@@ -363,6 +422,7 @@ typedef struct _AUDIO_RENDERER_CALLBACKS {
     AudioRendererCleanup cleanup;
     AudioRendererDecodeAndPlaySample decodeAndPlaySample;
     int capabilities;
+    AudioRendererDecodeAndPlaySamples decodeAndPlaySamples;
 } AUDIO_RENDERER_CALLBACKS, *PAUDIO_RENDERER_CALLBACKS;
 
 // Use this function to zero the audio callbacks when allocated on the stack or heap
@@ -456,6 +516,33 @@ typedef void(*ConnListenerRumble)(unsigned short controllerNumber, unsigned shor
 #define CONN_STATUS_POOR    1
 typedef void(*ConnListenerConnectionStatusUpdate)(int connectionStatus);
 
+// This callback provides a continuous estimate of connection quality for
+// clients that want more detail than ConnListenerConnectionStatusUpdate.
+// Each signal is smoothed over a few hundred milliseconds, and the callback
+// is invoked at most every 100 ms while video is being received. It is
+// called on the video receive thread, so it must not block.
+typedef struct _CONNECTION_QUALITY {
+    // Overall quality from 0 (unusable) to 100 (no observed impairment)
+    int score;
+
+    // Percentage of video packets lost in transit
+    float packetLossPercent;
+
+    // Percentage of FEC blocks that needed parity data to recover
+    float fecRecoveryPercent;
+
+    // Interarrival jitter of video frames (RFC 3550)
+    uint32_t jitterUs;
+
+    // Control stream round-trip time and its variance
+    uint32_t rttMs;
+    uint32_t rttVarianceMs;
+
+    // Average number of frames waiting for the decoder
+    float decodeQueueDepth;
+} CONNECTION_QUALITY, *PCONNECTION_QUALITY;
+typedef void(*ConnListenerConnectionQualityUpdate)(const CONNECTION_QUALITY* quality);
+
 // This callback is invoked to notify the client of a change in HDR mode on
 // the host. The client will probably want to update the local display mode
 // to match the state of HDR on the host. This callback may be invoked even
@@ -497,6 +584,7 @@ typedef struct _CONNECTION_LISTENER_CALLBACKS {
     ConnListenerSetMotionEventState setMotionEventState;
     ConnListenerSetControllerLED setControllerLED;
     ConnListenerSetAdaptiveTriggers setAdaptiveTriggers;
+    ConnListenerConnectionQualityUpdate connectionQualityUpdate;
 } CONNECTION_LISTENER_CALLBACKS, *PCONNECTION_LISTENER_CALLBACKS;
 
 // Use this function to zero the connection callbacks when allocated on the stack or heap
@@ -569,6 +657,38 @@ const char* LiGetStageName(int stage);
 // This function may only be called between LiStartConnection() and LiStopConnection().
 bool LiGetEstimatedRttInfo(uint32_t* estimatedRtt, uint32_t* estimatedRttVariance);
 
+// This function returns the most recent connection quality estimate (see
+// ConnListenerConnectionQualityUpdate). It returns false if no estimate
+// is available yet.
+bool LiGetConnectionQuality(PCONNECTION_QUALITY quality);
+
+// This function returns the receive-side bandwidth estimate for the video
+// stream. The estimator watches the delay gradient between video frames
+// and packet loss, so estimatedKbps falls below incomingKbps once the
+// path can no longer sustain the current bitrate. A client seeing a
+// sustained LI_CONGESTION_OVERUSE state can restart the stream at a lower
+// bitrate before it degrades further. It returns false if no estimate is
+// available yet.
+#define LI_CONGESTION_NORMAL   0
+#define LI_CONGESTION_UNDERUSE 1
+#define LI_CONGESTION_OVERUSE  2
+typedef struct _BANDWIDTH_ESTIMATE {
+    // Estimated sustainable bitrate and the measured receive rate
+    uint32_t estimatedKbps;
+    uint32_t incomingKbps;
+
+    // Video packet loss over the last measurement window
+    float packetLossPercent;
+
+    // One of the LI_CONGESTION_* values
+    int congestionState;
+
+    // Scaled queuing delay trend and the adaptive threshold it is compared with
+    float delayTrend;
+    float overuseThreshold;
+} BANDWIDTH_ESTIMATE, *PBANDWIDTH_ESTIMATE;
+bool LiGetBandwidthEstimate(PBANDWIDTH_ESTIMATE estimate);
+
 // This function queues a relative mouse move event to be sent to the remote server.
 int LiSendMouseMoveEvent(short deltaX, short deltaY);
 
@@ -807,6 +927,9 @@ int LiSendControllerTouchEvent2(uint8_t controllerNumber, uint8_t eventType, uin
 //
 // For power and performance reasons, motion sensors should not be enabled unless the host has
 // explicitly asked for motion event reports via ConnListenerSetMotionEventState().
+// Events reported faster than the host's requested rate are held until the next report is due
+// and replaced by any newer event for the same sensor, so clients may pass every sensor sample
+// through without throttling them first.
 //
 // LI_MOTION_TYPE_ACCEL should report data in m/s^2 (inclusive of gravitational acceleration).
 // LI_MOTION_TYPE_GYRO should report data in deg/s.
@@ -871,7 +994,8 @@ int LiGetPendingAudioFrames(void);
 
 // Similar to LiGetPendingAudioFrames() except it returns the pending audio in
 // milliseconds rather than frames, which allows callers to be agnostic of the
-// negotiated audio frame duration.
+// negotiated audio frame duration. The adaptive jitter buffer's target for this
+// value is available from LiGetAudioJitterBufferStats().
 int LiGetPendingAudioDuration(void);
 
 // Returns a pointer to a struct containing various statistics about the RTP audio stream.
@@ -884,10 +1008,55 @@ typedef struct _RTP_AUDIO_STATS {
     uint32_t packetCountOOS;           // out-of-sequence packets
     uint32_t packetCountInvalid;       // corrupted packets, etc
     uint32_t packetCountFecInvalid;    // invalid FEC packet
+    uint32_t packetPoolExhausted;      // no pooled packet buffer was free, so one was allocated
+    uint32_t fecBlockPoolExhausted;    // no pooled FEC block of the right size was free, so one was allocated
+    uint32_t oosWaitTimeMs;            // current time to wait for late shards before giving up on an FEC block
+    uint32_t oosWaitRecoveries;        // an FEC block was completed by shards that arrived while waiting
+    uint32_t oosWaitTimeouts;          // gave up on an FEC block after waiting for late shards
 } RTP_AUDIO_STATS, *PRTP_AUDIO_STATS;
 
 const RTP_AUDIO_STATS* LiGetRTPAudioStats(void);
 
+// Fills in a snapshot of the state of the adaptive audio jitter buffer. The target
+// playout delay is derived from the measured inter-arrival jitter and adjusted to keep
+// decoder underruns rare. When more audio than the target is pending, single frames
+// are dropped to bring the queue back down. Only relevant if CAPABILITY_DIRECT_SUBMIT
+// is not set for the audio renderer.
+typedef struct _AUDIO_JITTER_BUFFER_STATS {
+    uint32_t interarrivalJitterUs;  // RFC 3550 inter-arrival jitter estimate
+    uint32_t targetDelayMs;         // current target playout delay
+    uint32_t underruns;             // audio arrived later than the target delay could cover
+    uint32_t framesDroppedLatency;  // dropped to shrink the pending audio towards the target
+    uint32_t framesDroppedOverflow; // dropped because the queue reached its size limit
+} AUDIO_JITTER_BUFFER_STATS, *PAUDIO_JITTER_BUFFER_STATS;
+
+void LiGetAudioJitterBufferStats(PAUDIO_JITTER_BUFFER_STATS stats);
+
+// Returns the estimated drift of the host's audio clock relative to the local clock used by
+// LiGetMicroseconds() in parts per million. A positive value means the host is producing audio
+// slower than real-time on this client, so renderers should resample to play slightly slower to
+// keep their buffers from draining. The estimate is updated every 10 seconds from the RTP
+// timestamps and receive times of audio packets. Returns false until enough audio has been
+// received to produce an estimate.
+bool LiGetAudioClockDrift(float* driftPpm);
+
+// These functions map host presentation timestamps onto the local clock used by LiGetMicroseconds().
+// Each stream is mapped using its minimum transit time observed over the last few seconds, then
+// delayed by its jitter allowance (the 95th percentile of transit times above the minimum). This is
+// the earliest time that data from the stream can be presented smoothly with the current network
+// jitter. The host's audio and video timestamps don't share an epoch, so the two streams are mapped
+// independently and these times do NOT align audio with video. The video time is based on when
+// frames are fully received, so it includes the time taken to transfer each frame.
+//
+// The audio timestamp is the RTP timestamp of the audio, as returned by LiGetCurrentAudioRtpTimestamp().
+// These return false until data has been received for the requested stream.
+bool LiGetAudioPresentationTime(uint32_t rtpTimestamp, uint64_t* localTimeUs);
+bool LiGetVideoPresentationTime(PDECODE_UNIT decodeUnit, uint64_t* localTimeUs);
+
+// Returns the RTP timestamp of the audio being submitted to the renderer. This is only valid when called
+// from decodeAndPlaySample() or decodeAndPlaySamples(), where it refers to the first sample submitted.
+uint32_t LiGetCurrentAudioRtpTimestamp(void);
+
 // Returns a pointer to a struct containing various statistics about the RTP video stream.
 // The data should be considered read-only and must not be modified.
 // Right now this is mainly used to track total video and FEC packets, as there are
@@ -900,10 +1069,171 @@ typedef struct _RTP_VIDEO_STATS {
     uint32_t packetCountOOS;           // out-of-sequence packets
     uint32_t packetCountInvalid;       // corrupted packets, etc
     uint32_t packetCountFecInvalid;    // invalid FEC packet
+    uint32_t speculativeRfiCorrect;    // predicted frame loss was confirmed
+    uint32_t speculativeRfiIncorrect;  // predicted frame loss, but the frame was recovered
+    uint32_t reorderTolerance;         // packets of reordering tolerated before predicting frame loss
 } RTP_VIDEO_STATS, *PRTP_VIDEO_STATS;
 
 const RTP_VIDEO_STATS* LiGetRTPVideoStats(void);
 
+// Timings of crypto operations for each stream. Only 1 out of every 16 operations is
+// timed to keep the overhead low, so the averages are computed from the sampled values.
+// For example, sampledTimeNs / sampledMessages gives the average ns per message.
+typedef struct _CRYPTO_OPERATION_STATS {
+    uint32_t sampledMessages;
+    uint64_t sampledBytes;
+    uint64_t sampledTimeNs;
+} CRYPTO_OPERATION_STATS, *PCRYPTO_OPERATION_STATS;
+
+typedef struct _CRYPTO_STATS {
+    // Name of the crypto library in use
+    const char* backend;
+
+    // Set when AES-GCM is handled by the built-in implementation rather than the crypto library
+    bool builtInAesGcm;
+
+    CRYPTO_OPERATION_STATS videoDecrypt;   // AES-GCM video packets
+    CRYPTO_OPERATION_STATS audioDecrypt;   // AES-CBC audio packets
+    CRYPTO_OPERATION_STATS controlEncrypt; // AES-GCM control stream messages
+    CRYPTO_OPERATION_STATS controlDecrypt; // AES-GCM control stream messages
+    CRYPTO_OPERATION_STATS inputEncrypt;   // AES-GCM or AES-CBC input messages
+} CRYPTO_STATS, *PCRYPTO_STATS;
+
+// Fills the provided struct with a snapshot of the statistics about crypto operations during
+// the current connection. This may be called from any thread. Returns false if no connection
+// has been started yet.
+bool LiGetCryptoStats(PCRYPTO_STATS stats);
+
+// Fills the provided struct with statistics about frames dropped from the video frame queue
+// by the policy selected in videoQueuePolicy. This may be called from any thread. Returns false
+// if CAPABILITY_DIRECT_SUBMIT is set for the video renderer, since there is no queue in that case.
+typedef struct _VIDEO_QUEUE_STATS {
+    uint32_t framesDroppedOverflow;       // queue reached its size limit
+    uint32_t framesDroppedLatency;        // replaced by an IDR frame after missing the latency deadline
+    uint32_t framesDroppedSuperseded;     // replaced by an IDR frame (latest frame only)
+    uint32_t framesDroppedDecoderRefresh; // flushed by a decoder refresh request
+    uint32_t rfiRecoveries;               // queue drops recovered using RFI
+    uint32_t idrRecoveries;               // queue drops recovered using an IDR frame
+} VIDEO_QUEUE_STATS, *PVIDEO_QUEUE_STATS;
+
+bool LiGetVideoQueueStats(PVIDEO_QUEUE_STATS stats);
+
+// Returns percentiles of the time in microseconds between a video frame being queued and
+// being dequeued by the decoder thread or pull renderer. Returns false if no frames have
+// been dequeued yet. Only relevant if CAPABILITY_DIRECT_SUBMIT is not set for the video renderer.
+bool LiGetVideoFrameHandoffLatency(uint32_t* p50Us, uint32_t* p90Us, uint32_t* p99Us);
+
+// These functions report how the library recovered from lost or undecodable video frames.
+// Each recovery is one of:
+// - LI_RECOVERY_ACTION_RFI: reference frame invalidation of the lost frame range
+// - LI_RECOVERY_ACTION_LTR: RFI that the host can satisfy from an acknowledged long-term
+//   reference frame (Sunshine only)
+// - LI_RECOVERY_ACTION_IDR: an IDR frame request
+//
+// Loss ranges reported while a recovery is in progress are merged into it, so one request
+// covers a burst of loss. RFI recoveries that don't complete within a few RTTs are escalated
+// to an IDR frame, and repeated IDR frame requests are held back while one is in flight.
+#define LI_RECOVERY_ACTION_RFI   0
+#define LI_RECOVERY_ACTION_LTR   1
+#define LI_RECOVERY_ACTION_IDR   2
+#define LI_RECOVERY_ACTION_COUNT 3
+
+#define LI_RECOVERY_TRIGGER_FRAME_LOSS  0 // frames lost in transit or corrupt
+#define LI_RECOVERY_TRIGGER_RFI_TIMEOUT 1 // an RFI recovery did not complete in time
+#define LI_RECOVERY_TRIGGER_QUEUE_DROP  2 // frames dropped from the decode unit queue
+#define LI_RECOVERY_TRIGGER_DROP_LIMIT  3 // too many consecutive frames were dropped
+#define LI_RECOVERY_TRIGGER_DECODER     4 // the decoder returned DR_NEED_IDR
+#define LI_RECOVERY_TRIGGER_CLIENT      5 // the client called LiRequestIdrFrame()
+#define LI_RECOVERY_TRIGGER_QUEUE_FULL  6 // the RFI request couldn't be queued
+
+typedef struct _RECOVERY_EVENT {
+    uint64_t requestTimeUs;     // LiGetMicroseconds() time of the decision
+    uint32_t startFrame;        // lost frame range (0 if not known)
+    uint32_t endFrame;
+    uint32_t recoveryTimeUs;    // time until the first decodable frame (0 if not recovered)
+    uint32_t coalescedRequests; // later loss ranges or requests covered by this recovery
+    uint8_t action;             // LI_RECOVERY_ACTION_*
+    uint8_t trigger;            // LI_RECOVERY_TRIGGER_*
+    bool superseded;            // abandoned in favor of an IDR frame
+} RECOVERY_EVENT, *PRECOVERY_EVENT;
+
+// Copies up to maxEvents of the most recent recovery decisions (oldest first) into events
+// and returns the number copied.
+int LiGetRecoveryEvents(PRECOVERY_EVENT events, int maxEvents);
+
+// Fills the provided struct with totals of recovery decisions. Returns false if no
+// recoveries have been requested yet.
+typedef struct _RECOVERY_STATS {
+    uint32_t rfiRequests;          // recoveries using RFI
+    uint32_t ltrRecoveries;        // recoveries using RFI from an acknowledged LTR frame
+    uint32_t idrRequests;          // recoveries using an IDR frame
+    uint32_t rfiEscalations;       // RFI recoveries that timed out and became IDR requests
+    uint32_t rangesCoalesced;      // loss ranges merged into a recovery in progress
+    uint32_t idrRequestsCoalesced; // IDR frame requests covered by one already in flight
+} RECOVERY_STATS, *PRECOVERY_STATS;
+
+bool LiGetRecoveryStats(PRECOVERY_STATS stats);
+
+// Returns percentiles of the time in microseconds from a recovery decision of the given
+// LI_RECOVERY_ACTION_* type until the first decodable frame. Returns false if no recoveries
+// of that type have completed yet.
+bool LiGetRecoveryLatency(int action, uint32_t* p50Us, uint32_t* p90Us, uint32_t* p99Us);
+
+// Fills the provided struct with statistics about batching of mouse, pen, and controller
+// motion events into input packets. This may be called from any thread. Returns false if
+// no mouse, pen, or controller motion packets have been sent yet.
+typedef struct _INPUT_BATCHING_STATS {
+    uint32_t mousePackets;        // relative and absolute mouse motion packets sent
+    uint32_t mouseEvents;         // mouse motion events merged into those packets
+    uint32_t penPackets;          // pen move and hover packets sent
+    uint32_t penEvents;           // pen move and hover events merged into those packets
+    uint32_t motionPackets;       // controller motion sensor packets sent
+    uint32_t motionEvents;        // motion sensor events merged into those packets
+    uint32_t motionPacketsHeld;   // motion packets held until the host's requested report rate allowed them
+    uint32_t maxEventsPerPacket;  // most motion events merged into a single packet
+    uint32_t delayedPackets;      // packets held back until the end of a batching window
+    uint32_t datagramsSaved;      // input messages that shared a datagram with an earlier message in the same flush
+} INPUT_BATCHING_STATS, *PINPUT_BATCHING_STATS;
+
+bool LiGetInputBatchingStats(PINPUT_BATCHING_STATS stats);
+
+// Returns percentiles of the time in microseconds between the first motion event in a
+// batch being queued and the packet being sent. Returns false if no mouse, pen, or
+// controller motion packets have been sent yet.
+bool LiGetInputBatchingDelay(uint32_t* p50Us, uint32_t* p90Us, uint32_t* p99Us);
+
+// Event types for LiGetInputLatency()
+#define LI_INPUT_LATENCY_KEYBOARD      0 // Keyboard and UTF-8 text events
+#define LI_INPUT_LATENCY_MOUSE_BUTTON  1 // Mouse button and scroll events
+#define LI_INPUT_LATENCY_MOUSE_MOTION  2 // Relative and absolute mouse motion
+#define LI_INPUT_LATENCY_PEN           3
+#define LI_INPUT_LATENCY_TOUCH         4
+#define LI_INPUT_LATENCY_CONTROLLER    5 // Controller state, arrival, touch, and battery events
+#define LI_INPUT_LATENCY_MOTION_SENSOR 6
+#define LI_INPUT_LATENCY_TYPE_COUNT    7
+
+// Stages of the input path for LiGetInputLatency()
+#define LI_INPUT_LATENCY_STAGE_QUEUE 0 // From the LiSend*() call until the input thread picks up the packet
+#define LI_INPUT_LATENCY_STAGE_BATCH 1 // Waiting for the batching window and merging later events
+#define LI_INPUT_LATENCY_STAGE_SEND  2 // Until the control stream thread has encrypted the message and handed it to ENet
+#define LI_INPUT_LATENCY_STAGE_FLUSH 3 // Until the datagram carrying the message has been written to the socket
+#define LI_INPUT_LATENCY_STAGE_TOTAL 4 // From the LiSend*() call until the message has been written to the socket
+#define LI_INPUT_LATENCY_STAGE_COUNT 5
+
+// Returns percentiles of the time in microseconds that input events of the specified
+// LI_INPUT_LATENCY_* type spend in the specified stage of the input path. Messages sent
+// with ENet are queued for the control stream thread, which owns the ENet host, so the
+// SEND stage includes waiting for that thread. The FLUSH stage includes any time spent
+// holding the message back to share a datagram with the rest of its batch. On servers
+// that take input over TCP, the FLUSH stage is always 0. Returns false if no events of
+// that type have been sent yet.
+bool LiGetInputLatency(int eventType, int stage, uint32_t* p50Us, uint32_t* p90Us, uint32_t* p99Us);
+
+// Returns percentiles of the time in microseconds that senders of reliable control and input
+// messages were blocked waiting for the message to be sent, along with the number of messages
+// that took longer than 10 ms. Returns false if no reliable messages have been sent yet.
+bool LiGetControlSendCompletionLatency(uint32_t* p50Us, uint32_t* p90Us, uint32_t* p99Us, uint32_t* timeouts);
+
 // Port index flags for use with LiGetPortFromPortFlagIndex() and LiGetProtocolFromPortFlagIndex()
 #define ML_PORT_INDEX_TCP_47984 0
 #define ML_PORT_INDEX_TCP_47989 1
@@ -961,6 +1291,10 @@ unsigned int LiTestClientConnectivity(const char* testServer, unsigned short ref
 // must call LiCompleteVideoFrame() to notify that processing is completed. The same DR_* status values
 // from drSubmitDecodeUnit() must be passed to LiCompleteVideoFrame() as the drStatus argument.
 //
+// LiPeekNextVideoFrame() returns the next frame without dequeuing it. The frame is held for the caller
+// until it is dequeued by the next call to LiWaitForNextVideoFrame() or LiPollNextVideoFrame(), so it
+// won't be freed by the queue policy in the meantime. These functions must all be called from the same thread.
+//
 // In order to safely use these functions, you must set CAPABILITY_PULL_RENDERER on the video decoder.
 typedef void* VIDEO_FRAME_HANDLE;
 bool LiWaitForNextVideoFrame(VIDEO_FRAME_HANDLE* frameHandle, PDECODE_UNIT* decodeUnit);
@@ -0,0 +1,231 @@
+#include "MpmcRingQueue.h"
+
+int MrqInitializeQueue(PMPMC_RING_QUEUE queue, int sizeBound) {
+    uint32_t capacity;
+    int err;
+
+    LC_ASSERT(sizeBound > 0);
+
+    memset(queue, 0, sizeof(*queue));
+
+    // Round the capacity up to a power of 2 so we can mask the indexes
+    capacity = 1;
+    while (capacity < (uint32_t)sizeBound) {
+        capacity <<= 1;
+    }
+
+    queue->slots = malloc(capacity * sizeof(*queue->slots));
+    if (queue->slots == NULL) {
+        return -1;
+    }
+
+    // Each slot starts out ready to be filled on the first lap
+    for (uint32_t i = 0; i < capacity; i++) {
+        queue->slots[i].sequence = i;
+        queue->slots[i].data = NULL;
+    }
+
+    err = PltCreateMutex(&queue->mutex);
+    if (err != 0) {
+        free(queue->slots);
+        return err;
+    }
+
+    err = PltCreateConditionVariable(&queue->cond, &queue->mutex);
+    if (err != 0) {
+        PltDeleteMutex(&queue->mutex);
+        free(queue->slots);
+        return err;
+    }
+
+    queue->mask = capacity - 1;
+
+    return 0;
+}
+
+// The caller must reclaim any remaining items before destroying the queue
+void MrqDestroyQueue(PMPMC_RING_QUEUE queue) {
+    LC_ASSERT(MrqGetItemCount(queue) == 0);
+
+    PltDeleteMutex(&queue->mutex);
+    PltDeleteConditionVariable(&queue->cond);
+    free(queue->slots);
+}
+
+static void signalConsumer(PMPMC_RING_QUEUE queue) {
+    // Taking the mutex ensures the consumer is either already waiting on
+    // the condition variable or has not yet checked the queue state.
+    PltLockMutex(&queue->mutex);
+    PltSignalConditionVariable(&queue->cond);
+    PltUnlockMutex(&queue->mutex);
+}
+
+void MrqSignalQueueShutdown(PMPMC_RING_QUEUE queue) {
+    PltAtomicStore32(&queue->shutdown, 1);
+    signalConsumer(queue);
+}
+
+void MrqSignalQueueDrain(PMPMC_RING_QUEUE queue) {
+    PltAtomicStore32(&queue->draining, 1);
+    signalConsumer(queue);
+}
+
+// This is only a snapshot, since other threads may be offering or polling concurrently
+int MrqGetItemCount(PMPMC_RING_QUEUE queue) {
+    uint32_t head = PltAtomicLoad32(&queue->head);
+    uint32_t tail = PltAtomicLoad32(&queue->tail);
+
+    return (int)(tail - head);
+}
+
+int MrqOfferQueueItem(PMPMC_RING_QUEUE queue, void* data) {
+    PMPMC_RING_QUEUE_SLOT slot;
+    uint32_t tail;
+
+    if (PltAtomicLoad32(&queue->shutdown) || PltAtomicLoad32(&queue->draining)) {
+        return LBQ_INTERRUPTED;
+    }
+
+    tail = PltAtomicLoad32(&queue->tail);
+    for (;;) {
+        int32_t lap;
+
+        slot = &queue->slots[tail & queue->mask];
+        lap = (int32_t)(PltAtomicLoad32(&slot->sequence) - tail);
+        if (lap == 0) {
+            // The slot is empty, so try to claim it
+            if (PltAtomicCompareExchange32(&queue->tail, tail, tail + 1)) {
+                break;
+            }
+        }
+        else if (lap < 0) {
+            // The slot still holds an item from the previous lap
+            return LBQ_BOUND_EXCEEDED;
+        }
+
+        // Another producer claimed this slot first
+        tail = PltAtomicLoad32(&queue->tail);
+    }
+
+    // Publish the item to consumers
+    slot->data = data;
+    PltAtomicStore32(&slot->sequence, tail + 1);
+
+    // Only pay for the wakeup if the consumer has parked
+    if (PltAtomicLoad32(&queue->consumerParked)) {
+        signalConsumer(queue);
+    }
+
+    return LBQ_SUCCESS;
+}
+
+static bool tryDequeue(PMPMC_RING_QUEUE queue, void** data) {
+    PMPMC_RING_QUEUE_SLOT slot;
+    uint32_t head;
+
+    head = PltAtomicLoad32(&queue->head);
+    for (;;) {
+        int32_t lap;
+
+        slot = &queue->slots[head & queue->mask];
+        lap = (int32_t)(PltAtomicLoad32(&slot->sequence) - (head + 1));
+        if (lap == 0) {
+            // The slot has been published, so try to claim it
+            if (PltAtomicCompareExchange32(&queue->head, head, head + 1)) {
+                break;
+            }
+        }
+        else if (lap < 0) {
+            // The queue is empty or the producer hasn't finished publishing
+            // this slot yet. It will signal us when it's done if we park.
+            return false;
+        }
+
+        // Another consumer claimed this slot first
+        head = PltAtomicLoad32(&queue->head);
+    }
+
+    // Hand the slot back to producers for the next lap
+    *data = slot->data;
+    PltAtomicStore32(&slot->sequence, head + queue->mask + 1);
+    return true;
+}
+
+// Removes an item regardless of the queue state
+bool MrqReclaimQueueElement(PMPMC_RING_QUEUE queue, void** data) {
+    return tryDequeue(queue, data);
+}
+
+// This must only be called by the single thread that waits on the queue
+int MrqPeekQueueElement(PMPMC_RING_QUEUE queue, void** data) {
+    PMPMC_RING_QUEUE_SLOT slot;
+    uint32_t head;
+
+    if (PltAtomicLoad32(&queue->shutdown)) {
+        return LBQ_INTERRUPTED;
+    }
+
+    head = PltAtomicLoad32(&queue->head);
+    slot = &queue->slots[head & queue->mask];
+    if (PltAtomicLoad32(&slot->sequence) != head + 1) {
+        return PltAtomicLoad32(&queue->draining) ? LBQ_INTERRUPTED : LBQ_NO_ELEMENT;
+    }
+
+    *data = slot->data;
+    return LBQ_SUCCESS;
+}
+
+int MrqPollQueueElement(PMPMC_RING_QUEUE queue, void** data) {
+    if (PltAtomicLoad32(&queue->shutdown)) {
+        return LBQ_INTERRUPTED;
+    }
+
+    if (tryDequeue(queue, data)) {
+        return LBQ_SUCCESS;
+    }
+
+    return PltAtomicLoad32(&queue->draining) ? LBQ_INTERRUPTED : LBQ_NO_ELEMENT;
+}
+
+// Returns LBQ_NO_ELEMENT if the caller should keep waiting
+static int tryWaitingDequeue(PMPMC_RING_QUEUE queue, void** data) {
+    // If we're shutting down, abort immediately, even if there's data available
+    if (PltAtomicLoad32(&queue->shutdown)) {
+        return LBQ_INTERRUPTED;
+    }
+
+    if (tryDequeue(queue, data)) {
+        return LBQ_SUCCESS;
+    }
+
+    // If we're draining, only abort if we have no data available
+    if (PltAtomicLoad32(&queue->draining)) {
+        return LBQ_INTERRUPTED;
+    }
+
+    return LBQ_NO_ELEMENT;
+}
+
+// This must only be called by a single thread
+int MrqWaitForQueueElement(PMPMC_RING_QUEUE queue, void** data) {
+    int err;
+
+    err = tryWaitingDequeue(queue, data);
+    if (err != LBQ_NO_ELEMENT) {
+        return err;
+    }
+
+    PltLockMutex(&queue->mutex);
+
+    // Producers check this flag after publishing an item, and we check for an
+    // item after setting this flag, so at least one of us will see the other.
+    PltAtomicStore32(&queue->consumerParked, 1);
+    while ((err = tryWaitingDequeue(queue, data)) == LBQ_NO_ELEMENT) {
+        PltWaitForConditionVariable(&queue->cond, &queue->mutex);
+    }
+    PltAtomicStore32(&queue->consumerParked, 0);
+
+    PltUnlockMutex(&queue->mutex);
+
+    return err;
+}
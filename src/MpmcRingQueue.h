@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Platform.h"
+#include "PlatformThreads.h"
+#include "PlatformAtomics.h"
+#include "LinkedBlockingQueue.h"
+
+// A bounded ring queue that any number of threads may offer to and poll from
+// without taking a lock. Each slot carries a sequence number that tells whether
+// it is ready to be filled or drained for the current lap around the ring, so
+// producers and consumers only contend on a CAS of their own index.
+//
+// Only a single thread may wait on or peek at the queue. The size bound is
+// rounded up to a power of 2.
+//
+// This uses the same LBQ_* return codes as the LinkedBlockingQueue.
+typedef struct _MPMC_RING_QUEUE_SLOT {
+    volatile uint32_t sequence;
+    void* data;
+} MPMC_RING_QUEUE_SLOT, *PMPMC_RING_QUEUE_SLOT;
+
+typedef struct _MPMC_RING_QUEUE {
+    PMPMC_RING_QUEUE_SLOT slots;
+    uint32_t mask;
+
+    // Index of the next slot to fill. Advanced by CAS.
+    volatile uint32_t tail;
+
+    // Index of the next slot to drain. Advanced by CAS.
+    volatile uint32_t head;
+
+    volatile uint32_t consumerParked;
+    volatile uint32_t shutdown;
+    volatile uint32_t draining;
+
+    PLT_MUTEX mutex;
+    PLT_COND cond;
+} MPMC_RING_QUEUE, *PMPMC_RING_QUEUE;
+
+int MrqInitializeQueue(PMPMC_RING_QUEUE queue, int sizeBound);
+void MrqDestroyQueue(PMPMC_RING_QUEUE queue);
+int MrqOfferQueueItem(PMPMC_RING_QUEUE queue, void* data);
+int MrqWaitForQueueElement(PMPMC_RING_QUEUE queue, void** data);
+int MrqPollQueueElement(PMPMC_RING_QUEUE queue, void** data);
+int MrqPeekQueueElement(PMPMC_RING_QUEUE queue, void** data);
+bool MrqReclaimQueueElement(PMPMC_RING_QUEUE queue, void** data);
+void MrqSignalQueueShutdown(PMPMC_RING_QUEUE queue);
+void MrqSignalQueueDrain(PMPMC_RING_QUEUE queue);
+int MrqGetItemCount(PMPMC_RING_QUEUE queue);
@@ -67,6 +67,33 @@ void setThreadNameWin32(const char* name) {
 }
 #endif
 
+#if defined(LC_WINDOWS) && defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+// Creating a high resolution timer is expensive, so threads created by
+// PltCreateThread() keep one in thread-local storage for PltSleepUs().
+static DWORD sleepTimerTlsIndex = TLS_OUT_OF_INDEXES;
+
+static HANDLE createSleepTimer(void) {
+    return CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+}
+
+static void createThreadSleepTimer(void) {
+    if (sleepTimerTlsIndex != TLS_OUT_OF_INDEXES) {
+        // If this fails, PltSleepUs() will create a timer for each sleep
+        TlsSetValue(sleepTimerTlsIndex, createSleepTimer());
+    }
+}
+
+static void destroyThreadSleepTimer(void) {
+    if (sleepTimerTlsIndex != TLS_OUT_OF_INDEXES) {
+        HANDLE timer = TlsGetValue(sleepTimerTlsIndex);
+        if (timer != NULL) {
+            CloseHandle(timer);
+            TlsSetValue(sleepTimerTlsIndex, NULL);
+        }
+    }
+}
+#endif
+
 #if defined(LC_WINDOWS)
 DWORD WINAPI ThreadProc(LPVOID lpParameter) {
     struct thread_context* ctx = (struct thread_context*)lpParameter;
@@ -89,8 +116,16 @@ void* ThreadProc(void* context) {
     pthread_setname_np(ctx->name);
 #endif
 
+#if defined(LC_WINDOWS) && defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+    createThreadSleepTimer();
+#endif
+
     ctx->entry(ctx->context);
 
+#if defined(LC_WINDOWS) && defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+    destroyThreadSleepTimer();
+#endif
+
     free(ctx);
 
 #if defined(LC_WINDOWS) || defined(__vita__) || defined(__WIIU__)
@@ -114,6 +149,52 @@ void PltSleepMs(int ms) {
 #endif
 }
 
+void PltSleepUs(uint64_t us) {
+#if defined(LC_WINDOWS) && defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+    // High resolution timers aren't subject to the system timer period
+    // that limits SleepEx() to millisecond granularity or worse. Threads
+    // that we didn't create have no cached timer, so they get a temporary one.
+    HANDLE cachedTimer = sleepTimerTlsIndex != TLS_OUT_OF_INDEXES ? TlsGetValue(sleepTimerTlsIndex) : NULL;
+    HANDLE timer = cachedTimer != NULL ? cachedTimer : createSleepTimer();
+    if (timer != NULL) {
+        LARGE_INTEGER dueTime;
+
+        // Negative due times are relative and in 100 ns units
+        dueTime.QuadPart = -(LONGLONG)(us * 10);
+        if (SetWaitableTimer(timer, &dueTime, 0, NULL, NULL, FALSE)) {
+            WaitForSingleObject(timer, INFINITE);
+        }
+        if (timer != cachedTimer) {
+            CloseHandle(timer);
+        }
+    }
+    else {
+        // Unsupported prior to Windows 10 1803
+        SleepEx((DWORD)((us + 999) / 1000), FALSE);
+    }
+#elif defined(LC_WINDOWS)
+    SleepEx((DWORD)((us + 999) / 1000), FALSE);
+#elif defined(__3DS__)
+    svcSleepThread((s64)us * 1000);
+#elif defined(__linux__) && defined(HAVE_CLOCK_GETTIME)
+    struct timespec deadline;
+
+    // Sleep until an absolute deadline, so being interrupted by a signal
+    // doesn't extend the total sleep time when we resume sleeping.
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += us / 1000000;
+    deadline.tv_nsec += (us % 1000000) * 1000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR);
+#else
+    usleep((useconds_t)us);
+#endif
+}
+
 void PltSleepMsInterruptible(PLT_THREAD* thread, int ms) {
     while (ms > 0 && !PltIsThreadInterrupted(thread)) {
         int msToSleep = ms < INTERRUPT_PERIOD_MS ? ms : INTERRUPT_PERIOD_MS;
@@ -383,6 +464,13 @@ int PltCreateConditionVariable(PLT_COND* cond, PLT_MUTEX* mutex) {
     OSFastCond_Init(cond, "");
 #elif defined(__3DS__)
     CondVar_Init(cond);
+#elif defined(__linux__) && defined(HAVE_CLOCK_GETTIME)
+    // Use the monotonic clock for timed waits so they aren't affected by wall clock changes
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
 #else
     pthread_cond_init(cond, NULL);
 #endif
@@ -416,6 +504,19 @@ void PltSignalConditionVariable(PLT_COND* cond) {
 #endif
 }
 
+void PltBroadcastConditionVariable(PLT_COND* cond) {
+#if defined(LC_WINDOWS)
+    WakeAllConditionVariable(cond);
+#elif defined(__WIIU__)
+    // OSFastCond_Signal() already wakes all waiters
+    OSFastCond_Signal(cond);
+#elif defined(__3DS__)
+    CondVar_Broadcast(cond);
+#else
+    pthread_cond_broadcast(cond);
+#endif
+}
+
 void PltWaitForConditionVariable(PLT_COND* cond, PLT_MUTEX* mutex) {
 #if defined(LC_WINDOWS)
     SleepConditionVariableSRW(cond, mutex, INFINITE, 0);
@@ -428,9 +529,47 @@ void PltWaitForConditionVariable(PLT_COND* cond, PLT_MUTEX* mutex) {
 #endif
 }
 
+// Returns false if the timeout expired. Like any condition variable wait, this
+// may also return early without being signalled, so callers must recheck.
+bool PltWaitForConditionVariableTimeout(PLT_COND* cond, PLT_MUTEX* mutex, uint32_t timeoutMs) {
+#if defined(LC_WINDOWS)
+    return SleepConditionVariableSRW(cond, mutex, timeoutMs, 0);
+#elif defined(__WIIU__)
+    // OSFastCondition has no timed wait, so just give other threads a chance to run
+    PltUnlockMutex(mutex);
+    PltSleepMs(1);
+    PltLockMutex(mutex);
+    return true;
+#elif defined(__3DS__)
+    return CondVar_WaitTimeout(cond, mutex, (s64)timeoutMs * 1000000) == 0;
+#elif defined(LC_DARWIN)
+    struct timespec ts;
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = (timeoutMs % 1000) * 1000000;
+    return pthread_cond_timedwait_relative_np(cond, mutex, &ts) != ETIMEDOUT;
+#else
+    struct timespec ts;
+#if defined(__linux__) && defined(HAVE_CLOCK_GETTIME)
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    ts.tv_sec = tv.tv_sec;
+    ts.tv_nsec = tv.tv_usec * 1000;
+#endif
+    ts.tv_sec += timeoutMs / 1000;
+    ts.tv_nsec += (timeoutMs % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return pthread_cond_timedwait(cond, mutex, &ts) != ETIMEDOUT;
+#endif
+}
+
 //// Begin timing functions
 
-// These functions return a number of microseconds or milliseconds since an opaque start time.
+// These functions return a number of nanoseconds, microseconds, or milliseconds since an opaque start time.
 
 static bool ticks_started = false;
 
@@ -457,6 +596,19 @@ uint64_t PltGetMicroseconds(void) {
     return (uint64_t)(((now.QuadPart - start_ticks.QuadPart) * 1000000) / ticks_per_second.QuadPart);
 }
 
+uint64_t PltGetNanoseconds(void) {
+    if (!ticks_started) {
+        PltTicksInit();
+    }
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+
+    // Convert whole seconds separately to avoid overflowing the multiplication
+    uint64_t elapsed = (uint64_t)(now.QuadPart - start_ticks.QuadPart);
+    uint64_t frequency = (uint64_t)ticks_per_second.QuadPart;
+    return ((elapsed / frequency) * 1000000000) + (((elapsed % frequency) * 1000000000) / frequency);
+}
+
 #elif defined(LC_DARWIN)
 
 static uint64_t start_ns;
@@ -477,6 +629,13 @@ uint64_t PltGetMicroseconds(void) {
     return (now_ns - start_ns) / 1000;
 }
 
+uint64_t PltGetNanoseconds(void) {
+    if (!ticks_started) {
+        PltTicksInit();
+    }
+    return clock_gettime_nsec_np(CLOCK_UPTIME_RAW) - start_ns;
+}
+
 #elif defined(__vita__)
 
 static uint64_t start;
@@ -497,6 +656,11 @@ uint64_t PltGetMicroseconds(void) {
     return (uint64_t)(now - start);
 }
 
+uint64_t PltGetNanoseconds(void) {
+    // The process timer only has microsecond resolution
+    return PltGetMicroseconds() * 1000;
+}
+
 #elif defined(__3DS__)
 
 static uint64_t start;
@@ -517,6 +681,14 @@ uint64_t PltGetMicroseconds(void) {
     return elapsed * 1000 / CPU_TICKS_PER_MSEC;
 }
 
+uint64_t PltGetNanoseconds(void) {
+    if (!ticks_started) {
+        PltTicksInit();
+    }
+    uint64_t elapsed = svcGetSystemTick() - start;
+    return (uint64_t)(elapsed * (1000000 / CPU_TICKS_PER_MSEC));
+}
+
 #else
 
 /* Use CLOCK_MONOTONIC_RAW, if available, which is not subject to adjustment by NTP */
@@ -568,6 +740,26 @@ uint64_t PltGetMicroseconds(void) {
     }
 }
 
+uint64_t PltGetNanoseconds(void) {
+    if (!ticks_started) {
+        PltTicksInit();
+    }
+
+    if (has_monotonic_time) {
+#ifdef HAVE_CLOCK_GETTIME
+        struct timespec now;
+        clock_gettime(PLT_MONOTONIC_CLOCK, &now);
+        return (uint64_t)(((int64_t)(now.tv_sec - start_ts.tv_sec) * 1000000000) + (now.tv_nsec - start_ts.tv_nsec));
+#else
+        LC_ASSERT(false);
+        return 0;
+#endif
+    } else {
+        // gettimeofday() only has microsecond resolution
+        return PltGetMicroseconds() * 1000;
+    }
+}
+
 #endif
 
 uint64_t PltGetMillis(void) {
@@ -614,6 +806,12 @@ int initializePlatform(void) {
     int err;
 
     PltTicksInit();
+    PltResetCryptoStats();
+
+#if defined(LC_WINDOWS) && defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+    // If this fails, PltSleepUs() will create a timer for each sleep
+    sleepTimerTlsIndex = TlsAlloc();
+#endif
 
     err = initializePlatformSockets();
     if (err != 0) {
@@ -641,4 +839,12 @@ void cleanupPlatform(void) {
     LC_ASSERT(activeMutexes == 0);
     LC_ASSERT(activeEvents == 0);
     LC_ASSERT(activeCondVars == 0);
+
+#if defined(LC_WINDOWS) && defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+    // All of our threads have exited and closed their timers by now
+    if (sleepTimerTlsIndex != TLS_OUT_OF_INDEXES) {
+        TlsFree(sleepTimerTlsIndex);
+        sleepTimerTlsIndex = TLS_OUT_OF_INDEXES;
+    }
+#endif
 }
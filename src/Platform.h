@@ -182,5 +182,7 @@ void PltTicksInit(void);
 
 uint64_t PltGetMicroseconds(void);
 
+uint64_t PltGetNanoseconds(void);
+
 uint64_t PltGetMillis(void);
 
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Platform.h"
+
+// All of these operations are sequentially consistent. They operate on naturally
+// aligned 32-bit values or pointers that are shared between threads without a lock.
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+
+static inline uint32_t PltAtomicLoad32(volatile uint32_t* ptr) {
+    return (uint32_t)InterlockedCompareExchange((volatile LONG*)ptr, 0, 0);
+}
+
+static inline void PltAtomicStore32(volatile uint32_t* ptr, uint32_t value) {
+    InterlockedExchange((volatile LONG*)ptr, (LONG)value);
+}
+
+static inline bool PltAtomicCompareExchange32(volatile uint32_t* ptr, uint32_t expected, uint32_t desired) {
+    return (uint32_t)InterlockedCompareExchange((volatile LONG*)ptr, (LONG)desired, (LONG)expected) == expected;
+}
+
+// Returns the value after the addition
+static inline uint32_t PltAtomicAdd32(volatile uint32_t* ptr, uint32_t value) {
+    return (uint32_t)InterlockedExchangeAdd((volatile LONG*)ptr, (LONG)value) + value;
+}
+
+static inline void* PltAtomicLoadPtr(void* volatile* ptr) {
+    return InterlockedCompareExchangePointer(ptr, NULL, NULL);
+}
+
+static inline void PltAtomicStorePtr(void* volatile* ptr, void* value) {
+    InterlockedExchangePointer(ptr, value);
+}
+
+static inline bool PltAtomicCompareExchangePtr(void* volatile* ptr, void* expected, void* desired) {
+    return InterlockedCompareExchangePointer(ptr, desired, expected) == expected;
+}
+
+#define PltCpuRelax() YieldProcessor()
+#else
+static inline uint32_t PltAtomicLoad32(volatile uint32_t* ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+}
+
+static inline void PltAtomicStore32(volatile uint32_t* ptr, uint32_t value) {
+    __atomic_store_n(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+static inline bool PltAtomicCompareExchange32(volatile uint32_t* ptr, uint32_t expected, uint32_t desired) {
+    return __atomic_compare_exchange_n(ptr, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+// Returns the value after the addition
+static inline uint32_t PltAtomicAdd32(volatile uint32_t* ptr, uint32_t value) {
+    return __atomic_add_fetch(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+static inline void* PltAtomicLoadPtr(void* volatile* ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+}
+
+static inline void PltAtomicStorePtr(void* volatile* ptr, void* value) {
+    __atomic_store_n(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+static inline bool PltAtomicCompareExchangePtr(void* volatile* ptr, void* expected, void* desired) {
+    return __atomic_compare_exchange_n(ptr, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+#if defined(__i386__) || defined(__x86_64__)
+#define PltCpuRelax() __builtin_ia32_pause()
+#elif defined(__aarch64__) || (defined(__ARM_ARCH) && __ARM_ARCH >= 7)
+#define PltCpuRelax() __asm__ __volatile__("yield")
+#else
+#define PltCpuRelax()
+#endif
+#endif
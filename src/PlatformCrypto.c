@@ -17,28 +17,696 @@ static int addPkcs7PaddingInPlace(unsigned char* plaintext, int plaintextLen) {
     return paddedLength;
 }
 
-// When CIPHER_FLAG_PAD_TO_BLOCK_SIZE is used, inputData buffer must be allocated such that
-// the buffer length is at least ROUND_TO_PKCS7_PADDED_LEN(inputDataLength) and inputData
-// buffer may be modified! If CIPHER_FLAG_PAD_TO_BLOCK_SIZE is used, it must be passed to
-// all invocations of PltEncryptMessage() on the same crypto context (mixing padded and
-// non-padded encryption is not allowed).
-//
-// CIPHER_FLAG_PAD_TO_BLOCK_SIZE and CIPHER_FLAG_FINISH may not be used on the same context.
-//
-// When CIPHER_FLAG_FINISH is used with CBC encryption, the output buffer size must be at
-// least ROUND_TO_PKCS7_PADDED_LEN(inputDataLength).
-//
-// For GCM, the IV can change from message to message without CIPHER_FLAG_RESET_IV.
-// CIPHER_FLAG_RESET_IV is only required for GCM when the IV length changes.
-//
-// Changing the key between encrypt/decrypt calls on a single context is not supported.
-// Using the same crypto context for both encryption and decryption is not supported.
-bool PltEncryptMessage(PPLT_CRYPTO_CONTEXT ctx, int algorithm, int flags,
-                       unsigned char* key, int keyLength,
-                       unsigned char* iv, int ivLength,
-                       unsigned char* tag, int tagLength,
-                       unsigned char* inputData, int inputDataLength,
-                       unsigned char* outputData, int* outputDataLength) {
+// Built-in AES-128-GCM for the common case of a 16 byte key, 12 byte IV, and 16 byte tag
+// without additional authenticated data. This avoids the per-packet overhead of the
+// generic crypto library APIs by using a precomputed key schedule and GHASH keys.
+#if defined(_MSC_VER) && !defined(__clang__) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define FAST_GCM_X86
+#define FAST_GCM_TARGET
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#include <immintrin.h>
+#define FAST_GCM_X86
+#define FAST_GCM_TARGET __attribute__((target("aes,pclmul,sse4.1")))
+#elif defined(__aarch64__) && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES))
+#include <arm_neon.h>
+#define FAST_GCM_ARM64
+#define FAST_GCM_TARGET
+#endif
+
+#define FAST_GCM_STATE_UNINITIALIZED 0
+#define FAST_GCM_STATE_ACTIVE        1
+#define FAST_GCM_STATE_UNAVAILABLE   2
+
+#if defined(FAST_GCM_X86) || defined(FAST_GCM_ARM64)
+#define FAST_GCM_SUPPORTED
+
+#define FAST_GCM_KEY_LENGTH 16
+#define FAST_GCM_IV_LENGTH  12
+#define FAST_GCM_TAG_LENGTH 16
+
+// Number of messages decrypted in lockstep by PltDecryptMessageBatch()
+#define FAST_GCM_INTERLEAVE_WIDTH 4
+
+// Lengths of the data used to cross-check against the crypto library. These cover a
+// single block, the 4 block path once and several times over with a partial final
+// block, and a typical video packet. There is one for each interleaved message, so
+// the lockstep decryption of messages with different lengths is checked too.
+#define FAST_GCM_SELF_TEST_MAX_LENGTH 1392
+static const int fastGcmSelfTestLengths[FAST_GCM_INTERLEAVE_WIDTH] = { 16, 100, 200, FAST_GCM_SELF_TEST_MAX_LENGTH };
+
+#ifdef FAST_GCM_X86
+typedef __m128i GCM_BLOCK;
+
+#define gcmLoad(p) _mm_loadu_si128((const __m128i*)(p))
+#define gcmStore(p, v) _mm_storeu_si128((__m128i*)(p), (v))
+#define gcmZero() _mm_setzero_si128()
+#define gcmXor(a, b) _mm_xor_si128((a), (b))
+#define gcmOr(a, b) _mm_or_si128((a), (b))
+#define gcmShiftLeft32(v, n) _mm_slli_epi32((v), (n))
+#define gcmShiftRight32(v, n) _mm_srli_epi32((v), (n))
+#define gcmShiftLeftBytes(v, n) _mm_slli_si128((v), (n))
+#define gcmShiftRightBytes(v, n) _mm_srli_si128((v), (n))
+#define gcmClmulLow(a, b) _mm_clmulepi64_si128((a), (b), 0x00)
+#define gcmClmulHigh(a, b) _mm_clmulepi64_si128((a), (b), 0x11)
+#define gcmClmulCross(a, b) _mm_xor_si128(_mm_clmulepi64_si128((a), (b), 0x10), _mm_clmulepi64_si128((a), (b), 0x01))
+#define gcmByteSwap(v) _mm_shuffle_epi8((v), _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15))
+#define gcmSetLastWord(v, w) _mm_insert_epi32((v), (int)(w), 3)
+
+FAST_GCM_TARGET
+static inline GCM_BLOCK aesEncryptBlock(const GCM_BLOCK* roundKeys, GCM_BLOCK block) {
+    block = _mm_xor_si128(block, roundKeys[0]);
+    for (int round = 1; round < 10; round++) {
+        block = _mm_aesenc_si128(block, roundKeys[round]);
+    }
+    return _mm_aesenclast_si128(block, roundKeys[10]);
+}
+
+// Interleaving independent blocks hides the latency of the AES instructions
+FAST_GCM_TARGET
+static inline void aesEncrypt4Blocks(const GCM_BLOCK* roundKeys, GCM_BLOCK* blocks) {
+    GCM_BLOCK b0 = _mm_xor_si128(blocks[0], roundKeys[0]);
+    GCM_BLOCK b1 = _mm_xor_si128(blocks[1], roundKeys[0]);
+    GCM_BLOCK b2 = _mm_xor_si128(blocks[2], roundKeys[0]);
+    GCM_BLOCK b3 = _mm_xor_si128(blocks[3], roundKeys[0]);
+
+    for (int round = 1; round < 10; round++) {
+        b0 = _mm_aesenc_si128(b0, roundKeys[round]);
+        b1 = _mm_aesenc_si128(b1, roundKeys[round]);
+        b2 = _mm_aesenc_si128(b2, roundKeys[round]);
+        b3 = _mm_aesenc_si128(b3, roundKeys[round]);
+    }
+
+    blocks[0] = _mm_aesenclast_si128(b0, roundKeys[10]);
+    blocks[1] = _mm_aesenclast_si128(b1, roundKeys[10]);
+    blocks[2] = _mm_aesenclast_si128(b2, roundKeys[10]);
+    blocks[3] = _mm_aesenclast_si128(b3, roundKeys[10]);
+}
+
+static bool cpuSupportsFastGcm(void) {
+    unsigned int ecx;
+
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    ecx = (unsigned int)info[2];
+#else
+    unsigned int eax, ebx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+#endif
+
+    // AES-NI, PCLMULQDQ, SSSE3, and SSE4.1
+    return (ecx & (1U << 25)) && (ecx & (1U << 1)) && (ecx & (1U << 9)) && (ecx & (1U << 19));
+}
+#else
+typedef uint8x16_t GCM_BLOCK;
+
+#define gcmLoad(p) vld1q_u8((const uint8_t*)(p))
+#define gcmStore(p, v) vst1q_u8((uint8_t*)(p), (v))
+#define gcmZero() vdupq_n_u8(0)
+#define gcmXor(a, b) veorq_u8((a), (b))
+#define gcmOr(a, b) vorrq_u8((a), (b))
+#define gcmShiftLeft32(v, n) vreinterpretq_u8_u32(vshlq_n_u32(vreinterpretq_u32_u8(v), (n)))
+#define gcmShiftRight32(v, n) vreinterpretq_u8_u32(vshrq_n_u32(vreinterpretq_u32_u8(v), (n)))
+#define gcmShiftLeftBytes(v, n) vextq_u8(vdupq_n_u8(0), (v), 16 - (n))
+#define gcmShiftRightBytes(v, n) vextq_u8((v), vdupq_n_u8(0), (n))
+#define gcmByteSwap(v) vextq_u8(vrev64q_u8(v), vrev64q_u8(v), 8)
+#define gcmSetLastWord(v, w) vreinterpretq_u8_u32(vsetq_lane_u32((w), vreinterpretq_u32_u8(v), 3))
+
+#define gcmLow64(v) ((poly64_t)vgetq_lane_u64(vreinterpretq_u64_u8(v), 0))
+#define gcmHigh64(v) ((poly64_t)vgetq_lane_u64(vreinterpretq_u64_u8(v), 1))
+#define gcmClmul64(a, b) vreinterpretq_u8_p128(vmull_p64((a), (b)))
+#define gcmClmulLow(a, b) gcmClmul64(gcmLow64(a), gcmLow64(b))
+#define gcmClmulHigh(a, b) gcmClmul64(gcmHigh64(a), gcmHigh64(b))
+#define gcmClmulCross(a, b) veorq_u8(gcmClmul64(gcmLow64(a), gcmHigh64(b)), gcmClmul64(gcmHigh64(a), gcmLow64(b)))
+
+static inline GCM_BLOCK aesEncryptBlock(const GCM_BLOCK* roundKeys, GCM_BLOCK block) {
+    for (int round = 0; round < 9; round++) {
+        block = vaesmcq_u8(vaeseq_u8(block, roundKeys[round]));
+    }
+    return veorq_u8(vaeseq_u8(block, roundKeys[9]), roundKeys[10]);
+}
+
+// Interleaving independent blocks hides the latency of the AES instructions
+static inline void aesEncrypt4Blocks(const GCM_BLOCK* roundKeys, GCM_BLOCK* blocks) {
+    GCM_BLOCK b0 = blocks[0];
+    GCM_BLOCK b1 = blocks[1];
+    GCM_BLOCK b2 = blocks[2];
+    GCM_BLOCK b3 = blocks[3];
+
+    for (int round = 0; round < 9; round++) {
+        b0 = vaesmcq_u8(vaeseq_u8(b0, roundKeys[round]));
+        b1 = vaesmcq_u8(vaeseq_u8(b1, roundKeys[round]));
+        b2 = vaesmcq_u8(vaeseq_u8(b2, roundKeys[round]));
+        b3 = vaesmcq_u8(vaeseq_u8(b3, roundKeys[round]));
+    }
+
+    blocks[0] = veorq_u8(vaeseq_u8(b0, roundKeys[9]), roundKeys[10]);
+    blocks[1] = veorq_u8(vaeseq_u8(b1, roundKeys[9]), roundKeys[10]);
+    blocks[2] = veorq_u8(vaeseq_u8(b2, roundKeys[9]), roundKeys[10]);
+    blocks[3] = veorq_u8(vaeseq_u8(b3, roundKeys[9]), roundKeys[10]);
+}
+
+static bool cpuSupportsFastGcm(void) {
+    // The crypto extensions were required at compile-time
+    return true;
+}
+#endif
+
+static const uint8_t aesSbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+static void expandAes128Key(const uint8_t* key, uint8_t roundKeys[11][16]) {
+    static const uint8_t rcon[10] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36 };
+
+    memcpy(roundKeys[0], key, 16);
+    for (int i = 1; i < 11; i++) {
+        const uint8_t* prev = roundKeys[i - 1];
+        uint8_t* rk = roundKeys[i];
+
+        rk[0] = prev[0] ^ aesSbox[prev[13]] ^ rcon[i - 1];
+        rk[1] = prev[1] ^ aesSbox[prev[14]];
+        rk[2] = prev[2] ^ aesSbox[prev[15]];
+        rk[3] = prev[3] ^ aesSbox[prev[12]];
+        for (int j = 4; j < 16; j++) {
+            rk[j] = prev[j] ^ rk[j - 4];
+        }
+    }
+}
+
+// Multiplies two byte-swapped GHASH values without reducing the 256-bit product
+FAST_GCM_TARGET
+static inline void gcmMultiplyUnreduced(GCM_BLOCK a, GCM_BLOCK b, GCM_BLOCK* lo, GCM_BLOCK* hi) {
+    GCM_BLOCK mid = gcmClmulCross(a, b);
+
+    *lo = gcmXor(gcmClmulLow(a, b), gcmShiftLeftBytes(mid, 8));
+    *hi = gcmXor(gcmClmulHigh(a, b), gcmShiftRightBytes(mid, 8));
+}
+
+// Reduces a 256-bit product modulo the GCM polynomial. Since GCM uses bit-reflected
+// values, the product is shifted left by one bit before reducing it.
+FAST_GCM_TARGET
+static inline GCM_BLOCK gcmReduce(GCM_BLOCK lo, GCM_BLOCK hi) {
+    GCM_BLOCK loCarry = gcmShiftRight32(lo, 31);
+    GCM_BLOCK hiCarry = gcmShiftRight32(hi, 31);
+    GCM_BLOCK t1, t2;
+
+    lo = gcmOr(gcmShiftLeft32(lo, 1), gcmShiftLeftBytes(loCarry, 4));
+    hi = gcmOr(gcmShiftLeft32(hi, 1), gcmShiftLeftBytes(hiCarry, 4));
+    hi = gcmOr(hi, gcmShiftRightBytes(loCarry, 12));
+
+    t1 = gcmXor(gcmXor(gcmShiftLeft32(lo, 31), gcmShiftLeft32(lo, 30)), gcmShiftLeft32(lo, 25));
+    t2 = gcmShiftRightBytes(t1, 4);
+    lo = gcmXor(lo, gcmShiftLeftBytes(t1, 12));
+
+    t1 = gcmXor(gcmXor(gcmShiftRight32(lo, 1), gcmShiftRight32(lo, 2)), gcmShiftRight32(lo, 7));
+    lo = gcmXor(lo, gcmXor(t1, t2));
+
+    return gcmXor(hi, lo);
+}
+
+FAST_GCM_TARGET
+static inline GCM_BLOCK gcmMultiply(GCM_BLOCK a, GCM_BLOCK b) {
+    GCM_BLOCK lo, hi;
+
+    gcmMultiplyUnreduced(a, b, &lo, &hi);
+    return gcmReduce(lo, hi);
+}
+
+// Hashes 4 byte-swapped blocks with a single reduction using H^4 to H^1
+FAST_GCM_TARGET
+static inline GCM_BLOCK gcmHash4(GCM_BLOCK hash, const GCM_BLOCK* hashKeys, const GCM_BLOCK* blocks) {
+    GCM_BLOCK lo, hi, tmpLo, tmpHi;
+
+    gcmMultiplyUnreduced(gcmXor(hash, blocks[0]), hashKeys[3], &lo, &hi);
+    for (int i = 1; i < 4; i++) {
+        gcmMultiplyUnreduced(blocks[i], hashKeys[3 - i], &tmpLo, &tmpHi);
+        lo = gcmXor(lo, tmpLo);
+        hi = gcmXor(hi, tmpHi);
+    }
+
+    return gcmReduce(lo, hi);
+}
+
+// Returns the IV block with the specified big-endian counter in the last 4 bytes
+FAST_GCM_TARGET
+static inline GCM_BLOCK gcmCounterBlock(GCM_BLOCK ivBlock, uint32_t counter) {
+    return gcmSetLastWord(ivBlock, BE32(counter));
+}
+
+FAST_GCM_TARGET
+static void initializeFastGcmKeys(PPLT_CRYPTO_CONTEXT ctx, const uint8_t* key) {
+    GCM_BLOCK roundKeys[11];
+    GCM_BLOCK hashKeys[4];
+
+    expandAes128Key(key, ctx->fastGcmRoundKeys);
+    for (int i = 0; i < 11; i++) {
+        roundKeys[i] = gcmLoad(ctx->fastGcmRoundKeys[i]);
+    }
+
+    // H is the encryption of the zero block
+    hashKeys[0] = gcmByteSwap(aesEncryptBlock(roundKeys, gcmZero()));
+    for (int i = 1; i < 4; i++) {
+        hashKeys[i] = gcmMultiply(hashKeys[i - 1], hashKeys[0]);
+    }
+
+    for (int i = 0; i < 4; i++) {
+        gcmStore(ctx->fastGcmHashKeys[i], hashKeys[i]);
+    }
+}
+
+typedef struct _FAST_GCM_MESSAGE_STATE {
+    GCM_BLOCK ivBlock;
+    GCM_BLOCK tagMask;
+    GCM_BLOCK hash;
+    uint32_t counter;
+    int offset;
+} FAST_GCM_MESSAGE_STATE, *PFAST_GCM_MESSAGE_STATE;
+
+FAST_GCM_TARGET
+static inline void loadFastGcmKeys(PPLT_CRYPTO_CONTEXT ctx, GCM_BLOCK* roundKeys, GCM_BLOCK* hashKeys) {
+    for (int i = 0; i < 11; i++) {
+        roundKeys[i] = gcmLoad(ctx->fastGcmRoundKeys[i]);
+    }
+    for (int i = 0; i < 4; i++) {
+        hashKeys[i] = gcmLoad(ctx->fastGcmHashKeys[i]);
+    }
+}
+
+FAST_GCM_TARGET
+static inline void beginFastGcmMessage(const GCM_BLOCK* roundKeys, const uint8_t* iv, PFAST_GCM_MESSAGE_STATE state) {
+    uint8_t ivBlock[16] = { 0 };
+
+    memcpy(ivBlock, iv, FAST_GCM_IV_LENGTH);
+    state->ivBlock = gcmLoad(ivBlock);
+    state->hash = gcmZero();
+    state->counter = 1;
+    state->offset = 0;
+
+    // The first counter block is used to encrypt the tag
+    state->tagMask = aesEncryptBlock(roundKeys, gcmCounterBlock(state->ivBlock, state->counter++));
+}
+
+// Processes the next 64 bytes of the message
+FAST_GCM_TARGET
+static inline void updateFastGcmMessage4Blocks(const GCM_BLOCK* roundKeys, const GCM_BLOCK* hashKeys, bool encrypt,
+                                               PFAST_GCM_MESSAGE_STATE state, const uint8_t* input, uint8_t* output) {
+    GCM_BLOCK blocks[4];
+    GCM_BLOCK data[4];
+
+    for (int i = 0; i < 4; i++) {
+        blocks[i] = gcmCounterBlock(state->ivBlock, state->counter++);
+        data[i] = gcmLoad(&input[state->offset + i * 16]);
+    }
+    aesEncrypt4Blocks(roundKeys, blocks);
+
+    for (int i = 0; i < 4; i++) {
+        blocks[i] = gcmXor(blocks[i], data[i]);
+        gcmStore(&output[state->offset + i * 16], blocks[i]);
+
+        // The hash is always computed over the ciphertext
+        data[i] = gcmByteSwap(encrypt ? blocks[i] : data[i]);
+    }
+    state->hash = gcmHash4(state->hash, hashKeys, data);
+
+    state->offset += 64;
+}
+
+// Processes the rest of the message and computes the tag
+FAST_GCM_TARGET
+static void finishFastGcmMessage(const GCM_BLOCK* roundKeys, const GCM_BLOCK* hashKeys, bool encrypt,
+                                 PFAST_GCM_MESSAGE_STATE state, const uint8_t* input, int length,
+                                 uint8_t* output, uint8_t* computedTag) {
+    uint8_t lengthBlock[16] = { 0 };
+
+    while (length - state->offset >= 64) {
+        updateFastGcmMessage4Blocks(roundKeys, hashKeys, encrypt, state, input, output);
+    }
+
+    while (state->offset < length) {
+        uint8_t partialBlock[16] = { 0 };
+        int blockLength = length - state->offset < 16 ? length - state->offset : 16;
+        GCM_BLOCK block, data;
+
+        block = aesEncryptBlock(roundKeys, gcmCounterBlock(state->ivBlock, state->counter++));
+
+        memcpy(partialBlock, &input[state->offset], blockLength);
+        data = gcmLoad(partialBlock);
+        block = gcmXor(block, data);
+        gcmStore(partialBlock, block);
+        memcpy(&output[state->offset], partialBlock, blockLength);
+
+        // Only the ciphertext bytes are hashed, so the padding must be zero
+        if (encrypt) {
+            memset(&partialBlock[blockLength], 0, sizeof(partialBlock) - blockLength);
+            data = gcmLoad(partialBlock);
+        }
+        state->hash = gcmMultiply(gcmXor(state->hash, gcmByteSwap(data)), hashKeys[0]);
+
+        state->offset += blockLength;
+    }
+
+    // The final block contains the bit lengths of the AAD (none) and the ciphertext
+    lengthBlock[11] = (uint8_t)((uint32_t)length >> 29);
+    lengthBlock[12] = (uint8_t)((uint32_t)length >> 21);
+    lengthBlock[13] = (uint8_t)((uint32_t)length >> 13);
+    lengthBlock[14] = (uint8_t)((uint32_t)length >> 5);
+    lengthBlock[15] = (uint8_t)((uint32_t)length << 3);
+    state->hash = gcmMultiply(gcmXor(state->hash, gcmByteSwap(gcmLoad(lengthBlock))), hashKeys[0]);
+
+    gcmStore(computedTag, gcmXor(gcmByteSwap(state->hash), state->tagMask));
+}
+
+// Encrypts or decrypts the data and computes the tag. The input and output may overlap exactly.
+FAST_GCM_TARGET
+static void fastGcmCrypt(PPLT_CRYPTO_CONTEXT ctx, bool encrypt, const uint8_t* iv,
+                         const uint8_t* input, int length, uint8_t* output, uint8_t* computedTag) {
+    GCM_BLOCK roundKeys[11];
+    GCM_BLOCK hashKeys[4];
+    FAST_GCM_MESSAGE_STATE state;
+
+    loadFastGcmKeys(ctx, roundKeys, hashKeys);
+    beginFastGcmMessage(roundKeys, iv, &state);
+    finishFastGcmMessage(roundKeys, hashKeys, encrypt, &state, input, length, output, computedTag);
+}
+
+// Decrypts several messages in lockstep. The GHASH of each message is a serial chain
+// of multiplications, so interleaving independent messages keeps both the AES and
+// carry-less multiply units busy.
+FAST_GCM_TARGET
+static void fastGcmDecryptInterleaved(PPLT_CRYPTO_CONTEXT ctx, PPLT_CRYPTO_MESSAGE messages, int messageCount,
+                                      uint8_t computedTags[][FAST_GCM_TAG_LENGTH]) {
+    GCM_BLOCK roundKeys[11];
+    GCM_BLOCK hashKeys[4];
+    FAST_GCM_MESSAGE_STATE states[FAST_GCM_INTERLEAVE_WIDTH];
+    int commonLength;
+
+    LC_ASSERT(messageCount <= FAST_GCM_INTERLEAVE_WIDTH);
+
+    loadFastGcmKeys(ctx, roundKeys, hashKeys);
+
+    commonLength = messages[0].inputDataLength;
+    for (int i = 0; i < messageCount; i++) {
+        beginFastGcmMessage(roundKeys, messages[i].iv, &states[i]);
+        if (messages[i].inputDataLength < commonLength) {
+            commonLength = messages[i].inputDataLength;
+        }
+    }
+
+    while (states[0].offset + 64 <= commonLength) {
+        for (int i = 0; i < messageCount; i++) {
+            updateFastGcmMessage4Blocks(roundKeys, hashKeys, false, &states[i],
+                                        messages[i].inputData, messages[i].outputData);
+        }
+    }
+
+    for (int i = 0; i < messageCount; i++) {
+        finishFastGcmMessage(roundKeys, hashKeys, false, &states[i], messages[i].inputData,
+                             messages[i].inputDataLength, messages[i].outputData, computedTags[i]);
+    }
+}
+
+// Compares the whole tag to avoid leaking timing information
+static bool fastGcmTagsMatch(const uint8_t* computedTag, const uint8_t* tag) {
+    uint8_t difference = 0;
+
+    for (int i = 0; i < FAST_GCM_TAG_LENGTH; i++) {
+        difference |= computedTag[i] ^ tag[i];
+    }
+
+    return difference == 0;
+}
+
+static bool fastGcmSelfTest(void) {
+    uint8_t key[FAST_GCM_KEY_LENGTH];
+    uint8_t ivs[FAST_GCM_INTERLEAVE_WIDTH][FAST_GCM_IV_LENGTH];
+    uint8_t plaintext[ROUND_TO_PKCS7_PADDED_LEN(FAST_GCM_SELF_TEST_MAX_LENGTH)];
+    uint8_t expected[FAST_GCM_INTERLEAVE_WIDTH][ROUND_TO_PKCS7_PADDED_LEN(FAST_GCM_SELF_TEST_MAX_LENGTH)];
+    uint8_t actual[FAST_GCM_INTERLEAVE_WIDTH][FAST_GCM_SELF_TEST_MAX_LENGTH];
+    uint8_t expectedTags[FAST_GCM_INTERLEAVE_WIDTH][FAST_GCM_TAG_LENGTH];
+    uint8_t actualTags[FAST_GCM_INTERLEAVE_WIDTH][FAST_GCM_TAG_LENGTH];
+    PLT_CRYPTO_MESSAGE messages[FAST_GCM_INTERLEAVE_WIDTH];
+    PPLT_CRYPTO_CONTEXT ctx;
+    bool ret = true;
+
+    for (int i = 0; i < (int)sizeof(key); i++) {
+        key[i] = (uint8_t)(i * 17 + 3);
+    }
+    for (int i = 0; i < FAST_GCM_INTERLEAVE_WIDTH; i++) {
+        for (int j = 0; j < FAST_GCM_IV_LENGTH; j++) {
+            ivs[i][j] = (uint8_t)(j * 29 + i * 5 + 7);
+        }
+    }
+    for (int i = 0; i < FAST_GCM_SELF_TEST_MAX_LENGTH; i++) {
+        plaintext[i] = (uint8_t)(i * 13 + 11);
+    }
+
+    ctx = PltCreateCryptoContext();
+    if (ctx == NULL) {
+        return false;
+    }
+
+    // Encrypt using the crypto library as a reference
+    ctx->fastGcmState = FAST_GCM_STATE_UNAVAILABLE;
+    for (int i = 0; i < FAST_GCM_INTERLEAVE_WIDTH; i++) {
+        int expectedLength;
+
+        if (!PltEncryptMessage(ctx, ALGORITHM_AES_GCM, 0, key, sizeof(key), ivs[i], FAST_GCM_IV_LENGTH,
+                               expectedTags[i], FAST_GCM_TAG_LENGTH, plaintext, fastGcmSelfTestLengths[i],
+                               expected[i], &expectedLength) || expectedLength != fastGcmSelfTestLengths[i]) {
+            PltDestroyCryptoContext(ctx);
+            return false;
+        }
+    }
+
+    initializeFastGcmKeys(ctx, key);
+
+    // Check both directions against the reference
+    for (int i = 0; i < FAST_GCM_INTERLEAVE_WIDTH; i++) {
+        int length = fastGcmSelfTestLengths[i];
+
+        fastGcmCrypt(ctx, true, ivs[i], plaintext, length, actual[i], actualTags[i]);
+        ret = ret && memcmp(actual[i], expected[i], length) == 0 &&
+              fastGcmTagsMatch(actualTags[i], expectedTags[i]);
+
+        fastGcmCrypt(ctx, false, ivs[i], expected[i], length, actual[i], actualTags[i]);
+        ret = ret && memcmp(actual[i], plaintext, length) == 0 &&
+              fastGcmTagsMatch(actualTags[i], expectedTags[i]);
+    }
+
+    // Check the batch path with messages of different lengths in lockstep
+    for (int i = 0; i < FAST_GCM_INTERLEAVE_WIDTH; i++) {
+        messages[i].iv = ivs[i];
+        messages[i].tag = expectedTags[i];
+        messages[i].inputData = expected[i];
+        messages[i].inputDataLength = fastGcmSelfTestLengths[i];
+        messages[i].outputData = actual[i];
+    }
+    memset(actual, 0, sizeof(actual));
+    fastGcmDecryptInterleaved(ctx, messages, FAST_GCM_INTERLEAVE_WIDTH, actualTags);
+    for (int i = 0; i < FAST_GCM_INTERLEAVE_WIDTH; i++) {
+        ret = ret && memcmp(actual[i], plaintext, fastGcmSelfTestLengths[i]) == 0 &&
+              fastGcmTagsMatch(actualTags[i], expectedTags[i]);
+    }
+
+    // A corrupted tag must be rejected, whichever byte is wrong
+    for (int i = 0; i < FAST_GCM_TAG_LENGTH; i++) {
+        expectedTags[0][i] ^= 0x01;
+        ret = ret && !fastGcmTagsMatch(actualTags[0], expectedTags[0]);
+        expectedTags[0][i] ^= 0x01;
+    }
+
+    // So must corrupted ciphertext
+    expected[1][0] ^= 0x80;
+    fastGcmCrypt(ctx, false, ivs[1], expected[1], fastGcmSelfTestLengths[1], actual[1], actualTags[1]);
+    ret = ret && !fastGcmTagsMatch(actualTags[1], expectedTags[1]);
+
+    PltDestroyCryptoContext(ctx);
+    return ret;
+}
+
+static bool isFastGcmAvailable(void) {
+    static volatile uint32_t fastGcmAvailability = FAST_GCM_STATE_UNINITIALIZED;
+    uint32_t availability = PltAtomicLoad32(&fastGcmAvailability);
+
+    // Concurrent first uses will reach the same result, so this doesn't need a lock
+    if (availability == FAST_GCM_STATE_UNINITIALIZED) {
+        if (!cpuSupportsFastGcm()) {
+            availability = FAST_GCM_STATE_UNAVAILABLE;
+        }
+        else if (!fastGcmSelfTest()) {
+            Limelog("Built-in AES-GCM implementation failed self-test!\n");
+            LC_ASSERT(false);
+            availability = FAST_GCM_STATE_UNAVAILABLE;
+        }
+        else {
+            availability = FAST_GCM_STATE_ACTIVE;
+        }
+
+        PltAtomicStore32(&fastGcmAvailability, availability);
+    }
+
+    return availability == FAST_GCM_STATE_ACTIVE;
+}
+
+static bool useFastGcm(PPLT_CRYPTO_CONTEXT ctx, unsigned char* key, int keyLength, int ivLength, int tagLength) {
+    if (ctx->fastGcmState == FAST_GCM_STATE_UNINITIALIZED) {
+        if (keyLength == FAST_GCM_KEY_LENGTH && isFastGcmAvailable()) {
+            initializeFastGcmKeys(ctx, key);
+            ctx->fastGcmState = FAST_GCM_STATE_ACTIVE;
+        }
+        else {
+            ctx->fastGcmState = FAST_GCM_STATE_UNAVAILABLE;
+        }
+    }
+
+    // Other IV and tag lengths are handled by the crypto library
+    return ctx->fastGcmState == FAST_GCM_STATE_ACTIVE &&
+           ivLength == FAST_GCM_IV_LENGTH && tagLength == FAST_GCM_TAG_LENGTH;
+}
+#endif
+
+// Only time 1 out of every N operations of each type to keep the overhead low
+#define CRYPTO_STATS_SAMPLE_INTERVAL 16
+
+// Each bucket is only updated by the thread using the context of that type, so
+// a sequence counter per bucket is enough for readers to take a consistent copy.
+typedef struct _CRYPTO_OPERATION_STATS_ENTRY {
+    volatile uint32_t sequence;
+    CRYPTO_OPERATION_STATS stats;
+} CRYPTO_OPERATION_STATS_ENTRY, *PCRYPTO_OPERATION_STATS_ENTRY;
+
+static const char* cryptoBackend;
+static bool builtInAesGcm;
+static CRYPTO_OPERATION_STATS_ENTRY videoDecryptStats;
+static CRYPTO_OPERATION_STATS_ENTRY audioDecryptStats;
+static CRYPTO_OPERATION_STATS_ENTRY controlEncryptStats;
+static CRYPTO_OPERATION_STATS_ENTRY controlDecryptStats;
+static CRYPTO_OPERATION_STATS_ENTRY inputEncryptStats;
+
+// Returns the statistics for this type of context or NULL if it's not tracked
+static PCRYPTO_OPERATION_STATS_ENTRY getCryptoOperationStats(PPLT_CRYPTO_CONTEXT ctx, bool encrypt) {
+    switch (ctx->statsType) {
+    case CRYPTO_STATS_TYPE_VIDEO:
+        return encrypt ? NULL : &videoDecryptStats;
+    case CRYPTO_STATS_TYPE_AUDIO:
+        return encrypt ? NULL : &audioDecryptStats;
+    case CRYPTO_STATS_TYPE_CONTROL:
+        return encrypt ? &controlEncryptStats : &controlDecryptStats;
+    case CRYPTO_STATS_TYPE_INPUT:
+        return encrypt ? &inputEncryptStats : NULL;
+    default:
+        return NULL;
+    }
+}
+
+// Returns the statistics to update if this operation should be timed
+static PCRYPTO_OPERATION_STATS_ENTRY sampleCryptoOperation(PPLT_CRYPTO_CONTEXT ctx, bool encrypt) {
+    PCRYPTO_OPERATION_STATS_ENTRY entry = getCryptoOperationStats(ctx, encrypt);
+
+    if (entry == NULL || ctx->statsOperationCount++ % CRYPTO_STATS_SAMPLE_INTERVAL != 0) {
+        return NULL;
+    }
+
+    return entry;
+}
+
+// A single packet takes well under a microsecond to encrypt or decrypt on most
+// hardware, so these are timed with the nanosecond clock.
+static void recordCryptoOperation(PCRYPTO_OPERATION_STATS_ENTRY entry, uint64_t startTimeNs, int messages, int bytes) {
+    uint64_t elapsedTimeNs = PltGetNanoseconds() - startTimeNs;
+
+    PltAtomicAdd32(&entry->sequence, 1);
+    entry->stats.sampledMessages += messages;
+    entry->stats.sampledBytes += bytes;
+    entry->stats.sampledTimeNs += elapsedTimeNs;
+    PltAtomicAdd32(&entry->sequence, 1);
+}
+
+static void readCryptoOperationStats(PCRYPTO_OPERATION_STATS_ENTRY entry, PCRYPTO_OPERATION_STATS stats) {
+    uint32_t sequence;
+
+    do {
+        sequence = PltAtomicLoad32(&entry->sequence);
+        if (sequence & 1) {
+            PltCpuRelax();
+            continue;
+        }
+
+        *stats = entry->stats;
+    } while ((sequence & 1) || PltAtomicLoad32(&entry->sequence) != sequence);
+}
+
+void PltResetCryptoStats(void) {
+    memset(&videoDecryptStats, 0, sizeof(videoDecryptStats));
+    memset(&audioDecryptStats, 0, sizeof(audioDecryptStats));
+    memset(&controlEncryptStats, 0, sizeof(controlEncryptStats));
+    memset(&controlDecryptStats, 0, sizeof(controlDecryptStats));
+    memset(&inputEncryptStats, 0, sizeof(inputEncryptStats));
+
+#ifdef FAST_GCM_SUPPORTED
+    // This runs the self-test now rather than on the first packet of the stream
+    builtInAesGcm = isFastGcmAvailable();
+#endif
+
+#ifdef USE_PSA_CRYPTO
+    cryptoBackend = "PSA Crypto";
+#else
+    cryptoBackend = "OpenSSL";
+#endif
+}
+
+bool LiGetCryptoStats(PCRYPTO_STATS stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    // Nothing has been set up before the first connection
+    if (cryptoBackend == NULL) {
+        return false;
+    }
+
+    stats->backend = cryptoBackend;
+    stats->builtInAesGcm = builtInAesGcm;
+    readCryptoOperationStats(&videoDecryptStats, &stats->videoDecrypt);
+    readCryptoOperationStats(&audioDecryptStats, &stats->audioDecrypt);
+    readCryptoOperationStats(&controlEncryptStats, &stats->controlEncrypt);
+    readCryptoOperationStats(&controlDecryptStats, &stats->controlDecrypt);
+    readCryptoOperationStats(&inputEncryptStats, &stats->inputEncrypt);
+    return true;
+}
+
+static bool encryptMessage(PPLT_CRYPTO_CONTEXT ctx, int algorithm, int flags,
+                           unsigned char* key, int keyLength,
+                           unsigned char* iv, int ivLength,
+                           unsigned char* tag, int tagLength,
+                           unsigned char* inputData, int inputDataLength,
+                           unsigned char* outputData, int* outputDataLength) {
+#ifdef FAST_GCM_SUPPORTED
+    if (algorithm == ALGORITHM_AES_GCM && useFastGcm(ctx, key, keyLength, ivLength, tagLength)) {
+        fastGcmCrypt(ctx, true, iv, inputData, inputDataLength, outputData, tag);
+        *outputDataLength = inputDataLength;
+        return true;
+    }
+#endif
+
 #ifdef USE_PSA_CRYPTO
     if (algorithm == ALGORITHM_AES_GCM) {
         LC_ASSERT(tag != NULL);
@@ -264,20 +932,22 @@ bool PltEncryptMessage(PPLT_CRYPTO_CONTEXT ctx, int algorithm, int flags,
 #endif
 }
 
-// When CBC is used, outputData buffer must be allocated such that the buffer length is
-// at least ROUND_TO_PKCS7_PADDED_LEN(inputDataLength) to allow room for PKCS7 padding.
-//
-// For GCM, the IV can change from message to message without CIPHER_FLAG_RESET_IV.
-// CIPHER_FLAG_RESET_IV is only required for GCM when the IV length changes.
-//
-// Changing the key between encrypt/decrypt calls on a single context is not supported.
-// Using the same crypto context for both encryption and decryption is not supported.
-bool PltDecryptMessage(PPLT_CRYPTO_CONTEXT ctx, int algorithm, int flags,
-                       unsigned char* key, int keyLength,
-                       unsigned char* iv, int ivLength,
-                       unsigned char* tag, int tagLength,
-                       unsigned char* inputData, int inputDataLength,
-                       unsigned char* outputData, int* outputDataLength) {
+static bool decryptMessage(PPLT_CRYPTO_CONTEXT ctx, int algorithm, int flags,
+                           unsigned char* key, int keyLength,
+                           unsigned char* iv, int ivLength,
+                           unsigned char* tag, int tagLength,
+                           unsigned char* inputData, int inputDataLength,
+                           unsigned char* outputData, int* outputDataLength) {
+#ifdef FAST_GCM_SUPPORTED
+    if (algorithm == ALGORITHM_AES_GCM && useFastGcm(ctx, key, keyLength, ivLength, tagLength)) {
+        uint8_t computedTag[FAST_GCM_TAG_LENGTH];
+
+        fastGcmCrypt(ctx, false, iv, inputData, inputDataLength, outputData, computedTag);
+        *outputDataLength = inputDataLength;
+        return fastGcmTagsMatch(computedTag, tag);
+    }
+#endif
+
 #ifdef USE_PSA_CRYPTO
     if (algorithm == ALGORITHM_AES_GCM) {
         LC_ASSERT(tag != NULL);
@@ -492,6 +1162,130 @@ bool PltDecryptMessage(PPLT_CRYPTO_CONTEXT ctx, int algorithm, int flags,
 #endif
 }
 
+// When CIPHER_FLAG_PAD_TO_BLOCK_SIZE is used, inputData buffer must be allocated such that
+// the buffer length is at least ROUND_TO_PKCS7_PADDED_LEN(inputDataLength) and inputData
+// buffer may be modified! If CIPHER_FLAG_PAD_TO_BLOCK_SIZE is used, it must be passed to
+// all invocations of PltEncryptMessage() on the same crypto context (mixing padded and
+// non-padded encryption is not allowed).
+//
+// CIPHER_FLAG_PAD_TO_BLOCK_SIZE and CIPHER_FLAG_FINISH may not be used on the same context.
+//
+// When CIPHER_FLAG_FINISH is used with CBC encryption, the output buffer size must be at
+// least ROUND_TO_PKCS7_PADDED_LEN(inputDataLength).
+//
+// For GCM, the IV can change from message to message without CIPHER_FLAG_RESET_IV.
+// CIPHER_FLAG_RESET_IV is only required for GCM when the IV length changes.
+//
+// Changing the key between encrypt/decrypt calls on a single context is not supported.
+// Using the same crypto context for both encryption and decryption is not supported.
+bool PltEncryptMessage(PPLT_CRYPTO_CONTEXT ctx, int algorithm, int flags,
+                       unsigned char* key, int keyLength,
+                       unsigned char* iv, int ivLength,
+                       unsigned char* tag, int tagLength,
+                       unsigned char* inputData, int inputDataLength,
+                       unsigned char* outputData, int* outputDataLength) {
+    PCRYPTO_OPERATION_STATS_ENTRY stats = sampleCryptoOperation(ctx, true);
+    uint64_t startTimeNs = stats != NULL ? PltGetNanoseconds() : 0;
+    bool ret;
+
+    ret = encryptMessage(ctx, algorithm, flags, key, keyLength, iv, ivLength, tag, tagLength,
+                         inputData, inputDataLength, outputData, outputDataLength);
+
+    if (stats != NULL) {
+        recordCryptoOperation(stats, startTimeNs, 1, inputDataLength);
+    }
+
+    return ret;
+}
+
+// When CBC is used, outputData buffer must be allocated such that the buffer length is
+// at least ROUND_TO_PKCS7_PADDED_LEN(inputDataLength) to allow room for PKCS7 padding.
+//
+// For GCM, the IV can change from message to message without CIPHER_FLAG_RESET_IV.
+// CIPHER_FLAG_RESET_IV is only required for GCM when the IV length changes.
+//
+// Changing the key between encrypt/decrypt calls on a single context is not supported.
+// Using the same crypto context for both encryption and decryption is not supported.
+bool PltDecryptMessage(PPLT_CRYPTO_CONTEXT ctx, int algorithm, int flags,
+                       unsigned char* key, int keyLength,
+                       unsigned char* iv, int ivLength,
+                       unsigned char* tag, int tagLength,
+                       unsigned char* inputData, int inputDataLength,
+                       unsigned char* outputData, int* outputDataLength) {
+    PCRYPTO_OPERATION_STATS_ENTRY stats = sampleCryptoOperation(ctx, false);
+    uint64_t startTimeNs = stats != NULL ? PltGetNanoseconds() : 0;
+    bool ret;
+
+    ret = decryptMessage(ctx, algorithm, flags, key, keyLength, iv, ivLength, tag, tagLength,
+                         inputData, inputDataLength, outputData, outputDataLength);
+
+    if (stats != NULL) {
+        recordCryptoOperation(stats, startTimeNs, 1, inputDataLength);
+    }
+
+    return ret;
+}
+
+// Decrypts several independent messages that share the same key, IV length, and tag length.
+// The outputDataLength and success fields of each message are set, and the number of
+// messages that were decrypted successfully is returned. Only AES-GCM is supported.
+//
+// When the built-in AES-GCM implementation is available, messages are decrypted in
+// interleaved groups. Otherwise, this is equivalent to calling PltDecryptMessage()
+// for each message. A batch counts as a single operation for sampling statistics.
+int PltDecryptMessageBatch(PPLT_CRYPTO_CONTEXT ctx, int algorithm, int flags,
+                           unsigned char* key, int keyLength,
+                           int ivLength, int tagLength,
+                           PPLT_CRYPTO_MESSAGE messages, int messageCount) {
+    PCRYPTO_OPERATION_STATS_ENTRY stats = sampleCryptoOperation(ctx, false);
+    uint64_t startTimeNs = stats != NULL ? PltGetNanoseconds() : 0;
+    int successCount = 0;
+    int i = 0;
+
+    LC_ASSERT(algorithm == ALGORITHM_AES_GCM);
+
+#ifdef FAST_GCM_SUPPORTED
+    if (useFastGcm(ctx, key, keyLength, ivLength, tagLength)) {
+        uint8_t computedTags[FAST_GCM_INTERLEAVE_WIDTH][FAST_GCM_TAG_LENGTH];
+
+        for (; i + FAST_GCM_INTERLEAVE_WIDTH <= messageCount; i += FAST_GCM_INTERLEAVE_WIDTH) {
+            fastGcmDecryptInterleaved(ctx, &messages[i], FAST_GCM_INTERLEAVE_WIDTH, computedTags);
+
+            for (int j = 0; j < FAST_GCM_INTERLEAVE_WIDTH; j++) {
+                messages[i + j].outputDataLength = messages[i + j].inputDataLength;
+                messages[i + j].success = fastGcmTagsMatch(computedTags[j], messages[i + j].tag);
+                if (messages[i + j].success) {
+                    successCount++;
+                }
+            }
+        }
+    }
+#endif
+
+    // Decrypt the remaining messages individually
+    for (; i < messageCount; i++) {
+        messages[i].success = decryptMessage(ctx, algorithm, flags, key, keyLength,
+                                             messages[i].iv, ivLength,
+                                             messages[i].tag, tagLength,
+                                             messages[i].inputData, messages[i].inputDataLength,
+                                             messages[i].outputData, &messages[i].outputDataLength);
+        if (messages[i].success) {
+            successCount++;
+        }
+    }
+
+    if (stats != NULL) {
+        int totalLength = 0;
+
+        for (i = 0; i < messageCount; i++) {
+            totalLength += messages[i].inputDataLength;
+        }
+        recordCryptoOperation(stats, startTimeNs, messageCount, totalLength);
+    }
+
+    return successCount;
+}
+
 PPLT_CRYPTO_CONTEXT PltCreateCryptoContext(void) {
     PPLT_CRYPTO_CONTEXT ctx = malloc(sizeof(*ctx));
     if (!ctx) {
@@ -499,6 +1293,9 @@ PPLT_CRYPTO_CONTEXT PltCreateCryptoContext(void) {
     }
 
     ctx->initialized = false;
+    ctx->fastGcmState = FAST_GCM_STATE_UNINITIALIZED;
+    ctx->statsType = CRYPTO_STATS_TYPE_NONE;
+    ctx->statsOperationCount = 0;
 
 #ifdef USE_PSA_CRYPTO
     ctx->key = PSA_KEY_ID_NULL;
@@ -515,6 +1312,14 @@ PPLT_CRYPTO_CONTEXT PltCreateCryptoContext(void) {
     return ctx;
 }
 
+void PltSetCryptoContextStatsType(PPLT_CRYPTO_CONTEXT ctx, int statsType) {
+    LC_ASSERT(statsType >= CRYPTO_STATS_TYPE_NONE && statsType <= CRYPTO_STATS_TYPE_INPUT);
+
+    if (ctx != NULL) {
+        ctx->statsType = statsType;
+    }
+}
+
 void PltDestroyCryptoContext(PPLT_CRYPTO_CONTEXT ctx) {
     if (!ctx) {
         return;
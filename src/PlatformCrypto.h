@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 
 // Retain backwards compatibility with older USE_MBEDTLS
 #if defined(USE_MBEDTLS) && !defined(USE_PSA_CRYPTO)
@@ -24,6 +25,20 @@ typedef struct _PLT_CRYPTO_CONTEXT {
     EVP_CIPHER_CTX* ctx;
     bool initialized;
 #endif
+
+    // State for the built-in AES-128-GCM implementation used on CPUs with AES and
+    // carry-less multiply instructions. The hash keys are H^1 to H^4 in the byte
+    // order used by the GHASH implementation.
+    int fastGcmState;
+
+    // Determines which operation statistics this context contributes to. The
+    // sample counter is per-context, since a context is only used by one thread
+    // at a time and each statistics type is only updated through one context.
+    int statsType;
+    uint32_t statsOperationCount;
+
+    uint8_t fastGcmRoundKeys[11][16];
+    uint8_t fastGcmHashKeys[4][16];
 } PLT_CRYPTO_CONTEXT, *PPLT_CRYPTO_CONTEXT;
 
 #define ROUND_TO_PKCS7_PADDED_LEN(x) ((((x) + 15) / 16) * 16)
@@ -31,6 +46,14 @@ typedef struct _PLT_CRYPTO_CONTEXT {
 PPLT_CRYPTO_CONTEXT PltCreateCryptoContext(void);
 void PltDestroyCryptoContext(PPLT_CRYPTO_CONTEXT ctx);
 
+#define CRYPTO_STATS_TYPE_NONE    0
+#define CRYPTO_STATS_TYPE_VIDEO   1
+#define CRYPTO_STATS_TYPE_AUDIO   2
+#define CRYPTO_STATS_TYPE_CONTROL 3
+#define CRYPTO_STATS_TYPE_INPUT   4
+void PltSetCryptoContextStatsType(PPLT_CRYPTO_CONTEXT ctx, int statsType);
+void PltResetCryptoStats(void);
+
 #define ALGORITHM_AES_CBC 1
 #define ALGORITHM_AES_GCM 2
 
@@ -52,4 +75,21 @@ bool PltDecryptMessage(PPLT_CRYPTO_CONTEXT ctx, int algorithm, int flags,
                        unsigned char* inputData, int inputDataLength,
                        unsigned char* outputData, int* outputDataLength);
 
+typedef struct _PLT_CRYPTO_MESSAGE {
+    unsigned char* iv;
+    unsigned char* tag;
+    unsigned char* inputData;
+    int inputDataLength;
+    unsigned char* outputData;
+
+    // Set by PltDecryptMessageBatch()
+    int outputDataLength;
+    bool success;
+} PLT_CRYPTO_MESSAGE, *PPLT_CRYPTO_MESSAGE;
+
+int PltDecryptMessageBatch(PPLT_CRYPTO_CONTEXT ctx, int algorithm, int flags,
+                           unsigned char* key, int keyLength,
+                           int ivLength, int tagLength,
+                           PPLT_CRYPTO_MESSAGE messages, int messageCount);
+
 void PltGenerateRandomData(unsigned char* data, int length);
@@ -231,6 +231,32 @@ int recvUdpSocket(SOCKET s, char* buffer, int size, bool useSelect) {
     return err;
 }
 
+// Receives a packet only if one is already waiting, returning 0 if not. This is
+// used to drain bursts of packets after a blocking recvUdpSocket() call.
+int recvUdpSocketIfReady(SOCKET s, char* buffer, int size) {
+#ifdef MSG_DONTWAIT
+    int err;
+
+    do {
+        err = (int)recvfrom(s, buffer, size, MSG_DONTWAIT, NULL, NULL);
+        if (err < 0 &&
+                (LastSocketError() == EWOULDBLOCK ||
+                 LastSocketError() == EINTR ||
+                 LastSocketError() == EAGAIN)) {
+            return 0;
+        }
+
+    // Ignore errors from previous ICMP Port Unreachable messages like recvUdpSocket()
+    } while (err < 0 && LastSocketError() == ECONNREFUSED);
+
+    return err;
+#else
+    // Checking readability first would cost an extra syscall per packet,
+    // so callers just process one packet at a time on these platforms.
+    return 0;
+#endif
+}
+
 void closeSocket(SOCKET s) {
 #if defined(LC_WINDOWS) && !defined(NXDK)
     closesocket(s);
@@ -448,6 +474,40 @@ SOCKET createSocket(int addressFamily, int socketType, int protocol, bool nonBlo
     return s;
 }
 
+// Creates a non-blocking UDP socket on the loopback interface that is connected to itself.
+// Sending a datagram on it wakes up another thread that is polling the socket.
+SOCKET createLoopbackWakeSocket(void) {
+    struct sockaddr_in addr;
+    SOCKADDR_LEN addrLen;
+    SOCKET s;
+
+    s = createSocket(AF_INET, SOCK_DGRAM, IPPROTO_UDP, true);
+    if (s == INVALID_SOCKET) {
+        return INVALID_SOCKET;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+#ifdef __3DS__
+    // binding to wildcard port is broken on the 3DS, so we need to define a port manually
+    addr.sin_port = htons(n3ds_udp_port++);
+#endif
+
+    addrLen = sizeof(addr);
+    if (bind(s, (struct sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+        getsockname(s, (struct sockaddr*)&addr, &addrLen) == SOCKET_ERROR ||
+        connect(s, (struct sockaddr*)&addr, addrLen) == SOCKET_ERROR) {
+        int err = LastSocketError();
+        Limelog("Failed to create loopback wake socket: %d\n", err);
+        closeSocket(s);
+        SetLastSocketError(err);
+        return INVALID_SOCKET;
+    }
+
+    return s;
+}
+
 SOCKET connectTcpSocket(struct sockaddr_storage* dstaddr, SOCKADDR_LEN addrlen, unsigned short port, int timeoutSec) {
     SOCKET s;
     LC_SOCKADDR addr;
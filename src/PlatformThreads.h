@@ -67,7 +67,10 @@ void PltWaitForEvent(PLT_EVENT* event);
 int PltCreateConditionVariable(PLT_COND* cond, PLT_MUTEX* mutex);
 void PltDeleteConditionVariable(PLT_COND* cond);
 void PltSignalConditionVariable(PLT_COND* cond);
+void PltBroadcastConditionVariable(PLT_COND* cond);
 void PltWaitForConditionVariable(PLT_COND* cond, PLT_MUTEX* mutex);
+bool PltWaitForConditionVariableTimeout(PLT_COND* cond, PLT_MUTEX* mutex, uint32_t timeoutMs);
 
 void PltSleepMs(int ms);
+void PltSleepUs(uint64_t us);
 void PltSleepMsInterruptible(PLT_THREAD* thread, int ms);
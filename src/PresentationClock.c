@@ -0,0 +1,177 @@
+#include "Limelight-internal.h"
+
+// The minimum transit time is tracked over two windows of this length, so
+// the mapping follows clock drift and route changes within a few seconds.
+#define PC_WINDOW_US 2000000
+
+// Jitter allowance covers this percentile of transit times above the minimum
+#define PC_JITTER_PERCENTILE 95
+
+// Ignore samples that are further than this from the minimum transit time,
+// since they are from a discontinuity rather than network jitter
+#define PC_MAX_TRANSIT_EXCESS_US 1000000
+
+typedef struct _PRESENTATION_CLOCK_STREAM {
+    // Only touched by the thread providing samples for this stream
+    int64_t windowMinOffsetUs;
+    int64_t previousWindowMinOffsetUs;
+    uint64_t windowStartUs;
+    bool previousWindowValid;
+    LATENCY_HISTOGRAM excessHistogram;
+
+    // Published to readers under the sequence lock. The sequence
+    // is odd while the writer is updating these values.
+    volatile uint32_t sequence;
+    int64_t offsetUs;
+    uint32_t jitterAllowanceUs;
+    uint64_t lastHostTimeUs;
+    bool valid;
+} PRESENTATION_CLOCK_STREAM, *PPRESENTATION_CLOCK_STREAM;
+
+static PRESENTATION_CLOCK_STREAM clockStreams[PRESENTATION_CLOCK_STREAM_COUNT];
+
+typedef struct _PRESENTATION_CLOCK_SNAPSHOT {
+    int64_t offsetUs;
+    uint32_t jitterAllowanceUs;
+    uint64_t lastHostTimeUs;
+    bool valid;
+} PRESENTATION_CLOCK_SNAPSHOT, *PPRESENTATION_CLOCK_SNAPSHOT;
+
+static void publishClockStream(PPRESENTATION_CLOCK_STREAM stream, uint64_t hostTimeUs) {
+    int64_t offsetUs = stream->windowMinOffsetUs;
+
+    if (stream->previousWindowValid && stream->previousWindowMinOffsetUs < offsetUs) {
+        offsetUs = stream->previousWindowMinOffsetUs;
+    }
+
+    PltAtomicAdd32(&stream->sequence, 1);
+    stream->offsetUs = offsetUs;
+    stream->lastHostTimeUs = hostTimeUs;
+    stream->valid = true;
+    PltAtomicAdd32(&stream->sequence, 1);
+}
+
+static void readClockStream(PPRESENTATION_CLOCK_STREAM stream, PPRESENTATION_CLOCK_SNAPSHOT snapshot) {
+    uint32_t sequence;
+
+    for (;;) {
+        sequence = PltAtomicLoad32(&stream->sequence);
+        if (sequence & 1) {
+            PltCpuRelax();
+            continue;
+        }
+
+        snapshot->offsetUs = stream->offsetUs;
+        snapshot->jitterAllowanceUs = stream->jitterAllowanceUs;
+        snapshot->lastHostTimeUs = stream->lastHostTimeUs;
+        snapshot->valid = stream->valid;
+
+        if (PltAtomicLoad32(&stream->sequence) == sequence) {
+            break;
+        }
+    }
+}
+
+void resetPresentationClock(int streamIndex) {
+    PPRESENTATION_CLOCK_STREAM stream = &clockStreams[streamIndex];
+
+    LC_ASSERT(streamIndex >= 0 && streamIndex < PRESENTATION_CLOCK_STREAM_COUNT);
+
+    PltAtomicAdd32(&stream->sequence, 1);
+    stream->offsetUs = 0;
+    stream->jitterAllowanceUs = 0;
+    stream->lastHostTimeUs = 0;
+    stream->valid = false;
+    PltAtomicAdd32(&stream->sequence, 1);
+
+    stream->windowStartUs = 0;
+    stream->previousWindowValid = false;
+    LhInitializeHistogram(&stream->excessHistogram);
+}
+
+// Adds a sample relating the host time of some data to the local time it became available.
+// Each stream must only be updated by a single thread.
+void addPresentationClockSample(int streamIndex, uint64_t hostTimeUs, uint64_t localTimeUs) {
+    PPRESENTATION_CLOCK_STREAM stream = &clockStreams[streamIndex];
+    int64_t offsetUs = (int64_t)localTimeUs - (int64_t)hostTimeUs;
+
+    LC_ASSERT(streamIndex >= 0 && streamIndex < PRESENTATION_CLOCK_STREAM_COUNT);
+
+    if (stream->windowStartUs == 0) {
+        stream->windowStartUs = localTimeUs;
+        stream->windowMinOffsetUs = offsetUs;
+        publishClockStream(stream, hostTimeUs);
+        return;
+    }
+
+    if (offsetUs < stream->windowMinOffsetUs) {
+        stream->windowMinOffsetUs = offsetUs;
+    }
+
+    // The jitter allowance is measured from the published minimum, since that
+    // is what will be used to map the data onto our clock.
+    int64_t excessUs = offsetUs - stream->offsetUs;
+    if (excessUs >= 0 && excessUs < PC_MAX_TRANSIT_EXCESS_US) {
+        LhAddSample(&stream->excessHistogram, (uint64_t)excessUs);
+    }
+
+    if (localTimeUs - stream->windowStartUs >= PC_WINDOW_US) {
+        uint32_t jitterAllowanceUs = LhGetPercentile(&stream->excessHistogram, PC_JITTER_PERCENTILE);
+
+        stream->previousWindowMinOffsetUs = stream->windowMinOffsetUs;
+        stream->previousWindowValid = true;
+        stream->windowStartUs = localTimeUs;
+        stream->windowMinOffsetUs = offsetUs;
+        LhInitializeHistogram(&stream->excessHistogram);
+
+        PltAtomicAdd32(&stream->sequence, 1);
+        stream->jitterAllowanceUs = jitterAllowanceUs;
+        PltAtomicAdd32(&stream->sequence, 1);
+
+        publishClockStream(stream, hostTimeUs);
+    }
+    else if (stream->windowMinOffsetUs < stream->offsetUs) {
+        // Publish a new minimum immediately
+        publishClockStream(stream, hostTimeUs);
+    }
+    else {
+        // Keep the latest host time current for audio timestamp extension
+        PltAtomicAdd32(&stream->sequence, 1);
+        stream->lastHostTimeUs = hostTimeUs;
+        PltAtomicAdd32(&stream->sequence, 1);
+    }
+}
+
+// The audio and video timestamps from the host have unrelated epochs, so each stream
+// is mapped independently. Their minimum transit offsets can't be compared to align them.
+static bool getPresentationTime(int streamIndex, uint64_t hostTimeUs, uint64_t* localTimeUs) {
+    PRESENTATION_CLOCK_SNAPSHOT snapshot;
+
+    readClockStream(&clockStreams[streamIndex], &snapshot);
+    if (!snapshot.valid) {
+        return false;
+    }
+
+    *localTimeUs = (uint64_t)((int64_t)hostTimeUs + snapshot.offsetUs) + snapshot.jitterAllowanceUs;
+    return true;
+}
+
+bool LiGetAudioPresentationTime(uint32_t rtpTimestamp, uint64_t* localTimeUs) {
+    PRESENTATION_CLOCK_SNAPSHOT snapshot;
+    uint64_t lastHostTimeMs;
+
+    // Extend the 32-bit millisecond timestamp using the most recent audio packet
+    readClockStream(&clockStreams[PRESENTATION_CLOCK_AUDIO], &snapshot);
+    if (!snapshot.valid) {
+        return false;
+    }
+    lastHostTimeMs = snapshot.lastHostTimeUs / 1000;
+
+    return getPresentationTime(PRESENTATION_CLOCK_AUDIO,
+                               (lastHostTimeMs + (int32_t)(rtpTimestamp - (uint32_t)lastHostTimeMs)) * 1000,
+                               localTimeUs);
+}
+
+bool LiGetVideoPresentationTime(PDECODE_UNIT decodeUnit, uint64_t* localTimeUs) {
+    return getPresentationTime(PRESENTATION_CLOCK_VIDEO, decodeUnit->presentationTimeUs, localTimeUs);
+}
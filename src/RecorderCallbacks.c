@@ -87,6 +87,19 @@ static void recArDecodeAndPlaySample(char* sampleData, int sampleLength)
     realArCallbacks.decodeAndPlaySample(sampleData, sampleLength);
 }
 
+static void recArDecodeAndPlaySamples(PAUDIO_SAMPLE_ENTRY samples, int sampleCount)
+{
+    if (audioFile != NULL) {
+        for (int i = 0; i < sampleCount; i++) {
+            if (samples[i].sampleData != NULL) {
+                fwrite(samples[i].sampleData, 1, samples[i].sampleLength, audioFile);
+            }
+        }
+    }
+
+    realArCallbacks.decodeAndPlaySamples(samples, sampleCount);
+}
+
 void setRecorderCallbacks(PDECODER_RENDERER_CALLBACKS drCallbacks, PAUDIO_RENDERER_CALLBACKS arCallbacks)
 {
     realDrCallbacks = *drCallbacks;
@@ -99,4 +112,7 @@ void setRecorderCallbacks(PDECODER_RENDERER_CALLBACKS drCallbacks, PAUDIO_RENDER
     arCallbacks->init = recArInit;
     arCallbacks->cleanup = recArCleanup;
     arCallbacks->decodeAndPlaySample = recArDecodeAndPlaySample;
+    if (arCallbacks->decodeAndPlaySamples != NULL) {
+        arCallbacks->decodeAndPlaySamples = recArDecodeAndPlaySamples;
+    }
 }
@@ -0,0 +1,490 @@
+#include "Limelight-internal.h"
+
+// Number of recovery decisions kept for LiGetRecoveryEvents()
+#define RECOVERY_EVENT_HISTORY 64
+
+// The host only keeps this many frames of reference history, so an RFI
+// request for a longer range can't be satisfied with a P-frame.
+#define RECOVERY_MAX_RFI_SPAN 0x20
+
+// An RFI request that hasn't produced a decodable frame within this long
+// (or 4 RTTs, if longer) is escalated to an IDR frame request. This is
+// checked for each lost frame and periodically by the control stream, so
+// it still happens if no more frames arrive.
+#define RECOVERY_MIN_RFI_TIMEOUT_US 250000
+
+// When IDR frames are expensive relative to P-frames, RFI requests are
+// given this many times as long to succeed before escalating.
+#define RECOVERY_EXPENSIVE_IDR_RATIO 4
+#define RECOVERY_EXPENSIVE_IDR_TIMEOUT_SCALE 2
+
+// Another IDR frame request isn't sent within this long (or 2 RTTs, if
+// longer) of the last one while we're still waiting for the IDR frame.
+#define RECOVERY_MIN_IDR_HOLDOFF_US 100000
+
+// If this many RFI requests have timed out within the window, new loss
+// goes straight to an IDR frame unless IDR frames are expensive.
+#define RECOVERY_FAILURE_WINDOW_US 2000000
+#define RECOVERY_MAX_RFI_FAILURES 2
+
+// Frame size averages use these EWMA gains (as a fraction 1/N)
+#define RECOVERY_PFRAME_SIZE_GAIN 16
+#define RECOVERY_IDR_SIZE_GAIN 4
+
+typedef struct _RECOVERY_IN_PROGRESS {
+    bool active;
+    int eventIndex;
+    uint32_t startFrame;
+    uint32_t endFrame;
+    uint64_t requestTimeUs;
+    uint64_t lastSentTimeUs;
+    bool rangeSent; // Set once the RFI thread takes the current range
+} RECOVERY_IN_PROGRESS, *PRECOVERY_IN_PROGRESS;
+
+static PLT_MUTEX recoveryMutex;
+static RECOVERY_EVENT recoveryEvents[RECOVERY_EVENT_HISTORY];
+static int recoveryEventCount;
+static int nextRecoveryEvent;
+static RECOVERY_STATS recoveryStats;
+static LATENCY_HISTOGRAM recoveryLatencyHistograms[LI_RECOVERY_ACTION_COUNT];
+
+static RECOVERY_IN_PROGRESS rfiRecovery;
+static RECOVERY_IN_PROGRESS idrRecovery;
+static uint64_t lastRfiFailureTimeUs[RECOVERY_MAX_RFI_FAILURES];
+static int nextRfiFailure;
+static uint32_t lastAckedLtrFrame;
+static bool lastAckedLtrFrameValid;
+static int avgPFrameSize;
+static int avgIdrFrameSize;
+
+void initializeRecoveryPolicy(void) {
+    PltCreateMutex(&recoveryMutex);
+
+    memset(recoveryEvents, 0, sizeof(recoveryEvents));
+    recoveryEventCount = 0;
+    nextRecoveryEvent = 0;
+    memset(&recoveryStats, 0, sizeof(recoveryStats));
+    for (int i = 0; i < LI_RECOVERY_ACTION_COUNT; i++) {
+        LhInitializeHistogram(&recoveryLatencyHistograms[i]);
+    }
+
+    memset(&rfiRecovery, 0, sizeof(rfiRecovery));
+    memset(&idrRecovery, 0, sizeof(idrRecovery));
+    memset(lastRfiFailureTimeUs, 0, sizeof(lastRfiFailureTimeUs));
+    nextRfiFailure = 0;
+    lastAckedLtrFrameValid = false;
+    avgPFrameSize = avgIdrFrameSize = 0;
+}
+
+void destroyRecoveryPolicy(void) {
+    PltDeleteMutex(&recoveryMutex);
+}
+
+static void getRtt(uint64_t* rttUs, uint64_t* rttVarianceUs) {
+    uint32_t rtt, rttVariance;
+
+    if (LiGetEstimatedRttInfo(&rtt, &rttVariance)) {
+        *rttUs = (uint64_t)rtt * 1000;
+        *rttVarianceUs = (uint64_t)rttVariance * 1000;
+    }
+    else {
+        *rttUs = *rttVarianceUs = 0;
+    }
+}
+
+static bool isIdrFrameExpensive(void) {
+    return avgPFrameSize != 0 && avgIdrFrameSize >= avgPFrameSize * RECOVERY_EXPENSIVE_IDR_RATIO;
+}
+
+// Must be called with recoveryMutex held
+static int addRecoveryEvent(uint8_t action, uint8_t trigger, uint32_t startFrame, uint32_t endFrame, uint64_t nowUs) {
+    int index = nextRecoveryEvent;
+
+    recoveryEvents[index] = (RECOVERY_EVENT){
+        .requestTimeUs = nowUs,
+        .startFrame = startFrame,
+        .endFrame = endFrame,
+        .action = action,
+        .trigger = trigger,
+    };
+
+    nextRecoveryEvent = (nextRecoveryEvent + 1) % RECOVERY_EVENT_HISTORY;
+    if (recoveryEventCount < RECOVERY_EVENT_HISTORY) {
+        recoveryEventCount++;
+    }
+
+    switch (action) {
+    case LI_RECOVERY_ACTION_RFI:
+        recoveryStats.rfiRequests++;
+        break;
+    case LI_RECOVERY_ACTION_LTR:
+        recoveryStats.ltrRecoveries++;
+        break;
+    case LI_RECOVERY_ACTION_IDR:
+        recoveryStats.idrRequests++;
+        break;
+    }
+
+    return index;
+}
+
+// Must be called with recoveryMutex held. The event may have been overwritten
+// by newer ones if the recovery took a very long time.
+static PRECOVERY_EVENT getRecoveryEvent(PRECOVERY_IN_PROGRESS recovery) {
+    PRECOVERY_EVENT event = &recoveryEvents[recovery->eventIndex];
+    return event->requestTimeUs == recovery->requestTimeUs ? event : NULL;
+}
+
+// Must be called with recoveryMutex held
+static void completeRecovery(PRECOVERY_IN_PROGRESS recovery, uint64_t nowUs) {
+    PRECOVERY_EVENT event = getRecoveryEvent(recovery);
+
+    if (event != NULL) {
+        event->recoveryTimeUs = (uint32_t)(nowUs - recovery->requestTimeUs);
+        LhAddSample(&recoveryLatencyHistograms[event->action], nowUs - recovery->requestTimeUs);
+    }
+
+    recovery->active = false;
+}
+
+// Must be called with recoveryMutex held
+static void startIdrRecovery(uint8_t trigger, uint32_t startFrame, uint32_t endFrame, uint64_t nowUs) {
+    PRECOVERY_EVENT event;
+
+    if (idrRecovery.active) {
+        // The IDR frame we're already waiting for covers this too
+        event = getRecoveryEvent(&idrRecovery);
+        if (event != NULL) {
+            event->coalescedRequests++;
+        }
+        recoveryStats.idrRequestsCoalesced++;
+        return;
+    }
+
+    // An IDR frame makes any RFI request in progress irrelevant
+    if (rfiRecovery.active) {
+        event = getRecoveryEvent(&rfiRecovery);
+        if (event != NULL) {
+            event->superseded = true;
+        }
+        rfiRecovery.active = false;
+    }
+
+    idrRecovery = (RECOVERY_IN_PROGRESS){
+        .active = true,
+        .eventIndex = addRecoveryEvent(LI_RECOVERY_ACTION_IDR, trigger, startFrame, endFrame, nowUs),
+        .startFrame = startFrame,
+        .endFrame = endFrame,
+        .requestTimeUs = nowUs,
+    };
+}
+
+// Must be called with recoveryMutex held
+static void recordRfiFailure(uint64_t nowUs) {
+    lastRfiFailureTimeUs[nextRfiFailure] = nowUs;
+    nextRfiFailure = (nextRfiFailure + 1) % RECOVERY_MAX_RFI_FAILURES;
+    recoveryStats.rfiEscalations++;
+}
+
+// Must be called with recoveryMutex held
+static bool hasRfiRecentlyFailed(uint64_t nowUs) {
+    for (int i = 0; i < RECOVERY_MAX_RFI_FAILURES; i++) {
+        if (lastRfiFailureTimeUs[i] == 0 || nowUs - lastRfiFailureTimeUs[i] > RECOVERY_FAILURE_WINDOW_US) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Must be called with recoveryMutex held. Escalates the RFI recovery in progress
+// to an IDR frame request if it has failed. Returns true if it was escalated.
+static bool escalateFailedRfiRecovery(uint64_t nowUs, uint64_t rttUs) {
+    uint64_t rfiTimeoutUs;
+
+    if (!rfiRecovery.active) {
+        return false;
+    }
+
+    rfiTimeoutUs = 4 * rttUs > RECOVERY_MIN_RFI_TIMEOUT_US ? 4 * rttUs : RECOVERY_MIN_RFI_TIMEOUT_US;
+    if (isIdrFrameExpensive()) {
+        rfiTimeoutUs *= RECOVERY_EXPENSIVE_IDR_TIMEOUT_SCALE;
+    }
+
+    if (rfiRecovery.endFrame - rfiRecovery.startFrame < RECOVERY_MAX_RFI_SPAN &&
+            nowUs - rfiRecovery.requestTimeUs <= rfiTimeoutUs) {
+        return false;
+    }
+
+    Limelog("RFI recovery of frames %u to %u is not working; requesting IDR frame\n",
+            rfiRecovery.startFrame, rfiRecovery.endFrame);
+    recordRfiFailure(nowUs);
+    startIdrRecovery(LI_RECOVERY_TRIGGER_RFI_TIMEOUT, rfiRecovery.startFrame, rfiRecovery.endFrame, nowUs);
+    return true;
+}
+
+// Decides how to recover from the loss of frames startFrame through endFrame.
+// Returns LI_RECOVERY_ACTION_RFI or LI_RECOVERY_ACTION_LTR if a reference frame
+// invalidation request should be sent for the range from recoveryPolicyTakeRfiRange(),
+// LI_RECOVERY_ACTION_IDR if an IDR frame should be requested, or -1 if the loss is
+// already covered by a recovery in progress.
+int recoveryPolicyFrameLoss(uint32_t startFrame, uint32_t endFrame) {
+    uint64_t nowUs = PltGetMicroseconds();
+    uint64_t rttUs, rttVarianceUs;
+    PRECOVERY_EVENT event;
+    int action;
+
+    getRtt(&rttUs, &rttVarianceUs);
+
+    PltLockMutex(&recoveryMutex);
+
+    if (!isReferenceFrameInvalidationEnabled()) {
+        startIdrRecovery(LI_RECOVERY_TRIGGER_FRAME_LOSS, startFrame, endFrame, nowUs);
+        action = LI_RECOVERY_ACTION_IDR;
+    }
+    else if (idrRecovery.active) {
+        // We're already waiting for an IDR frame that will fix this
+        event = getRecoveryEvent(&idrRecovery);
+        if (event != NULL) {
+            event->coalescedRequests++;
+        }
+        recoveryStats.rangesCoalesced++;
+        action = -1;
+    }
+    else if (rfiRecovery.active) {
+        // Merge the new range into the one we're recovering. This may cover frames that
+        // arrived intact, but the host only needs to avoid referencing anything in it.
+        if (startFrame < rfiRecovery.startFrame) {
+            rfiRecovery.startFrame = startFrame;
+        }
+        if (endFrame > rfiRecovery.endFrame) {
+            rfiRecovery.endFrame = endFrame;
+        }
+
+        event = getRecoveryEvent(&rfiRecovery);
+        if (event != NULL) {
+            event->startFrame = rfiRecovery.startFrame;
+            event->endFrame = rfiRecovery.endFrame;
+            event->coalescedRequests++;
+        }
+
+        if (escalateFailedRfiRecovery(nowUs, rttUs)) {
+            action = LI_RECOVERY_ACTION_IDR;
+        }
+        else if (!rfiRecovery.rangeSent || nowUs - rfiRecovery.lastSentTimeUs < rttUs) {
+            // Frames sent before the host could have seen our last request are
+            // covered by it, so there's no point in sending it again yet.
+            recoveryStats.rangesCoalesced++;
+            action = -1;
+        }
+        else {
+            // This loss is of frames sent after the host acted on our request,
+            // possibly including the recovery frame itself, so send a new one.
+            action = event != NULL ? event->action : LI_RECOVERY_ACTION_RFI;
+        }
+    }
+    else if (endFrame - startFrame >= RECOVERY_MAX_RFI_SPAN ||
+             (hasRfiRecentlyFailed(nowUs) && !isIdrFrameExpensive())) {
+        startIdrRecovery(LI_RECOVERY_TRIGGER_FRAME_LOSS, startFrame, endFrame, nowUs);
+        action = LI_RECOVERY_ACTION_IDR;
+    }
+    else {
+        // Sunshine recovers from the last acknowledged LTR frame if it's still usable.
+        // This uses the same RFI request, but we track it separately.
+        if (IS_SUNSHINE() && lastAckedLtrFrameValid && lastAckedLtrFrame < startFrame) {
+            action = LI_RECOVERY_ACTION_LTR;
+        }
+        else {
+            action = LI_RECOVERY_ACTION_RFI;
+        }
+
+        rfiRecovery = (RECOVERY_IN_PROGRESS){
+            .active = true,
+            .eventIndex = addRecoveryEvent((uint8_t)action, LI_RECOVERY_TRIGGER_FRAME_LOSS, startFrame, endFrame, nowUs),
+            .startFrame = startFrame,
+            .endFrame = endFrame,
+            .requestTimeUs = nowUs,
+        };
+    }
+
+    if (action == LI_RECOVERY_ACTION_RFI || action == LI_RECOVERY_ACTION_LTR) {
+        rfiRecovery.rangeSent = false;
+    }
+
+    PltUnlockMutex(&recoveryMutex);
+
+    return action;
+}
+
+// Called periodically to escalate an RFI recovery that has timed out, even if we
+// aren't receiving any frames to notice it. Returns true if an IDR frame is needed.
+bool recoveryPolicyCheckRfiTimeout(void) {
+    uint64_t nowUs = PltGetMicroseconds();
+    uint64_t rttUs, rttVarianceUs;
+    bool ret;
+
+    getRtt(&rttUs, &rttVarianceUs);
+
+    PltLockMutex(&recoveryMutex);
+    ret = escalateFailedRfiRecovery(nowUs, rttUs);
+    PltUnlockMutex(&recoveryMutex);
+
+    return ret;
+}
+
+// Returns the range to send in an RFI request, or false if there's nothing to send
+// because an IDR frame request superseded it or an earlier request already covered it.
+bool recoveryPolicyTakeRfiRange(uint32_t* startFrame, uint32_t* endFrame) {
+    bool ret = false;
+
+    PltLockMutex(&recoveryMutex);
+    if (rfiRecovery.active && !rfiRecovery.rangeSent) {
+        *startFrame = rfiRecovery.startFrame;
+        *endFrame = rfiRecovery.endFrame;
+        rfiRecovery.rangeSent = true;
+        rfiRecovery.lastSentTimeUs = PltGetMicroseconds();
+        ret = true;
+    }
+    PltUnlockMutex(&recoveryMutex);
+
+    return ret;
+}
+
+// Records a request for an IDR frame that didn't come from recoveryPolicyFrameLoss()
+void recoveryPolicyIdrRequested(uint8_t trigger) {
+    PltLockMutex(&recoveryMutex);
+    startIdrRecovery(trigger, 0, 0, PltGetMicroseconds());
+    PltUnlockMutex(&recoveryMutex);
+}
+
+// Returns how long to wait before sending another IDR frame request, since
+// the host may still be answering the last one
+uint32_t recoveryPolicyGetIdrHoldoffMs(void) {
+    uint64_t nowUs = PltGetMicroseconds();
+    uint64_t rttUs, rttVarianceUs;
+    uint64_t holdoffUs;
+    uint32_t ret = 0;
+
+    getRtt(&rttUs, &rttVarianceUs);
+    holdoffUs = 2 * rttUs + 4 * rttVarianceUs;
+    if (holdoffUs < RECOVERY_MIN_IDR_HOLDOFF_US) {
+        holdoffUs = RECOVERY_MIN_IDR_HOLDOFF_US;
+    }
+
+    PltLockMutex(&recoveryMutex);
+    if (idrRecovery.active && idrRecovery.lastSentTimeUs != 0 && nowUs - idrRecovery.lastSentTimeUs < holdoffUs) {
+        ret = (uint32_t)((holdoffUs - (nowUs - idrRecovery.lastSentTimeUs) + 999) / 1000);
+    }
+    PltUnlockMutex(&recoveryMutex);
+
+    return ret;
+}
+
+bool recoveryPolicyIsIdrPending(void) {
+    bool ret;
+
+    PltLockMutex(&recoveryMutex);
+    ret = idrRecovery.active;
+    PltUnlockMutex(&recoveryMutex);
+
+    return ret;
+}
+
+void recoveryPolicyIdrSent(void) {
+    PltLockMutex(&recoveryMutex);
+    if (idrRecovery.active) {
+        idrRecovery.lastSentTimeUs = PltGetMicroseconds();
+    }
+    PltUnlockMutex(&recoveryMutex);
+}
+
+void recoveryPolicyLtrAcknowledged(uint32_t frameIndex) {
+    PltLockMutex(&recoveryMutex);
+    lastAckedLtrFrame = frameIndex;
+    lastAckedLtrFrameValid = true;
+    PltUnlockMutex(&recoveryMutex);
+}
+
+// Called by the depacketizer for each frame that is ready to decode
+void recoveryPolicyFrameReceived(uint32_t frameIndex, bool idrFrame, int frameSize) {
+    uint64_t nowUs = PltGetMicroseconds();
+
+    PltLockMutex(&recoveryMutex);
+
+    if (idrFrame) {
+        if (avgIdrFrameSize == 0) {
+            avgIdrFrameSize = frameSize;
+        }
+        else {
+            avgIdrFrameSize += (frameSize - avgIdrFrameSize) / RECOVERY_IDR_SIZE_GAIN;
+        }
+
+        if (idrRecovery.active) {
+            completeRecovery(&idrRecovery, nowUs);
+        }
+
+        // An IDR frame also satisfies any RFI request in progress
+        if (rfiRecovery.active) {
+            completeRecovery(&rfiRecovery, nowUs);
+        }
+    }
+    else {
+        if (avgPFrameSize == 0) {
+            avgPFrameSize = frameSize;
+        }
+        else {
+            avgPFrameSize += (frameSize - avgPFrameSize) / RECOVERY_PFRAME_SIZE_GAIN;
+        }
+
+        // The depacketizer drops frames until the host responds to an RFI
+        // request, so any frame after the lost range means we've recovered.
+        if (rfiRecovery.active && frameIndex > rfiRecovery.endFrame) {
+            completeRecovery(&rfiRecovery, nowUs);
+        }
+    }
+
+    PltUnlockMutex(&recoveryMutex);
+}
+
+int LiGetRecoveryEvents(PRECOVERY_EVENT events, int maxEvents) {
+    int count;
+
+    PltLockMutex(&recoveryMutex);
+
+    count = recoveryEventCount < maxEvents ? recoveryEventCount : maxEvents;
+    for (int i = 0; i < count; i++) {
+        int index = (nextRecoveryEvent - count + i + RECOVERY_EVENT_HISTORY) % RECOVERY_EVENT_HISTORY;
+        events[i] = recoveryEvents[index];
+    }
+
+    PltUnlockMutex(&recoveryMutex);
+
+    return count;
+}
+
+bool LiGetRecoveryStats(PRECOVERY_STATS stats) {
+    PltLockMutex(&recoveryMutex);
+    *stats = recoveryStats;
+    PltUnlockMutex(&recoveryMutex);
+
+    return stats->rfiRequests != 0 || stats->ltrRecoveries != 0 || stats->idrRequests != 0;
+}
+
+bool LiGetRecoveryLatency(int action, uint32_t* p50Us, uint32_t* p90Us, uint32_t* p99Us) {
+    PLATENCY_HISTOGRAM histogram;
+
+    if (action < 0 || action >= LI_RECOVERY_ACTION_COUNT) {
+        return false;
+    }
+
+    // As with the other latency stats, torn reads are acceptable here
+    histogram = &recoveryLatencyHistograms[action];
+    if (histogram->sampleCount == 0) {
+        return false;
+    }
+
+    *p50Us = LhGetPercentile(histogram, 50);
+    *p90Us = LhGetPercentile(histogram, 90);
+    *p99Us = LhGetPercentile(histogram, 99);
+    return true;
+}
@@ -27,6 +27,10 @@ void RtpaInitializeQueue(PRTP_AUDIO_QUEUE queue) {
     // full FEC block before reporting losses, out of order packets, etc.
     queue->synchronizing = true;
 
+    LhInitializeHistogram(&queue->oosDelayHistogram);
+    queue->oosWaitTimeUs = RTPQ_OOS_WAIT_TIME_MS * 1000;
+    queue->stats.oosWaitTimeMs = RTPQ_OOS_WAIT_TIME_MS;
+
     // Older versions of GFE violate some invariants that our FEC code requires, so we turn it off for
     // anything older than GFE 3.19 just to be safe. GFE seems to have changed to the "modern" behavior
     // between GFE 3.18 and 3.19.
@@ -104,41 +108,55 @@ static void validateFecBlockState(PRTP_AUDIO_QUEUE queue) {
 #endif
 }
 
-static PRTPA_FEC_BLOCK allocateFecBlock(PRTP_AUDIO_QUEUE queue, uint16_t blockSize) {
-    PRTPA_FEC_BLOCK block = queue->freeBlockHead;
+static size_t getFecBlockAllocationSize(uint16_t blockSize) {
+    uint16_t dataPacketSize = blockSize + sizeof(RTP_PACKET);
+    return sizeof(RTPA_FEC_BLOCK) + (RTPA_DATA_SHARDS * dataPacketSize) + (RTPA_FEC_SHARDS * blockSize);
+}
 
-    if (block != NULL) {
-        LC_ASSERT(queue->freeBlockCount > 0);
+static bool isPooledFecBlock(PRTP_AUDIO_QUEUE queue, PRTPA_FEC_BLOCK block) {
+    return queue->blockPool != NULL &&
+        (uintptr_t)block >= (uintptr_t)queue->blockPool &&
+        (uintptr_t)block < (uintptr_t)(queue->blockPool + (RTPA_FEC_BLOCK_POOL_SIZE * queue->blockPoolStride));
+}
 
-        // If the block size matches, we're good to go
-        if (block->blockSize == blockSize) {
-            // Advance the free block list to the next entry
-            queue->freeBlockHead = block->next;
-            queue->freeBlockCount--;
+static void allocateFecBlockPool(PRTP_AUDIO_QUEUE queue, uint16_t blockSize) {
+    LC_ASSERT(queue->blockPool == NULL);
 
-            // Return the new block
-            return block;
-        }
-        else {
-            // The block size didn't match. This should never happen with GFE
-            // because it uses constant sized data shards, but Sunshine can
-            // trigger this condition. If it does happen, let's free the cached
-            // entry so we can populate the cache with correctly sized blocks.
-            queue->freeBlockHead = block->next;
-            queue->freeBlockCount--;
-
-            // Free the existing block
-            free(block);
-        }
+    // Keep each block pointer-aligned within the pool
+    queue->blockPoolStride = (getFecBlockAllocationSize(blockSize) + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+    queue->blockPool = malloc(RTPA_FEC_BLOCK_POOL_SIZE * queue->blockPoolStride);
+    if (queue->blockPool == NULL) {
+        return;
     }
-    else {
-        LC_ASSERT(queue->freeBlockCount == 0);
+
+    queue->blockPoolBlockSize = blockSize;
+    for (int i = 0; i < RTPA_FEC_BLOCK_POOL_SIZE; i++) {
+        queue->freeBlocks[i] = (PRTPA_FEC_BLOCK)(queue->blockPool + (i * queue->blockPoolStride));
     }
+    queue->freeBlockCount = RTPA_FEC_BLOCK_POOL_SIZE;
+}
 
-    // We either didn't have any free entries or the block
-    // size didn't match, so allocate a new FEC block now.
-    uint16_t dataPacketSize = blockSize + sizeof(RTP_PACKET);
-    return malloc(sizeof(*block) + (RTPA_DATA_SHARDS * dataPacketSize) + (RTPA_FEC_SHARDS * blockSize));
+static PRTPA_FEC_BLOCK allocateFecBlock(PRTP_AUDIO_QUEUE queue, uint16_t blockSize) {
+    // The block size should never change with GFE because it uses constant sized
+    // data shards, but Sunshine can change it. If it does, we rebuild the pool
+    // for the new size once all blocks of the old size have been returned.
+    if (queue->blockPool != NULL && queue->blockPoolBlockSize != blockSize &&
+            queue->freeBlockCount == RTPA_FEC_BLOCK_POOL_SIZE) {
+        free(queue->blockPool);
+        queue->blockPool = NULL;
+        queue->freeBlockCount = 0;
+    }
+
+    if (queue->blockPool == NULL) {
+        allocateFecBlockPool(queue, blockSize);
+    }
+
+    if (queue->blockPool != NULL && queue->blockPoolBlockSize == blockSize && queue->freeBlockCount > 0) {
+        return queue->freeBlocks[--queue->freeBlockCount];
+    }
+
+    queue->stats.fecBlockPoolExhausted++;
+    return malloc(getFecBlockAllocationSize(blockSize));
 }
 
 static void freeFecBlockHead(PRTP_AUDIO_QUEUE queue) {
@@ -160,15 +178,13 @@ static void freeFecBlockHead(PRTP_AUDIO_QUEUE queue) {
 
     validateFecBlockState(queue);
 
-    if (queue->freeBlockCount >= RTPA_CACHED_FEC_BLOCK_LIMIT) {
-        // Too many entries cached, so just free this one
-        free(blockHead);
+    if (isPooledFecBlock(queue, blockHead)) {
+        // The pool always has room for all of its own blocks
+        LC_ASSERT(queue->freeBlockCount < RTPA_FEC_BLOCK_POOL_SIZE);
+        queue->freeBlocks[queue->freeBlockCount++] = blockHead;
     }
     else {
-        // Place this entry at the head of the free list for better cache behavior
-        blockHead->next = queue->freeBlockHead;
-        queue->freeBlockHead = blockHead;
-        queue->freeBlockCount++;
+        free(blockHead);
     }
 }
 
@@ -176,24 +192,55 @@ void RtpaCleanupQueue(PRTP_AUDIO_QUEUE queue) {
     while (queue->blockHead != NULL) {
         PRTPA_FEC_BLOCK block = queue->blockHead;
         queue->blockHead = block->next;
-        free(block);
+
+        // Pooled blocks are freed with the pool itself
+        if (!isPooledFecBlock(queue, block)) {
+            free(block);
+        }
     }
 
     queue->blockTail = NULL;
 
-    while (queue->freeBlockHead != NULL) {
-        PRTPA_FEC_BLOCK block = queue->freeBlockHead;
-        queue->freeBlockHead = block->next;
-        queue->freeBlockCount--;
-        free(block);
-    }
-
-    LC_ASSERT(queue->freeBlockCount == 0);
+    free(queue->blockPool);
+    queue->blockPool = NULL;
+    queue->freeBlockCount = 0;
 
     reed_solomon_release(queue->rs);
     queue->rs = NULL;
 }
 
+// Returns how far nowUs is past the time the FEC block should have been fully received
+static uint64_t getFecBlockLatenessUs(uint64_t blockQueueTimeUs, uint64_t nowUs) {
+    uint64_t blockDurationUs = (uint64_t)AudioPacketDuration * RTPA_DATA_SHARDS * 1000;
+
+    if (nowUs - blockQueueTimeUs <= blockDurationUs) {
+        return 0;
+    }
+
+    return nowUs - blockQueueTimeUs - blockDurationUs;
+}
+
+static void addOosDelaySample(PRTP_AUDIO_QUEUE queue, uint64_t latenessUs) {
+    if (queue->oosDelayHistogram.sampleCount >= RTPQ_OOS_DELAY_DECAY_SAMPLES) {
+        LhDecayHistogram(&queue->oosDelayHistogram);
+    }
+    LhAddSample(&queue->oosDelayHistogram, latenessUs);
+
+    if (queue->oosDelayHistogram.sampleCount >= RTPQ_OOS_WAIT_MIN_SAMPLES) {
+        uint64_t waitTimeUs = LhGetPercentile(&queue->oosDelayHistogram, RTPQ_OOS_WAIT_PERCENTILE);
+
+        if (waitTimeUs < RTPQ_OOS_WAIT_MIN_TIME_MS * 1000) {
+            waitTimeUs = RTPQ_OOS_WAIT_MIN_TIME_MS * 1000;
+        }
+        else if (waitTimeUs > RTPQ_OOS_WAIT_MAX_TIME_MS * 1000) {
+            waitTimeUs = RTPQ_OOS_WAIT_MAX_TIME_MS * 1000;
+        }
+
+        queue->oosWaitTimeUs = waitTimeUs;
+        queue->stats.oosWaitTimeMs = (uint32_t)((waitTimeUs + 999) / 1000);
+    }
+}
+
 static PRTPA_FEC_BLOCK getFecBlockForRtpPacket(PRTP_AUDIO_QUEUE queue, PRTP_PACKET packet, uint16_t length) {
     uint32_t fecBlockSsrc;
     uint16_t fecBlockBaseSeqNum;
@@ -298,6 +345,10 @@ static PRTPA_FEC_BLOCK getFecBlockForRtpPacket(PRTP_AUDIO_QUEUE queue, PRTP_PACK
 
     // Drop packets from FEC blocks that have already been completed
     if (isBefore16(fecBlockBaseSeqNum, queue->oldestRtpBaseSequenceNumber)) {
+        // If we gave up on this block, remember how long we would have needed to wait for it
+        if (queue->abandonedBlockValid && fecBlockBaseSeqNum == queue->abandonedBlockBaseSequenceNumber) {
+            addOosDelaySample(queue, getFecBlockLatenessUs(queue->abandonedBlockQueueTimeUs, PltGetMicroseconds()));
+        }
         return NULL;
     }
 
@@ -322,6 +373,15 @@ static PRTPA_FEC_BLOCK getFecBlockForRtpPacket(PRTP_AUDIO_QUEUE queue, PRTP_PACK
                 return NULL;
             }
 
+            // If a later block has already arrived, this shard was reordered. Record
+            // how late it was so we know how long to wait for shards like it.
+            if (existingBlock != queue->blockTail && !existingBlock->fullyReassembled) {
+                uint64_t latenessUs = getFecBlockLatenessUs(existingBlock->queueTimeUs, PltGetMicroseconds());
+                if (latenessUs != 0) {
+                    addOosDelaySample(queue, latenessUs);
+                }
+            }
+
             // If the block is completed, don't return it
             return existingBlock->fullyReassembled ? NULL : existingBlock;
         }
@@ -544,10 +604,18 @@ static void handleMissingPackets(PRTP_AUDIO_QUEUE queue) {
     // At this point, we know we've got a second FEC block queued up waiting on the first one to complete.
     // If we've never seen OOS data from this host, we'll assume the first one is lost and skip forward.
     // If we have seen OOS data, we'll wait for a little while longer to see if OOS packets arrive before giving up.
-    if (!queue->receivedOosData || PltGetMicroseconds() - queue->blockHead->queueTimeUs > (uint64_t)(AudioPacketDuration * RTPA_DATA_SHARDS) + (RTPQ_OOS_WAIT_TIME_MS * 1000)) {
+    if (!queue->receivedOosData || getFecBlockLatenessUs(queue->blockHead->queueTimeUs, PltGetMicroseconds()) > queue->oosWaitTimeUs) {
         LC_ASSERT(!isBefore16(queue->nextRtpSequenceNumber, queue->blockHead->fecHeader.baseSequenceNumber));
 
         queue->stats.packetCountFecFailed++;
+        if (queue->receivedOosData) {
+            queue->stats.oosWaitTimeouts++;
+        }
+
+        // Remember this block so we can see if its missing shards show up later
+        queue->abandonedBlockBaseSequenceNumber = queue->blockHead->fecHeader.baseSequenceNumber;
+        queue->abandonedBlockQueueTimeUs = queue->blockHead->queueTimeUs;
+        queue->abandonedBlockValid = true;
         Limelog("Unable to recover audio data block %u to %u (%u+%u=%u received < %u needed)\n",
                 queue->blockHead->fecHeader.baseSequenceNumber,
                 queue->blockHead->fecHeader.baseSequenceNumber + RTPA_DATA_SHARDS - 1,
@@ -649,6 +717,11 @@ int RtpaAddPacket(PRTP_AUDIO_QUEUE queue, PRTP_PACKET packet, uint16_t length) {
     if (completeFecBlock(queue, fecBlock)) {
         // We completed a FEC block
         fecBlock->fullyReassembled = true;
+
+        // If we were holding up later blocks waiting on this one, the wait paid off
+        if (queue->receivedOosData && fecBlock == queue->blockHead && queue->blockHead != queue->blockTail) {
+            queue->stats.oosWaitRecoveries++;
+        }
     }
 
     // If we still have nothing ready, see if we should skip the missing packets.
@@ -659,23 +732,23 @@ int RtpaAddPacket(PRTP_AUDIO_QUEUE queue, PRTP_PACKET packet, uint16_t length) {
     return queueHasPacketReady(queue) ? RTPQ_RET_PACKET_READY : 0;
 }
 
-PRTP_PACKET RtpaGetQueuedPacket(PRTP_AUDIO_QUEUE queue, uint16_t customHeaderLength, uint16_t* length) {
+// Copies the next ready packet into the caller's buffer. If the packet was lost and
+// could not be recovered, *length is set to 0 to indicate the caller should perform
+// packet loss concealment. Returns false if no packet is ready.
+bool RtpaGetQueuedPacket(PRTP_AUDIO_QUEUE queue, PRTP_PACKET packet, uint16_t maxLength, uint16_t* length) {
     validateFecBlockState(queue);
 
     // If we're returning audio data even with discontinuities, we'll fill in blank entries
     // for packets that were lost and could not be recovered.
     if (queue->blockHead != NULL && queue->blockHead->allowDiscontinuity) {
         PRTPA_FEC_BLOCK nextBlock = queue->blockHead;
-        PRTP_PACKET lostPacket;
+        bool lostPacket;
 
         LC_ASSERT(nextBlock->fecHeader.baseSequenceNumber + nextBlock->nextDataPacketIndex == queue->nextRtpSequenceNumber);
         if (nextBlock->marks[nextBlock->nextDataPacketIndex]) {
             // This packet is missing. Return an empty entry to let the caller
             // know to perform packet loss concealment for this frame.
-            lostPacket = malloc(customHeaderLength);
-            if (lostPacket == NULL) {
-                return NULL;
-            }
+            lostPacket = true;
 
             // Lost packet placeholder entries have no associated data
             *length = 0;
@@ -685,7 +758,7 @@ PRTP_PACKET RtpaGetQueuedPacket(PRTP_AUDIO_QUEUE queue, uint16_t customHeaderLen
             queue->nextRtpSequenceNumber++;
         }
         else {
-            lostPacket = NULL;
+            lostPacket = false;
             LC_ASSERT(queueHasPacketReady(queue));
         }
 
@@ -697,21 +770,23 @@ PRTP_PACKET RtpaGetQueuedPacket(PRTP_AUDIO_QUEUE queue, uint16_t customHeaderLen
             validateFecBlockState(queue);
         }
 
-        if (lostPacket != NULL) {
-            return lostPacket;
+        if (lostPacket) {
+            return true;
         }
     }
 
     // Return the next RTP sequence number by indexing into the most recent FEC block
     if (queueHasPacketReady(queue)) {
         PRTPA_FEC_BLOCK nextBlock = queue->blockHead;
-        PRTP_PACKET packet = malloc(customHeaderLength + sizeof(RTP_PACKET) + nextBlock->blockSize);
-        if (packet == NULL) {
-            return NULL;
+
+        // The block size is derived from received packets, so it must fit in a packet buffer
+        LC_ASSERT(nextBlock->blockSize + sizeof(RTP_PACKET) <= maxLength);
+        if (nextBlock->blockSize + sizeof(RTP_PACKET) > maxLength) {
+            return false;
         }
 
         *length = nextBlock->blockSize + sizeof(RTP_PACKET);
-        memcpy((uint8_t*)packet + customHeaderLength, nextBlock->dataPackets[nextBlock->nextDataPacketIndex], *length);
+        memcpy(packet, nextBlock->dataPackets[nextBlock->nextDataPacketIndex], *length);
         nextBlock->nextDataPacketIndex++;
 
         queue->nextRtpSequenceNumber++;
@@ -724,8 +799,8 @@ PRTP_PACKET RtpaGetQueuedPacket(PRTP_AUDIO_QUEUE queue, uint16_t customHeaderLen
             validateFecBlockState(queue);
         }
 
-        return packet;
+        return true;
     }
 
-    return NULL;
+    return false;
 }
@@ -1,19 +1,31 @@
 #pragma once
 
 #include "Video.h"
+#include "LatencyHistogram.h"
 
 typedef struct _reed_solomon reed_solomon;
 
-// Maximum time to wait for an OOS data/FEC shard
+// Initial time to wait for an OOS data/FEC shard
 // after the entire FEC block should have been received
 #define RTPQ_OOS_WAIT_TIME_MS 10
 
+// Once we've seen enough late shards, the wait time adapts to cover
+// this percentile of them within the minimum and maximum wait times.
+#define RTPQ_OOS_WAIT_PERCENTILE 95
+#define RTPQ_OOS_WAIT_MIN_SAMPLES 10
+
+// The late shard histogram is halved once it reaches this many samples,
+// so the wait time can come back down after a period of heavy reordering
+#define RTPQ_OOS_DELAY_DECAY_SAMPLES 128
+#define RTPQ_OOS_WAIT_MIN_TIME_MS 2
+#define RTPQ_OOS_WAIT_MAX_TIME_MS 40
+
 #define RTPA_DATA_SHARDS 4
 #define RTPA_FEC_SHARDS 2
 #define RTPA_TOTAL_SHARDS (RTPA_DATA_SHARDS + RTPA_FEC_SHARDS)
 
-// Maximum number of FEC block entries to cache
-#define RTPA_CACHED_FEC_BLOCK_LIMIT 4
+// Number of FEC blocks in the preallocated block pool
+#define RTPA_FEC_BLOCK_POOL_SIZE 8
 
 typedef struct _AUDIO_FEC_HEADER {
     uint8_t fecShardIndex;
@@ -53,7 +65,12 @@ typedef struct _RTP_AUDIO_QUEUE {
 
     reed_solomon* rs;
 
-    PRTPA_FEC_BLOCK freeBlockHead;
+    // FEC blocks are recycled through a fixed pool, which is allocated once
+    // the block size is known. Blocks of any other size are allocated on demand.
+    uint8_t* blockPool;
+    size_t blockPoolStride;
+    uint16_t blockPoolBlockSize;
+    PRTPA_FEC_BLOCK freeBlocks[RTPA_FEC_BLOCK_POOL_SIZE];
     uint16_t freeBlockCount;
 
     uint16_t nextRtpSequenceNumber;
@@ -61,6 +78,15 @@ typedef struct _RTP_AUDIO_QUEUE {
 
     uint16_t lastOosSequenceNumber;
     bool receivedOosData;
+
+    // How late shards arrive after their FEC block should have been received
+    LATENCY_HISTOGRAM oosDelayHistogram;
+    uint64_t oosWaitTimeUs;
+
+    // The last FEC block we gave up on, used to measure how late its shards arrive
+    uint16_t abandonedBlockBaseSequenceNumber;
+    uint64_t abandonedBlockQueueTimeUs;
+    bool abandonedBlockValid;
     bool synchronizing;
     bool incompatibleServer;
 
@@ -78,4 +104,4 @@ typedef struct _RTP_AUDIO_QUEUE {
 void RtpaInitializeQueue(PRTP_AUDIO_QUEUE queue);
 void RtpaCleanupQueue(PRTP_AUDIO_QUEUE queue);
 int RtpaAddPacket(PRTP_AUDIO_QUEUE queue, PRTP_PACKET packet, uint16_t length);
-PRTP_PACKET RtpaGetQueuedPacket(PRTP_AUDIO_QUEUE queue, uint16_t customHeaderLength, uint16_t* length);
+bool RtpaGetQueuedPacket(PRTP_AUDIO_QUEUE queue, PRTP_PACKET packet, uint16_t maxLength, uint16_t* length);
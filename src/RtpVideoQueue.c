@@ -10,10 +10,17 @@
 #define FEC_VERBOSE
 #endif
 
-// Don't try speculative RFI for 5 minutes after seeing
-// an out of order packet or incorrect prediction
+// Forget our reordering history after 5 minutes
+// without seeing an out of order packet
 #define SPECULATIVE_RFI_COOLDOWN_PERIOD_US 300000000
 
+// Our reorder tolerance covers this percentile of observed reordering depths
+#define REORDER_TOLERANCE_PERCENTILE 99
+
+// The reordering histogram is halved once it reaches this many samples,
+// so old samples gradually lose their influence
+#define REORDER_HISTOGRAM_DECAY_SAMPLES 256
+
 // RTP packets use a 90 KHz presentation timestamp clock
 #define PTS_DIVISOR 90
 
@@ -23,6 +30,9 @@ void RtpvInitializeQueue(PRTP_VIDEO_QUEUE queue) {
 
     queue->currentFrameNumber = 1;
     queue->multiFecCapable = APP_VERSION_AT_LEAST(7, 1, 431);
+
+    resetConnectionQuality();
+    resetBandwidthEstimator();
 }
 
 static void purgeListEntries(PRTPV_QUEUE_LIST list) {
@@ -111,7 +121,6 @@ static void reportFinalFrameFecStatus(PRTP_VIDEO_QUEUE queue) {
 // newEntry is contained within the packet buffer so we free the whole entry by freeing entry->packet
 static bool queuePacket(PRTP_VIDEO_QUEUE queue, PRTPV_QUEUE_ENTRY newEntry, PRTP_PACKET packet, int length, bool isParity, bool isFecRecovery) {
     PRTPV_QUEUE_ENTRY entry;
-    bool outOfSequence;
 
     LC_ASSERT(!(isFecRecovery && isParity));
     LC_ASSERT(!isBefore16(packet->sequenceNumber, queue->nextContiguousSequenceNumber));
@@ -126,20 +135,14 @@ static bool queuePacket(PRTP_VIDEO_QUEUE queue, PRTPV_QUEUE_ENTRY newEntry, PRTP
     // path for this entire frame to avoid possibly mishandling a duplicate packet.
     if (queue->useFastQueuePath && packet->sequenceNumber == queue->nextContiguousSequenceNumber) {
         queue->nextContiguousSequenceNumber = U16(packet->sequenceNumber + 1);
-        outOfSequence = false;
     }
     else {
-        outOfSequence = false;
-
         // Check for duplicates
         entry = queue->pendingFecBlockList.head;
         while (entry != NULL) {
             if (packet->sequenceNumber == entry->packet->sequenceNumber) {
                 return false;
             }
-            else if (isBefore16(packet->sequenceNumber, entry->packet->sequenceNumber)) {
-                outOfSequence = true;
-            }
 
             entry = entry->next;
         }
@@ -158,28 +161,99 @@ static bool queuePacket(PRTP_VIDEO_QUEUE queue, PRTPV_QUEUE_ENTRY newEntry, PRTP
     newEntry->presentationTimeUs = ((uint64_t)packet->timestamp * 1000) / PTS_DIVISOR;
     newEntry->rtpTimestamp = packet->timestamp;
 
-    // FEC recovery packets are synthesized by us, so don't use them to determine OOS data
-    if (!isFecRecovery) {
-        if (outOfSequence) {
-            // This packet was received after a higher sequence number packet, so note that we
-            // received an out of order packet to disable our speculative RFI recovery logic.
-            queue->lastOosFramePresentationTimestamp = newEntry->presentationTimeUs;
-            if (!queue->receivedOosData) {
-                Limelog("Leaving speculative RFI mode after OOS video data at frame %u\n",
-                        queue->currentFrameNumber);
-                queue->receivedOosData = true;
-            }
+    insertEntryIntoList(&queue->pendingFecBlockList, newEntry);
+
+    return true;
+}
+
+static void updateReorderTolerance(PRTP_VIDEO_QUEUE queue) {
+    uint32_t allowedDeeperSamples = (queue->reorderSampleCount * (100 - REORDER_TOLERANCE_PERCENTILE)) / 100;
+    uint32_t deeperSamples = queue->reorderSampleCount;
+    uint32_t depth;
+
+    // Find the smallest depth that has no more than the allowed number of samples beyond it
+    for (depth = 0; depth < RTPV_REORDER_DEPTH_BUCKETS - 1; depth++) {
+        deeperSamples -= queue->reorderDepthHistogram[depth];
+        if (deeperSamples <= allowedDeeperSamples) {
+            break;
         }
-        else if (queue->receivedOosData && newEntry->presentationTimeUs > queue->lastOosFramePresentationTimestamp + SPECULATIVE_RFI_COOLDOWN_PERIOD_US) {
-            Limelog("Entering speculative RFI mode after sequenced video data at frame %u\n",
-                    queue->currentFrameNumber);
-            queue->receivedOosData = false;
+    }
+
+    if (queue->reorderTolerance != depth) {
+        Limelog("Video reorder tolerance is now %u packets\n", depth);
+        queue->reorderTolerance = depth;
+        queue->stats.reorderTolerance = depth;
+    }
+}
+
+// Tracks how far behind the highest sequence number each late packet arrives.
+// This includes late packets that we will reject because we've moved on.
+static void trackPacketReordering(PRTP_VIDEO_QUEUE queue, PRTP_PACKET packet) {
+    uint64_t presentationTimeUs = ((uint64_t)packet->timestamp * 1000) / PTS_DIVISOR;
+
+    if (!queue->reorderHighestSequenceNumberValid || isBefore16(queue->reorderHighestSequenceNumber, packet->sequenceNumber)) {
+        queue->reorderHighestSequenceNumber = packet->sequenceNumber;
+        queue->reorderHighestSequenceNumberValid = true;
+
+        // If we haven't seen any reordering for a while, forget about what we saw before
+        if (queue->reorderSampleCount != 0 && presentationTimeUs > queue->lastOosPresentationTimeUs + SPECULATIVE_RFI_COOLDOWN_PERIOD_US) {
+            memset(queue->reorderDepthHistogram, 0, sizeof(queue->reorderDepthHistogram));
+            queue->reorderSampleCount = 0;
+            updateReorderTolerance(queue);
         }
+        return;
     }
 
-    insertEntryIntoList(&queue->pendingFecBlockList, newEntry);
+    uint16_t depth = U16(queue->reorderHighestSequenceNumber - packet->sequenceNumber);
+    if (depth == 0) {
+        // Duplicate of the highest packet
+        return;
+    }
 
-    return true;
+    if (queue->reorderSampleCount >= REORDER_HISTOGRAM_DECAY_SAMPLES) {
+        queue->reorderSampleCount = 0;
+        for (int i = 0; i < RTPV_REORDER_DEPTH_BUCKETS; i++) {
+            queue->reorderDepthHistogram[i] /= 2;
+            queue->reorderSampleCount += queue->reorderDepthHistogram[i];
+        }
+    }
+
+    queue->reorderDepthHistogram[depth < RTPV_REORDER_DEPTH_BUCKETS ? depth : RTPV_REORDER_DEPTH_BUCKETS - 1]++;
+    queue->reorderSampleCount++;
+    queue->lastOosPresentationTimeUs = presentationTimeUs;
+
+    updateReorderTolerance(queue);
+}
+
+// Returns the number of missing packets that are further behind the highest received
+// sequence number than our reorder tolerance. These are unlikely to still arrive.
+static uint32_t getMissingPacketsBeyondReorderTolerance(PRTP_VIDEO_QUEUE queue) {
+    uint32_t span = U16(queue->receivedHighestSequenceNumber - queue->bufferLowestSequenceNumber);
+    uint32_t olderPackets;
+    uint32_t receivedOlderPackets;
+    PRTPV_QUEUE_ENTRY entry;
+
+    if (queue->reorderTolerance == 0) {
+        return queue->missingPackets;
+    }
+    else if (span <= queue->reorderTolerance) {
+        return 0;
+    }
+
+    // Count the received packets older than the tolerance to find how many are missing
+    olderPackets = span - queue->reorderTolerance;
+    receivedOlderPackets = 0;
+    entry = queue->pendingFecBlockList.head;
+    while (entry != NULL) {
+        if (U16(entry->packet->sequenceNumber - queue->bufferLowestSequenceNumber) < olderPackets) {
+            receivedOlderPackets++;
+        }
+
+        entry = entry->next;
+    }
+
+    LC_ASSERT(receivedOlderPackets <= olderPackets);
+    return olderPackets - receivedOlderPackets;
 }
 
 #define PACKET_RECOVERY_FAILURE()                     \
@@ -208,16 +282,19 @@ static int reconstructFrame(PRTP_VIDEO_QUEUE queue) {
     LC_ASSERT(totalPackets - neededPackets <= queue->bufferParityPackets);
 
     if (queue->pendingFecBlockList.count < neededPackets) {
-        // If we've never received OOS data from this host, we can predict whether this frame will be recoverable
-        // based on the packets we've received (or not) so far. If the number of missing shards exceeds the total
-        // needed shards, there is no hope of recovering the data. The only way we could recover this frame is by
-        // receiving OOS data, which is unlikely because we've not seen any recently from this host.
-        if (!queue->reportedLostFrame && !queue->receivedOosData) {
+        // We can predict whether this frame will be recoverable based on the packets we've received (or not)
+        // so far. If the number of missing shards exceeds the total needed shards, the only way we could recover
+        // this frame is by receiving OOS data. We only predict a loss if enough of the missing shards are further
+        // behind than the reordering we've seen recently from this host.
+        if (!queue->reportedLostFrame) {
             // NB: We use totalPackets - neededPackets instead of just bufferParityPackets here because we require
             // one extra parity shard for recovery if we're in FEC validation mode.
             if (queue->missingPackets > totalPackets - neededPackets) {
-                notifyFrameLost(queue->currentFrameNumber, true);
-                queue->reportedLostFrame = true;
+                if (getMissingPacketsBeyondReorderTolerance(queue) > totalPackets - neededPackets) {
+                    notifyFrameLost(queue->currentFrameNumber, true);
+                    queue->reportedLostFrame = true;
+                    queue->reportedSpeculativeLoss = true;
+                }
             }
             else {
                 // Assert that there are enough remaining packets to possibly recover this frame.
@@ -232,12 +309,14 @@ static int reconstructFrame(PRTP_VIDEO_QUEUE queue) {
     // If we make it here and reported a lost frame, we lied to the host. This can happen if we happen to get
     // unlucky and this particular frame happens to be the one with OOS data, but it should almost never happen.
     LC_ASSERT(queue->missingPackets <= queue->bufferParityPackets);
-    LC_ASSERT(!queue->reportedLostFrame || queue->receivedOosData);
-    if (queue->reportedLostFrame && !queue->receivedOosData) {
-        // If it turns out that we lied to the host, stop further speculative RFI requests for a while.
-        queue->receivedOosData = true;
-        queue->lastOosFramePresentationTimestamp = queue->pendingFecBlockList.head->presentationTimeUs;
-        Limelog("Leaving speculative RFI mode due to incorrect loss prediction of frame %u\n", queue->currentFrameNumber);
+    LC_ASSERT(!queue->reportedLostFrame || queue->reportedSpeculativeLoss);
+    if (queue->reportedSpeculativeLoss) {
+        // If it turns out that we lied to the host, the late packets that proved us wrong
+        // have already widened our reorder tolerance for future predictions.
+        queue->stats.speculativeRfiIncorrect++;
+        queue->reportedSpeculativeLoss = false;
+        Limelog("Incorrect loss prediction of frame %u (reorder tolerance: %u packets)\n",
+                queue->currentFrameNumber, queue->reorderTolerance);
     }
 
 #ifdef FEC_VALIDATION_MODE
@@ -541,7 +620,10 @@ uint32_t RtpvGetCurrentFrameNumber(PRTP_VIDEO_QUEUE queue) {
     return queue->currentFrameNumber;
 }
 
-int RtpvAddPacket(PRTP_VIDEO_QUEUE queue, PRTP_PACKET packet, int length, PRTPV_QUEUE_ENTRY packetEntry) {
+int RtpvAddPacket(PRTP_VIDEO_QUEUE queue, PRTP_PACKET packet, int length, uint64_t receiveTimeUs, PRTPV_QUEUE_ENTRY packetEntry) {
+    trackPacketReordering(queue, packet);
+    bandwidthEstimatorAddPacket(packet->sequenceNumber, packet->timestamp, length, receiveTimeUs);
+
     if (isBefore16(packet->sequenceNumber, queue->nextContiguousSequenceNumber)) {
         // Reject packets behind our current buffer window
         return RTPF_RET_REJECTED;
@@ -593,10 +675,24 @@ int RtpvAddPacket(PRTP_VIDEO_QUEUE queue, PRTP_PACKET packet, int length, PRTPV_
     // if we can't finish a frame before receiving the next one.
     if (queue->pendingFecBlockList.count == 0 || queue->currentFrameNumber != nvPacket->frameIndex ||
             queue->multiFecCurrentBlockNumber != fecCurrentBlockNumber) {
+        // Feed the outcome of the previous FEC block to the quality estimator
+        if (!queue->reportedBlockQuality) {
+            connectionQualityFecBlockFinished(queue->bufferDataPackets, queue->bufferParityPackets,
+                                              queue->receivedDataPackets, queue->receivedParityPackets,
+                                              queue->pendingFecBlockList.count == 0);
+            queue->reportedBlockQuality = true;
+        }
+
         if (queue->pendingFecBlockList.count != 0) {
             // Report the final status of the FEC queue before dropping this frame
             reportFinalFrameFecStatus(queue);
 
+            // If we predicted this, our prediction was correct
+            if (queue->reportedSpeculativeLoss) {
+                queue->stats.speculativeRfiCorrect++;
+                queue->reportedSpeculativeLoss = false;
+            }
+
             if (queue->multiFecLastBlockNumber != 0) {
                 Limelog("Unrecoverable frame %d (block %d of %d): %d+%d=%d received < %d needed\n",
                         queue->currentFrameNumber, queue->multiFecCurrentBlockNumber+1,
@@ -692,7 +788,10 @@ int RtpvAddPacket(PRTP_VIDEO_QUEUE queue, PRTP_PACKET packet, int length, PRTPV_
         // being able to reconstruct a full frame from it.
         connectionSawFrame(queue->currentFrameNumber);
 
-        queue->bufferFirstRecvTimeUs = PltGetMicroseconds();
+        queue->bufferFirstRecvTimeUs = receiveTimeUs;
+        if (fecCurrentBlockNumber == 0) {
+            connectionQualityFrameArrived(packet->timestamp, queue->bufferFirstRecvTimeUs);
+        }
         queue->bufferLowestSequenceNumber = U16(packet->sequenceNumber - fecIndex);
         queue->nextContiguousSequenceNumber = queue->bufferLowestSequenceNumber;
         queue->receivedDataPackets = 0;
@@ -701,6 +800,8 @@ int RtpvAddPacket(PRTP_VIDEO_QUEUE queue, PRTP_PACKET packet, int length, PRTPV_
         queue->missingPackets = 0;
         queue->useFastQueuePath = true;
         queue->reportedLostFrame = false;
+        queue->reportedSpeculativeLoss = false;
+        queue->reportedBlockQuality = false;
         queue->bufferDataPackets = (nvPacket->fecInfo & 0xFFC00000) >> 22;
         queue->fecPercentage = (nvPacket->fecInfo & 0xFF0) >> 4;
         queue->bufferParityPackets = (queue->bufferDataPackets * queue->fecPercentage + 99) / 100;
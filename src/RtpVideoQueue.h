@@ -13,6 +13,9 @@ typedef struct _RTPV_QUEUE_ENTRY {
     bool isParity;
 } RTPV_QUEUE_ENTRY, *PRTPV_QUEUE_ENTRY;
 
+// Reordering depths at or above the last bucket are counted in the last bucket
+#define RTPV_REORDER_DEPTH_BUCKETS 64
+
 typedef struct _RTPV_QUEUE_LIST {
     PRTPV_QUEUE_ENTRY head;
     PRTPV_QUEUE_ENTRY tail;
@@ -37,6 +40,8 @@ typedef struct _RTP_VIDEO_QUEUE {
     uint32_t missingPackets; // # of holes behind receivedHighestSequenceNumber
     bool useFastQueuePath;
     bool reportedLostFrame;
+    bool reportedSpeculativeLoss;
+    bool reportedBlockQuality;
 
     uint32_t currentFrameNumber;
 
@@ -44,8 +49,15 @@ typedef struct _RTP_VIDEO_QUEUE {
     uint8_t multiFecCurrentBlockNumber;
     uint8_t multiFecLastBlockNumber;
 
-    uint64_t lastOosFramePresentationTimestamp;
-    bool receivedOosData;
+    // Histogram of how far behind the highest sequence number late packets arrive. We
+    // only predict a frame is lost if the missing packets are deeper than we expect
+    // any reordered packets to be.
+    uint32_t reorderDepthHistogram[RTPV_REORDER_DEPTH_BUCKETS];
+    uint32_t reorderSampleCount;
+    uint32_t reorderTolerance;
+    uint32_t reorderHighestSequenceNumber;
+    bool reorderHighestSequenceNumberValid;
+    uint64_t lastOosPresentationTimeUs;
 
     RTP_VIDEO_STATS stats; // the above values are short-lived, this tracks stats for the life of the queue
 } RTP_VIDEO_QUEUE, *PRTP_VIDEO_QUEUE;
@@ -55,6 +67,6 @@ typedef struct _RTP_VIDEO_QUEUE {
 
 void RtpvInitializeQueue(PRTP_VIDEO_QUEUE queue);
 void RtpvCleanupQueue(PRTP_VIDEO_QUEUE queue);
-int RtpvAddPacket(PRTP_VIDEO_QUEUE queue, PRTP_PACKET packet, int length, PRTPV_QUEUE_ENTRY packetEntry);
+int RtpvAddPacket(PRTP_VIDEO_QUEUE queue, PRTP_PACKET packet, int length, uint64_t receiveTimeUs, PRTPV_QUEUE_ENTRY packetEntry);
 uint32_t RtpvGetCurrentFrameNumber(PRTP_VIDEO_QUEUE queue);
 void RtpvSubmitQueuedPackets(PRTP_VIDEO_QUEUE queue);
@@ -0,0 +1,260 @@
+#include "SpscRingQueue.h"
+
+// The consumer spins for a while before parking on the condition variable. The spin
+// limit adapts to how often spinning succeeds, so a consumer that is usually slower
+// than the producer doesn't waste CPU time spinning.
+#define SRQ_MIN_SPIN_COUNT 16
+#define SRQ_MAX_SPIN_COUNT 4096
+
+int SrqInitializeQueue(PSPSC_RING_QUEUE queue, int sizeBound) {
+    uint32_t capacity;
+    int err;
+
+    LC_ASSERT(sizeBound > 0);
+
+    memset(queue, 0, sizeof(*queue));
+
+    // Round the capacity up to a power of 2 so we can mask the indexes
+    capacity = 1;
+    while (capacity < (uint32_t)sizeBound) {
+        capacity <<= 1;
+    }
+
+    queue->slots = calloc(capacity, sizeof(*queue->slots));
+    if (queue->slots == NULL) {
+        return -1;
+    }
+
+    err = PltCreateMutex(&queue->mutex);
+    if (err != 0) {
+        free((void*)queue->slots);
+        return err;
+    }
+
+    err = PltCreateConditionVariable(&queue->cond, &queue->mutex);
+    if (err != 0) {
+        PltDeleteMutex(&queue->mutex);
+        free((void*)queue->slots);
+        return err;
+    }
+
+    queue->mask = capacity - 1;
+    queue->sizeBound = (uint32_t)sizeBound;
+    queue->spinLimit = SRQ_MIN_SPIN_COUNT;
+
+    return 0;
+}
+
+// The caller must reclaim any remaining items before destroying the queue
+void SrqDestroyQueue(PSPSC_RING_QUEUE queue) {
+    LC_ASSERT(SrqGetItemCount(queue) == 0);
+
+    PltDeleteMutex(&queue->mutex);
+    PltDeleteConditionVariable(&queue->cond);
+    free((void*)queue->slots);
+}
+
+static void signalConsumer(PSPSC_RING_QUEUE queue) {
+    // Taking the mutex ensures the consumer is either already waiting on
+    // the condition variable or has not yet checked the queue state.
+    PltLockMutex(&queue->mutex);
+    PltSignalConditionVariable(&queue->cond);
+    PltUnlockMutex(&queue->mutex);
+}
+
+void SrqSignalQueueShutdown(PSPSC_RING_QUEUE queue) {
+    PltAtomicStore32(&queue->shutdown, 1);
+    signalConsumer(queue);
+}
+
+void SrqSignalQueueDrain(PSPSC_RING_QUEUE queue) {
+    PltAtomicStore32(&queue->draining, 1);
+    signalConsumer(queue);
+}
+
+void SrqSignalQueueUserWake(PSPSC_RING_QUEUE queue) {
+    PltAtomicStore32(&queue->pendingUserWake, 1);
+    signalConsumer(queue);
+}
+
+int SrqGetItemCount(PSPSC_RING_QUEUE queue) {
+    uint32_t head = PltAtomicLoad32(&queue->head);
+    uint32_t tail = PltAtomicLoad32(&queue->tail);
+
+    // A peeked item is still waiting to be dequeued
+    return (int)(tail - head) + (PltAtomicLoadPtr(&queue->peekedItem) != NULL ? 1 : 0);
+}
+
+// This must only be called by the producer
+int SrqOfferQueueItem(PSPSC_RING_QUEUE queue, void* data) {
+    uint32_t tail;
+
+    if (PltAtomicLoad32(&queue->shutdown) || PltAtomicLoad32(&queue->draining)) {
+        return LBQ_INTERRUPTED;
+    }
+
+    tail = queue->tail;
+    if ((uint32_t)SrqGetItemCount(queue) >= queue->sizeBound) {
+        return LBQ_BOUND_EXCEEDED;
+    }
+
+    // Publish the item before advancing the tail
+    queue->slots[tail & queue->mask] = data;
+    PltAtomicStore32(&queue->tail, tail + 1);
+
+    // Only pay for the wakeup if the consumer has parked
+    if (PltAtomicLoad32(&queue->consumerParked)) {
+        signalConsumer(queue);
+    }
+
+    return LBQ_SUCCESS;
+}
+
+static bool tryDequeueFromRing(PSPSC_RING_QUEUE queue, void** data) {
+    for (;;) {
+        uint32_t head = PltAtomicLoad32(&queue->head);
+        void* item;
+
+        if (head == PltAtomicLoad32(&queue->tail)) {
+            return false;
+        }
+
+        // If another thread dequeues this item before us, the CAS will fail
+        // and we'll retry with the new head index.
+        item = queue->slots[head & queue->mask];
+        if (PltAtomicCompareExchange32(&queue->head, head, head + 1)) {
+            *data = item;
+            return true;
+        }
+    }
+}
+
+// This must only be called by the consumer
+static bool tryDequeue(PSPSC_RING_QUEUE queue, void** data) {
+    // Anything we peeked at is older than the items in the ring
+    void* item = PltAtomicLoadPtr(&queue->peekedItem);
+    if (item != NULL) {
+        PltAtomicStorePtr(&queue->peekedItem, NULL);
+        *data = item;
+        return true;
+    }
+
+    return tryDequeueFromRing(queue, data);
+}
+
+// Removes an item regardless of the queue state. This is safe to call
+// from the producer to flush items that the consumer has not taken yet.
+// Items held by SrqPeekQueueElement() are not reclaimed.
+bool SrqReclaimQueueElement(PSPSC_RING_QUEUE queue, void** data) {
+    return tryDequeueFromRing(queue, data);
+}
+
+// Removes the item held by SrqPeekQueueElement(), if any. This must only
+// be called after the consumer has stopped using the queue.
+bool SrqReclaimPeekedElement(PSPSC_RING_QUEUE queue, void** data) {
+    void* item = PltAtomicLoadPtr(&queue->peekedItem);
+    if (item == NULL) {
+        return false;
+    }
+
+    PltAtomicStorePtr(&queue->peekedItem, NULL);
+    *data = item;
+    return true;
+}
+
+// This must only be called by the consumer. The returned item remains valid
+// until the consumer dequeues it, since the producer can't reclaim it.
+int SrqPeekQueueElement(PSPSC_RING_QUEUE queue, void** data) {
+    void* item;
+
+    if (PltAtomicLoad32(&queue->shutdown)) {
+        return LBQ_INTERRUPTED;
+    }
+
+    item = PltAtomicLoadPtr(&queue->peekedItem);
+    if (item == NULL) {
+        if (!tryDequeueFromRing(queue, &item)) {
+            return PltAtomicLoad32(&queue->draining) ? LBQ_INTERRUPTED : LBQ_NO_ELEMENT;
+        }
+
+        // Hold the item ourselves so it can't be reclaimed
+        PltAtomicStorePtr(&queue->peekedItem, item);
+    }
+
+    *data = item;
+    return LBQ_SUCCESS;
+}
+
+int SrqPollQueueElement(PSPSC_RING_QUEUE queue, void** data) {
+    if (PltAtomicLoad32(&queue->shutdown)) {
+        return LBQ_INTERRUPTED;
+    }
+
+    if (tryDequeue(queue, data)) {
+        return LBQ_SUCCESS;
+    }
+
+    return PltAtomicLoad32(&queue->draining) ? LBQ_INTERRUPTED : LBQ_NO_ELEMENT;
+}
+
+// Returns LBQ_NO_ELEMENT if the caller should keep waiting
+static int tryWaitingDequeue(PSPSC_RING_QUEUE queue, void** data) {
+    // If we're shutting down, abort immediately, even if there's data available
+    if (PltAtomicLoad32(&queue->shutdown)) {
+        return LBQ_INTERRUPTED;
+    }
+
+    // If this is a user requested wake, process it now
+    if (PltAtomicLoad32(&queue->pendingUserWake)) {
+        PltAtomicStore32(&queue->pendingUserWake, 0);
+        return LBQ_USER_WAKE;
+    }
+
+    if (tryDequeue(queue, data)) {
+        return LBQ_SUCCESS;
+    }
+
+    // If we're draining, only abort if we have no data available
+    if (PltAtomicLoad32(&queue->draining)) {
+        return LBQ_INTERRUPTED;
+    }
+
+    return LBQ_NO_ELEMENT;
+}
+
+int SrqWaitForQueueElement(PSPSC_RING_QUEUE queue, void** data) {
+    int err;
+
+    // Spin first, since the producer will often hand us an item very soon
+    for (uint32_t i = 0; i < queue->spinLimit; i++) {
+        err = tryWaitingDequeue(queue, data);
+        if (err != LBQ_NO_ELEMENT) {
+            // Spinning paid off, so allow a little more spinning next time
+            if (err == LBQ_SUCCESS && queue->spinLimit < SRQ_MAX_SPIN_COUNT) {
+                queue->spinLimit <<= 1;
+            }
+            return err;
+        }
+
+        PltCpuRelax();
+    }
+
+    // Spinning didn't work, so spin less next time
+    if (queue->spinLimit > SRQ_MIN_SPIN_COUNT) {
+        queue->spinLimit >>= 1;
+    }
+
+    PltLockMutex(&queue->mutex);
+
+    // The producer checks this flag after publishing an item, and we check for an
+    // item after setting this flag, so at least one of us will see the other.
+    PltAtomicStore32(&queue->consumerParked, 1);
+    while ((err = tryWaitingDequeue(queue, data)) == LBQ_NO_ELEMENT) {
+        PltWaitForConditionVariable(&queue->cond, &queue->mutex);
+    }
+    PltAtomicStore32(&queue->consumerParked, 0);
+
+    PltUnlockMutex(&queue->mutex);
+
+    return err;
+}
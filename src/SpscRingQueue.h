@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Platform.h"
+#include "PlatformThreads.h"
+#include "PlatformAtomics.h"
+#include "LinkedBlockingQueue.h"
+
+// A bounded ring queue with a single producer and a lock-free fast path. Items are
+// dequeued by compare-and-swap on the head index, which allows the producer to
+// reclaim queued items (to flush the queue) while the consumer is dequeuing.
+//
+// Peeking moves the head item into a slot owned by the consumer, so the producer
+// can't reclaim it while the consumer is looking at it. The next dequeue by the
+// consumer returns that item first.
+//
+// This uses the same LBQ_* return codes as the LinkedBlockingQueue.
+typedef struct _SPSC_RING_QUEUE {
+    void* volatile* slots;
+    uint32_t mask;
+    uint32_t sizeBound;
+
+    // Index of the next item to dequeue. Advanced by CAS.
+    volatile uint32_t head;
+
+    // Index of the next free slot. Only written by the producer.
+    volatile uint32_t tail;
+
+    // Item held by SrqPeekQueueElement(). Only written by the consumer.
+    void* volatile peekedItem;
+
+    // Number of spin iterations the consumer will do before parking
+    uint32_t spinLimit;
+
+    volatile uint32_t consumerParked;
+    volatile uint32_t shutdown;
+    volatile uint32_t draining;
+    volatile uint32_t pendingUserWake;
+
+    PLT_MUTEX mutex;
+    PLT_COND cond;
+} SPSC_RING_QUEUE, *PSPSC_RING_QUEUE;
+
+int SrqInitializeQueue(PSPSC_RING_QUEUE queue, int sizeBound);
+void SrqDestroyQueue(PSPSC_RING_QUEUE queue);
+int SrqOfferQueueItem(PSPSC_RING_QUEUE queue, void* data);
+int SrqWaitForQueueElement(PSPSC_RING_QUEUE queue, void** data);
+int SrqPollQueueElement(PSPSC_RING_QUEUE queue, void** data);
+int SrqPeekQueueElement(PSPSC_RING_QUEUE queue, void** data);
+bool SrqReclaimQueueElement(PSPSC_RING_QUEUE queue, void** data);
+bool SrqReclaimPeekedElement(PSPSC_RING_QUEUE queue, void** data);
+void SrqSignalQueueShutdown(PSPSC_RING_QUEUE queue);
+void SrqSignalQueueDrain(PSPSC_RING_QUEUE queue);
+void SrqSignalQueueUserWake(PSPSC_RING_QUEUE queue);
+int SrqGetItemCount(PSPSC_RING_QUEUE queue);
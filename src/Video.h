@@ -4,7 +4,6 @@
 
 typedef struct _QUEUED_DECODE_UNIT {
     DECODE_UNIT decodeUnit;
-    LINKED_BLOCKING_QUEUE_ENTRY entry;
 } QUEUED_DECODE_UNIT, *PQUEUED_DECODE_UNIT;
 
 #pragma pack(push, 1)
@@ -16,6 +16,7 @@ static unsigned int lastPacketInStream;
 static bool decodingFrame;
 static int frameType;
 static uint16_t lastPacketPayloadLength;
+static bool av1ReducedStillPictureHeader;
 static bool strictIdrFrameWait;
 static uint64_t syntheticPtsBaseUs;
 static uint16_t frameHostProcessingLatency;
@@ -30,7 +31,31 @@ static bool idrFrameProcessed;
 #define CONSECUTIVE_DROP_LIMIT 120
 static unsigned int consecutiveFrameDrops;
 
-static LINKED_BLOCKING_QUEUE decodeUnitQueue;
+#define DECODE_UNIT_QUEUE_BOUND 15
+static SPSC_RING_QUEUE decodeUnitQueue;
+static LATENCY_HISTOGRAM handoffLatencyHistogram;
+
+// Enqueue times of the most recently queued decode units. This allows us to
+// determine the age of the oldest queued frame without touching queue entries
+// that may be concurrently dequeued and freed by the consumer.
+#define DU_ENQUEUE_HISTORY_SIZE 16
+static uint64_t duEnqueueTimeHistory[DU_ENQUEUE_HISTORY_SIZE];
+static unsigned int duEnqueueCount;
+
+#define DEFAULT_VIDEO_QUEUE_MAX_LATENCY_MS 50
+static uint64_t maxQueueLatencyUs;
+
+// Queued frames are only discarded when an IDR frame arrives that doesn't reference
+// them. With VIDEO_QUEUE_POLICY_BOUNDED_LATENCY, we ask for one when the oldest frame
+// misses the deadline, but no more often than this so a renderer that can never keep
+// up doesn't turn into a stream of IDR frames.
+#define LATENCY_TRIM_MIN_INTERVAL_US 1000000
+static bool latencyTrimPending;
+static uint64_t lastLatencyTrimRequestUs;
+
+// Updated by the receive thread and by decoder refresh requests from other threads,
+// so each counter is modified atomically and read with LiGetVideoQueueStats().
+static VIDEO_QUEUE_STATS videoQueueStats;
 
 typedef struct _BUFFER_DESC {
     char* data;
@@ -41,8 +66,31 @@ typedef struct _BUFFER_DESC {
 typedef struct _LENTRY_INTERNAL {
     LENTRY entry;
     void* allocPtr;
+
+    // For entries that point into another entry's packet buffer, this is the
+    // entry that owns the packet buffer. Otherwise, it is NULL.
+    struct _LENTRY_INTERNAL* packetOwner;
+
+    int sizeClass; // Index into fragmentSizeClasses or -1 if not pooled
+
+    // Number of references to the packet buffer (only valid on the packet owner).
+    // All entries referencing a packet are in the same frame, so they are always
+    // released by the same thread and this doesn't need to be atomic.
+    int refCount;
 } LENTRY_INTERNAL, *PLENTRY_INTERNAL;
 
+// Decode unit holders and copied fragment buffers are returned to these free lists
+// by LiCompleteVideoFrame() and reused by the receive thread, so we don't need to
+// malloc() anything per frame once the stream reaches a steady state. These are
+// lock-free rings, since frames may be completed on any thread.
+#define DECODE_UNIT_FREE_LIST_BOUND 32
+static MPMC_RING_QUEUE decodeUnitFreeList;
+
+#define FRAGMENT_SIZE_CLASS_COUNT 3
+#define FRAGMENT_FREE_LIST_BOUND 64
+static const int fragmentSizeClasses[FRAGMENT_SIZE_CLASS_COUNT] = { 128, 512, 2048 };
+static MPMC_RING_QUEUE fragmentFreeLists[FRAGMENT_SIZE_CLASS_COUNT];
+
 #define H264_NAL_TYPE(x) ((x) & 0x1F)
 #define HEVC_NAL_TYPE(x) (((x) & 0x7E) >> 1)
 
@@ -58,9 +106,49 @@ typedef struct _LENTRY_INTERNAL {
 #define HEVC_NAL_TYPE_FILLER 38
 #define HEVC_NAL_TYPE_SEI 39
 
+#define AV1_OBU_TYPE(x) (((x) & 0x78) >> 3)
+#define AV1_OBU_HAS_EXTENSION(x) ((x) & 0x04)
+#define AV1_OBU_HAS_SIZE_FIELD(x) ((x) & 0x02)
+
+#define AV1_OBU_TYPE_SEQUENCE_HEADER 1
+#define AV1_OBU_TYPE_TEMPORAL_DELIMITER 2
+#define AV1_OBU_TYPE_FRAME_HEADER 3
+#define AV1_OBU_TYPE_FRAME 6
+
+#define AV1_FRAME_TYPE_KEY 0
+#define AV1_FRAME_TYPE_INTER 1
+#define AV1_FRAME_TYPE_INTRA_ONLY 2
+#define AV1_FRAME_TYPE_SWITCH 3
+
 // Init
-void initializeVideoDepacketizer(int pktSize) {
-    LbqInitializeLinkedBlockingQueue(&decodeUnitQueue, 15);
+int initializeVideoDepacketizer(int pktSize) {
+    int err;
+
+    LC_ASSERT(DECODE_UNIT_QUEUE_BOUND < DU_ENQUEUE_HISTORY_SIZE);
+    err = SrqInitializeQueue(&decodeUnitQueue, DECODE_UNIT_QUEUE_BOUND);
+    if (err != 0) {
+        return err;
+    }
+
+    err = MrqInitializeQueue(&decodeUnitFreeList, DECODE_UNIT_FREE_LIST_BOUND);
+    if (err != 0) {
+        SrqDestroyQueue(&decodeUnitQueue);
+        return err;
+    }
+
+    for (int i = 0; i < FRAGMENT_SIZE_CLASS_COUNT; i++) {
+        err = MrqInitializeQueue(&fragmentFreeLists[i], FRAGMENT_FREE_LIST_BOUND);
+        if (err != 0) {
+            while (i-- > 0) {
+                MrqDestroyQueue(&fragmentFreeLists[i]);
+            }
+            MrqDestroyQueue(&decodeUnitFreeList);
+            SrqDestroyQueue(&decodeUnitQueue);
+            return err;
+        }
+    }
+    LhInitializeHistogram(&handoffLatencyHistogram);
+    resetPresentationClock(PRESENTATION_CLOCK_VIDEO);
 
     nextFrameNumber = 1;
     startFrameNumber = 0;
@@ -75,9 +163,103 @@ void initializeVideoDepacketizer(int pktSize) {
     firstPacketPresentationTime = 0;
     firstPacketRtpTimestamp = 0;
     lastPacketPayloadLength = 0;
+    av1ReducedStillPictureHeader = false;
     dropStatePending = false;
     idrFrameProcessed = false;
     strictIdrFrameWait = !isReferenceFrameInvalidationEnabled();
+
+    duEnqueueCount = 0;
+    latencyTrimPending = false;
+    lastLatencyTrimRequestUs = 0;
+    memset(&videoQueueStats, 0, sizeof(videoQueueStats));
+    if (StreamConfig.videoQueueMaxLatencyMs > 0) {
+        maxQueueLatencyUs = (uint64_t)StreamConfig.videoQueueMaxLatencyMs * 1000;
+    }
+    else {
+        maxQueueLatencyUs = DEFAULT_VIDEO_QUEUE_MAX_LATENCY_MS * 1000;
+    }
+
+    return 0;
+}
+
+static PQUEUED_DECODE_UNIT allocateDecodeUnit(void) {
+    PQUEUED_DECODE_UNIT qdu;
+
+    if (MrqPollQueueElement(&decodeUnitFreeList, (void**)&qdu) == LBQ_SUCCESS) {
+        return qdu;
+    }
+
+    return (PQUEUED_DECODE_UNIT)malloc(sizeof(*qdu));
+}
+
+static void freeDecodeUnit(PQUEUED_DECODE_UNIT qdu) {
+    // If the free list is full or shut down, just free it
+    if (MrqOfferQueueItem(&decodeUnitFreeList, qdu) != LBQ_SUCCESS) {
+        free(qdu);
+    }
+}
+
+static PLENTRY_INTERNAL allocateFragment(int length) {
+    PLENTRY_INTERNAL entry;
+
+    for (int i = 0; i < FRAGMENT_SIZE_CLASS_COUNT; i++) {
+        if (length <= fragmentSizeClasses[i]) {
+            if (MrqPollQueueElement(&fragmentFreeLists[i], (void**)&entry) != LBQ_SUCCESS) {
+                entry = (PLENTRY_INTERNAL)malloc(sizeof(*entry) + fragmentSizeClasses[i]);
+                if (entry == NULL) {
+                    return NULL;
+                }
+            }
+
+            entry->sizeClass = i;
+            return entry;
+        }
+    }
+
+    // Too large to pool
+    entry = (PLENTRY_INTERNAL)malloc(sizeof(*entry) + length);
+    if (entry != NULL) {
+        entry->sizeClass = -1;
+    }
+    return entry;
+}
+
+static void releasePacketReference(PLENTRY_INTERNAL packetOwner) {
+    LC_ASSERT(packetOwner->packetOwner == NULL);
+    LC_ASSERT(packetOwner->refCount > 0);
+
+    // The owner entry itself lives inside the packet buffer,
+    // so this frees both of them.
+    if (--packetOwner->refCount == 0) {
+        free(packetOwner->allocPtr);
+    }
+}
+
+// Frees the buffer backing this entry, which is either a packet buffer
+// from the receive thread or a fragment that we allocated ourselves.
+static void freeBufferEntry(PLENTRY_INTERNAL entry) {
+    if (entry->packetOwner != NULL) {
+        // Drop our reference on the packet then free this entry below
+        releasePacketReference(entry->packetOwner);
+    }
+    else if (entry->allocPtr != entry) {
+        releasePacketReference(entry);
+        return;
+    }
+
+    if (entry->sizeClass < 0 ||
+            MrqOfferQueueItem(&fragmentFreeLists[entry->sizeClass], entry) != LBQ_SUCCESS) {
+        free(entry);
+    }
+}
+
+// Frees everything left on a free list
+static void freePooledEntries(PMPMC_RING_QUEUE freeList) {
+    void* data;
+
+    while (MrqReclaimQueueElement(freeList, &data)) {
+        free(data);
+    }
 }
 
 // Free the NAL chain
@@ -87,7 +269,7 @@ static void cleanupFrameState(void) {
     while (nalChainHead != NULL) {
         lastEntry = (PLENTRY_INTERNAL)nalChainHead;
         nalChainHead = lastEntry->entry.next;
-        free(lastEntry->allocPtr);
+        freeBufferEntry(lastEntry);
     }
 
     nalChainTail = NULL;
@@ -124,33 +306,70 @@ static void dropFrameState(void) {
 
         // Request an IDR frame
         waitingForIdrFrame = true;
-        LiRequestIdrFrame();
+        requestIdrFrameForRecovery(LI_RECOVERY_TRIGGER_DROP_LIMIT);
     }
 
     cleanupFrameState();
 }
 
-// Cleanup the list of decode units
-static void freeDecodeUnitList(PLINKED_BLOCKING_QUEUE_ENTRY entry) {
-    PLINKED_BLOCKING_QUEUE_ENTRY nextEntry;
+// Frees all queued decode units and adds them to the specified drop counter.
+// Returns the number of frames dropped and the earliest dropped frame number.
+static void addVideoQueueStat(uint32_t* counter, uint32_t count) {
+    PltAtomicAdd32((volatile uint32_t*)counter, count);
+}
+
+static int flushQueuedDecodeUnits(uint32_t* dropCounter, unsigned int* firstDroppedFrame) {
+    PQUEUED_DECODE_UNIT qdu;
+    int count = 0;
 
-    while (entry != NULL) {
-        nextEntry = entry->flink;
+    while (SrqReclaimQueueElement(&decodeUnitQueue, (void**)&qdu)) {
+        if (count == 0 || isBefore32((unsigned int)qdu->decodeUnit.frameNumber, *firstDroppedFrame)) {
+            *firstDroppedFrame = (unsigned int)qdu->decodeUnit.frameNumber;
+        }
+        count++;
 
         // Complete this with a failure status
-        LiCompleteVideoFrame(entry->data, DR_CLEANUP);
-
-        entry = nextEntry;
+        LiCompleteVideoFrame(qdu, DR_CLEANUP);
     }
+
+    addVideoQueueStat(dropCounter, count);
+    return count;
 }
 
 void stopVideoDepacketizer(void) {
-    LbqSignalQueueShutdown(&decodeUnitQueue);
+    SrqSignalQueueShutdown(&decodeUnitQueue);
+
+    // Stop recycling and release the pooled buffers now. Anything
+    // completed after this point will be freed directly.
+    MrqSignalQueueShutdown(&decodeUnitFreeList);
+    freePooledEntries(&decodeUnitFreeList);
+    for (int i = 0; i < FRAGMENT_SIZE_CLASS_COUNT; i++) {
+        MrqSignalQueueShutdown(&fragmentFreeLists[i]);
+        freePooledEntries(&fragmentFreeLists[i]);
+    }
 }
 
 // Cleanup video depacketizer and free malloced memory
 void destroyVideoDepacketizer(void) {
-    freeDecodeUnitList(LbqDestroyLinkedBlockingQueue(&decodeUnitQueue));
+    PQUEUED_DECODE_UNIT qdu;
+
+    // The consumer may have left a frame held by LiPeekNextVideoFrame()
+    if (SrqReclaimPeekedElement(&decodeUnitQueue, (void**)&qdu)) {
+        LiCompleteVideoFrame(qdu, DR_CLEANUP);
+    }
+    while (SrqReclaimQueueElement(&decodeUnitQueue, (void**)&qdu)) {
+        // Complete this with a failure status
+        LiCompleteVideoFrame(qdu, DR_CLEANUP);
+    }
+    SrqDestroyQueue(&decodeUnitQueue);
+
+    // Anything offered while we were stopping must be freed before destroying the lists
+    freePooledEntries(&decodeUnitFreeList);
+    MrqDestroyQueue(&decodeUnitFreeList);
+    for (int i = 0; i < FRAGMENT_SIZE_CLASS_COUNT; i++) {
+        freePooledEntries(&fragmentFreeLists[i]);
+        MrqDestroyQueue(&fragmentFreeLists[i]);
+    }
     cleanupFrameState();
 }
 
@@ -215,8 +434,10 @@ void validateDecodeUnitForPlayback(PDECODE_UNIT decodeUnit) {
             LC_ASSERT_VT(decodeUnit->bufferList->next->next->next != NULL);
         }
         else if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_AV1) {
-            // We don't parse the AV1 bitstream
-            LC_ASSERT_VT(decodeUnit->bufferList->bufferType == BUFFER_TYPE_PICDATA);
+            // AV1 key frames should start with a sequence header, but we may
+            // also get here if the host flagged a frame we couldn't parse.
+            LC_ASSERT_VT(decodeUnit->bufferList->bufferType == BUFFER_TYPE_SPS ||
+                         decodeUnit->bufferList->bufferType == BUFFER_TYPE_PICDATA);
         }
         else {
             LC_ASSERT(false);
@@ -236,11 +457,13 @@ void validateDecodeUnitForPlayback(PDECODE_UNIT decodeUnit) {
 bool LiWaitForNextVideoFrame(VIDEO_FRAME_HANDLE* frameHandle, PDECODE_UNIT* decodeUnit) {
     PQUEUED_DECODE_UNIT qdu;
 
-    int err = LbqWaitForQueueElement(&decodeUnitQueue, (void**)&qdu);
+    int err = SrqWaitForQueueElement(&decodeUnitQueue, (void**)&qdu);
     if (err != LBQ_SUCCESS) {
         return false;
     }
 
+    LhAddSample(&handoffLatencyHistogram, PltGetMicroseconds() - qdu->decodeUnit.enqueueTimeUs);
+
     validateDecodeUnitForPlayback(&qdu->decodeUnit);
 
     *frameHandle = qdu;
@@ -251,11 +474,13 @@ bool LiWaitForNextVideoFrame(VIDEO_FRAME_HANDLE* frameHandle, PDECODE_UNIT* deco
 bool LiPollNextVideoFrame(VIDEO_FRAME_HANDLE* frameHandle, PDECODE_UNIT* decodeUnit) {
     PQUEUED_DECODE_UNIT qdu;
 
-    int err = LbqPollQueueElement(&decodeUnitQueue, (void**)&qdu);
+    int err = SrqPollQueueElement(&decodeUnitQueue, (void**)&qdu);
     if (err != LBQ_SUCCESS) {
         return false;
     }
 
+    LhAddSample(&handoffLatencyHistogram, PltGetMicroseconds() - qdu->decodeUnit.enqueueTimeUs);
+
     validateDecodeUnitForPlayback(&qdu->decodeUnit);
 
     *frameHandle = qdu;
@@ -266,7 +491,7 @@ bool LiPollNextVideoFrame(VIDEO_FRAME_HANDLE* frameHandle, PDECODE_UNIT* decodeU
 bool LiPeekNextVideoFrame(PDECODE_UNIT* decodeUnit) {
     PQUEUED_DECODE_UNIT qdu;
 
-    int err = LbqPeekQueueElement(&decodeUnitQueue, (void**)&qdu);
+    int err = SrqPeekQueueElement(&decodeUnitQueue, (void**)&qdu);
     if (err != LBQ_SUCCESS) {
         return false;
     }
@@ -278,7 +503,7 @@ bool LiPeekNextVideoFrame(PDECODE_UNIT* decodeUnit) {
 }
 
 void LiWakeWaitForVideoFrame(void) {
-    LbqSignalQueueUserWake(&decodeUnitQueue);
+    SrqSignalQueueUserWake(&decodeUnitQueue);
 }
 
 // Cleanup a decode unit by freeing the buffer chain and the holder
@@ -299,12 +524,12 @@ void LiCompleteVideoFrame(VIDEO_FRAME_HANDLE handle, int drStatus) {
     while (qdu->decodeUnit.bufferList != NULL) {
         lastEntry = (PLENTRY_INTERNAL)qdu->decodeUnit.bufferList;
         qdu->decodeUnit.bufferList = lastEntry->entry.next;
-        free(lastEntry->allocPtr);
+        freeBufferEntry(lastEntry);
     }
 
     // We will have stack-allocated entries iff we have a direct-submit decoder
     if ((VideoCallbacks.capabilities & CAPABILITY_DIRECT_SUBMIT) == 0) {
-        free(qdu);
+        freeDecodeUnit(qdu);
     }
 }
 
@@ -465,6 +690,283 @@ static bool isIdrFrameStart(PBUFFER_DESC buffer) {
     }
 }
 
+// Reads the AV1 OBU at the start of the buffer and advances the buffer past it. If the
+// OBU extends past the end of the buffer, the payload is truncated and the buffer is
+// advanced to the end. Returns false if the data doesn't look like an OBU header.
+static bool getNextAv1Obu(PBUFFER_DESC buffer, int* obuType, PBUFFER_DESC payload, bool* truncated) {
+    unsigned int headerLength;
+    uint64_t payloadLength;
+    uint8_t header;
+
+    if (buffer->length == 0) {
+        return false;
+    }
+
+    header = (uint8_t)buffer->data[buffer->offset];
+
+    // The forbidden bit must be clear, and we need the size field to find the next OBU
+    if ((header & 0x80) || !AV1_OBU_HAS_SIZE_FIELD(header)) {
+        return false;
+    }
+
+    headerLength = AV1_OBU_HAS_EXTENSION(header) ? 2 : 1;
+
+    // The OBU size is leb128 encoded
+    payloadLength = 0;
+    for (int i = 0;; i++) {
+        uint8_t sizeByte;
+
+        if (i == 8 || headerLength >= buffer->length) {
+            return false;
+        }
+
+        sizeByte = (uint8_t)buffer->data[buffer->offset + headerLength++];
+        payloadLength |= (uint64_t)(sizeByte & 0x7F) << (i * 7);
+        if (!(sizeByte & 0x80)) {
+            break;
+        }
+    }
+
+    *truncated = payloadLength > buffer->length - headerLength;
+    if (*truncated) {
+        payloadLength = buffer->length - headerLength;
+    }
+
+    *obuType = AV1_OBU_TYPE(header);
+    payload->data = buffer->data;
+    payload->offset = buffer->offset + headerLength;
+    payload->length = (unsigned int)payloadLength;
+
+    buffer->offset += headerLength + (unsigned int)payloadLength;
+    buffer->length -= headerLength + (unsigned int)payloadLength;
+    return true;
+}
+
+// Returns the frame_type from an AV1 frame header or -1 if no new frame is coded
+static int getAv1FrameType(PBUFFER_DESC frameHeader) {
+    uint8_t firstByte;
+
+    // Reduced still picture headers only contain key frames
+    if (av1ReducedStillPictureHeader) {
+        return AV1_FRAME_TYPE_KEY;
+    }
+
+    if (frameHeader->length == 0) {
+        return -1;
+    }
+
+    firstByte = (uint8_t)frameHeader->data[frameHeader->offset];
+
+    // show_existing_frame just redisplays an older frame
+    if (firstByte & 0x80) {
+        return -1;
+    }
+
+    // frame_type immediately follows show_existing_frame
+    return (firstByte >> 5) & 0x3;
+}
+
+// Parses the OBUs at the start of an AV1 temporal unit to find the length of the
+// leading temporal delimiter and sequence header OBUs (0 if there is no sequence
+// header) and the type of the first frame in the temporal unit.
+static void parseAv1TemporalUnitStart(PBUFFER_DESC buffer, unsigned int* seqHeaderLength, int* firstFrameType) {
+    BUFFER_DESC currentPos = *buffer;
+    BUFFER_DESC payload;
+    int obuType;
+    bool truncated;
+
+    *seqHeaderLength = 0;
+    *firstFrameType = -1;
+
+    while (getNextAv1Obu(&currentPos, &obuType, &payload, &truncated)) {
+        switch (obuType) {
+        case AV1_OBU_TYPE_TEMPORAL_DELIMITER:
+            break;
+
+        case AV1_OBU_TYPE_SEQUENCE_HEADER:
+            if (truncated || payload.length == 0) {
+                return;
+            }
+
+            // seq_profile (3 bits), still_picture (1 bit), reduced_still_picture_header (1 bit)
+            av1ReducedStillPictureHeader = (payload.data[payload.offset] & 0x08) != 0;
+            *seqHeaderLength = currentPos.offset - buffer->offset;
+            break;
+
+        case AV1_OBU_TYPE_FRAME_HEADER:
+        case AV1_OBU_TYPE_FRAME:
+            *firstFrameType = getAv1FrameType(&payload);
+            return;
+
+        default:
+            // Skip metadata, padding, and anything else that precedes the frame
+            break;
+        }
+
+        if (truncated) {
+            return;
+        }
+    }
+}
+
+// Returns true if the oldest queued frame has waited longer than videoQueueMaxLatencyMs
+static bool isQueueLatencyExceeded(uint64_t nowUs, int queuedFrames) {
+    // Frames are dequeued in FIFO order, so the oldest queued frame is
+    // the one that we queued queuedFrames queue operations ago.
+    LC_ASSERT(queuedFrames <= DECODE_UNIT_QUEUE_BOUND);
+    return nowUs - duEnqueueTimeHistory[(duEnqueueCount - queuedFrames) % DU_ENQUEUE_HISTORY_SIZE] >= maxQueueLatencyUs;
+}
+
+// Returns the drop counter for the reason that queued frames should be discarded
+// before queuing this frame, or NULL if they must be kept. P-frames may reference
+// any queued frame, so only an IDR frame can replace the frames ahead of it.
+static uint32_t* getQueuePolicyDropCounter(PQUEUED_DECODE_UNIT qdu) {
+    uint64_t nowUs = qdu->decodeUnit.enqueueTimeUs;
+    bool idrFrame = qdu->decodeUnit.frameType == FRAME_TYPE_IDR;
+    int queuedFrames = SrqGetItemCount(&decodeUnitQueue);
+    uint32_t* dropCounter = NULL;
+    bool budgetExceeded;
+
+    switch (StreamConfig.videoQueuePolicy) {
+    case VIDEO_QUEUE_POLICY_LATEST_FRAME_ONLY:
+    case VIDEO_QUEUE_POLICY_BOUNDED_LATENCY:
+        // Latest frame only is bounded latency with no latency budget at all
+        if (StreamConfig.videoQueuePolicy == VIDEO_QUEUE_POLICY_LATEST_FRAME_ONLY) {
+            budgetExceeded = queuedFrames != 0;
+        }
+        else {
+            budgetExceeded = queuedFrames != 0 && isQueueLatencyExceeded(nowUs, queuedFrames);
+        }
+
+        if (queuedFrames != 0 && (latencyTrimPending || budgetExceeded)) {
+            if (idrFrame) {
+                dropCounter = StreamConfig.videoQueuePolicy == VIDEO_QUEUE_POLICY_LATEST_FRAME_ONLY ?
+                    &videoQueueStats.framesDroppedSuperseded : &videoQueueStats.framesDroppedLatency;
+            }
+            else if (!latencyTrimPending &&
+                     (lastLatencyTrimRequestUs == 0 || nowUs - lastLatencyTrimRequestUs >= LATENCY_TRIM_MIN_INTERVAL_US)) {
+                // Keep queuing frames until the IDR frame arrives, since the
+                // decoder needs them to decode anything before it.
+                Limelog("Requesting IDR frame to trim the video frame queue\n");
+                latencyTrimPending = true;
+                lastLatencyTrimRequestUs = nowUs;
+                addVideoQueueStat(&videoQueueStats.idrRecoveries, 1);
+                requestIdrFrameForRecovery(LI_RECOVERY_TRIGGER_QUEUE_DROP);
+            }
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    // Any IDR frame satisfies a pending trim, even if the queue drained on its own
+    if (idrFrame) {
+        latencyTrimPending = false;
+    }
+
+    return dropCounter;
+}
+
+static int offerDecodeUnit(PQUEUED_DECODE_UNIT qdu) {
+    int err = SrqOfferQueueItem(&decodeUnitQueue, qdu);
+    if (err == LBQ_SUCCESS) {
+        duEnqueueTimeHistory[duEnqueueCount++ % DU_ENQUEUE_HISTORY_SIZE] = qdu->decodeUnit.enqueueTimeUs;
+    }
+    return err;
+}
+
+// Frees a decode unit that never made it into the queue along with its buffers
+static void discardDecodeUnit(PQUEUED_DECODE_UNIT qdu) {
+    nalChainHead = qdu->decodeUnit.bufferList;
+    nalChainDataLength = qdu->decodeUnit.fullLength;
+    cleanupFrameState();
+    freeDecodeUnit(qdu);
+}
+
+// Queues a decode unit for the decoder thread or pull renderer while enforcing the
+// configured queue policy. Returns false if the frame was dropped instead.
+static bool queueDecodeUnit(PQUEUED_DECODE_UNIT qdu) {
+    unsigned int frameNumber = (unsigned int)qdu->decodeUnit.frameNumber;
+    unsigned int firstDroppedFrame = frameNumber;
+    uint32_t* dropCounter;
+    int err;
+
+    // An IDR frame doesn't reference anything queued ahead of it, so the
+    // policy may discard those frames without any recovery.
+    dropCounter = getQueuePolicyDropCounter(qdu);
+    if (dropCounter != NULL) {
+        flushQueuedDecodeUnits(dropCounter, &firstDroppedFrame);
+    }
+
+    err = offerDecodeUnit(qdu);
+    if (err == LBQ_SUCCESS) {
+        return true;
+    }
+    else if (err == LBQ_INTERRUPTED) {
+        // We're stopping, so there's nobody left to decode this
+        discardDecodeUnit(qdu);
+        return false;
+    }
+
+    LC_ASSERT(err == LBQ_BOUND_EXCEEDED);
+    Limelog("Video decode unit queue overflow\n");
+    dropCounter = &videoQueueStats.framesDroppedOverflow;
+
+    if (StreamConfig.videoQueuePolicy == VIDEO_QUEUE_POLICY_FLUSH_AND_IDR) {
+        // RFI recovery is not used with this policy
+        waitingForIdrFrame = true;
+    }
+    else if (flushQueuedDecodeUnits(dropCounter, &firstDroppedFrame) == 0 ||
+             qdu->decodeUnit.frameType == FRAME_TYPE_IDR) {
+        // If the consumer caught up before we flushed, or this frame is an IDR frame
+        // that doesn't reference anything we dropped, it can still be queued.
+        err = offerDecodeUnit(qdu);
+        if (err == LBQ_SUCCESS) {
+            return true;
+        }
+
+        // We're the only producer, so the queue can only have been shut down
+        LC_ASSERT(err == LBQ_INTERRUPTED);
+        discardDecodeUnit(qdu);
+        return false;
+    }
+
+    // This frame references the frames we dropped, so it must be dropped too
+    addVideoQueueStat(dropCounter, 1);
+
+    // Clear NAL state for the frame that we failed to enqueue
+    nalChainHead = qdu->decodeUnit.bufferList;
+    nalChainDataLength = qdu->decodeUnit.fullLength;
+    dropFrameState();
+
+    // Free the DU we were going to queue
+    freeDecodeUnit(qdu);
+
+    if (StreamConfig.videoQueuePolicy == VIDEO_QUEUE_POLICY_FLUSH_AND_IDR) {
+        // Free all frames in the decode unit queue
+        flushQueuedDecodeUnits(dropCounter, &firstDroppedFrame);
+    }
+
+    // If dropFrameState() determined that RFI was usable, invalidate everything
+    // from the earliest dropped frame onwards. Otherwise we need an IDR frame.
+    if (!waitingForIdrFrame) {
+        LC_ASSERT(waitingForRefInvalFrame);
+
+        Limelog("Sending RFI request for frames dropped from the decode unit queue\n");
+        addVideoQueueStat(&videoQueueStats.rfiRecoveries, 1);
+
+        startFrameNumber = firstDroppedFrame;
+        connectionDetectedFrameLoss(startFrameNumber, frameNumber);
+    }
+    else {
+        addVideoQueueStat(&videoQueueStats.idrRecoveries, 1);
+        requestIdrFrameForRecovery(LI_RECOVERY_TRIGGER_QUEUE_DROP);
+    }
+
+    return false;
+}
+
 // Reassemble the frame with the given frame number
 static void reassembleFrame(int frameNumber, bool frameIsLTR) {
     if (nalChainHead != NULL) {
@@ -473,7 +975,7 @@ static void reassembleFrame(int frameNumber, bool frameIsLTR) {
 
         // Use a stack allocation if we won't be queuing this
         if ((VideoCallbacks.capabilities & CAPABILITY_DIRECT_SUBMIT) == 0) {
-            qdu = (PQUEUED_DECODE_UNIT)malloc(sizeof(*qdu));
+            qdu = allocateDecodeUnit();
         }
         else {
             qdu = &qduDS;
@@ -490,6 +992,11 @@ static void reassembleFrame(int frameNumber, bool frameIsLTR) {
             qdu->decodeUnit.rtpTimestamp = firstPacketRtpTimestamp;
             qdu->decodeUnit.enqueueTimeUs = PltGetMicroseconds();
 
+            // A frame is ready for presentation once all of its data has arrived
+            addPresentationClockSample(PRESENTATION_CLOCK_VIDEO,
+                                       qdu->decodeUnit.presentationTimeUs,
+                                       qdu->decodeUnit.enqueueTimeUs);
+
             // These might be wrong for a few frames during a transition between SDR and HDR,
             // but the effects shouldn't very noticable since that's an infrequent operation.
             //
@@ -506,29 +1013,15 @@ static void reassembleFrame(int frameNumber, bool frameIsLTR) {
                 qdu->decodeUnit.frameType = FRAME_TYPE_PFRAME;
             }
 
+            // Let the recovery policy know we have a decodable frame again
+            recoveryPolicyFrameReceived(frameNumber, qdu->decodeUnit.frameType == FRAME_TYPE_IDR,
+                                        qdu->decodeUnit.fullLength);
+
             nalChainHead = nalChainTail = NULL;
             nalChainDataLength = 0;
 
             if ((VideoCallbacks.capabilities & CAPABILITY_DIRECT_SUBMIT) == 0) {
-                if (LbqOfferQueueItem(&decodeUnitQueue, qdu, &qdu->entry) == LBQ_BOUND_EXCEEDED) {
-                    Limelog("Video decode unit queue overflow\n");
-
-                    // RFI recovery is not supported here
-                    waitingForIdrFrame = true;
-
-                    // Clear NAL state for the frame that we failed to enqueue
-                    nalChainHead = qdu->decodeUnit.bufferList;
-                    nalChainDataLength = qdu->decodeUnit.fullLength;
-                    dropFrameState();
-
-                    // Free the DU we were going to queue
-                    free(qdu);
-
-                    // Free all frames in the decode unit queue
-                    freeDecodeUnitList(LbqFlushQueueItems(&decodeUnitQueue));
-
-                    // Request an IDR frame to recover
-                    LiRequestIdrFrame();
+                if (!queueDecodeUnit(qdu)) {
                     return;
                 }
             }
@@ -550,19 +1043,48 @@ static void reassembleFrame(int frameNumber, bool frameIsLTR) {
     }
 }
 
+// AV1 buffers don't start with a start sequence, so we only mark them as
+// BUFFER_TYPE_SPS if they consist entirely of complete temporal delimiter
+// and sequence header OBUs. This will not match partial OBUs in later packets.
+static int getAv1BufferFlags(PBUFFER_DESC buffer) {
+    BUFFER_DESC payload;
+    int obuType;
+    bool truncated;
+    bool foundSeqHeader = false;
+
+    while (buffer->length != 0) {
+        if (!getNextAv1Obu(buffer, &obuType, &payload, &truncated) || truncated) {
+            return BUFFER_TYPE_PICDATA;
+        }
+
+        if (obuType == AV1_OBU_TYPE_SEQUENCE_HEADER) {
+            foundSeqHeader = true;
+        }
+        else if (obuType != AV1_OBU_TYPE_TEMPORAL_DELIMITER) {
+            return BUFFER_TYPE_PICDATA;
+        }
+    }
+
+    return foundSeqHeader ? BUFFER_TYPE_SPS : BUFFER_TYPE_PICDATA;
+}
+
 static int getBufferFlags(char* data, int length) {
     BUFFER_DESC buffer;
     BUFFER_DESC candidate;
 
-    // We only parse H.264 and HEVC bitstreams
-    if (!(NegotiatedVideoFormat & (VIDEO_FORMAT_MASK_H264 | VIDEO_FORMAT_MASK_H265))) {
-        return BUFFER_TYPE_PICDATA;
-    }
-
     buffer.data = data;
     buffer.length = (unsigned int)length;
     buffer.offset = 0;
 
+    if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_AV1) {
+        return getAv1BufferFlags(&buffer);
+    }
+
+    // We only parse H.264, HEVC, and AV1 bitstreams
+    if (!(NegotiatedVideoFormat & (VIDEO_FORMAT_MASK_H264 | VIDEO_FORMAT_MASK_H265))) {
+        return BUFFER_TYPE_PICDATA;
+    }
+
     if (!getAnnexBStartSequence(&buffer, &candidate)) {
         return BUFFER_TYPE_PICDATA;
     }
@@ -600,13 +1122,29 @@ static int getBufferFlags(char* data, int length) {
     }
 }
 
+static void appendFragment(PLENTRY_INTERNAL entry) {
+    entry->entry.bufferType = getBufferFlags(entry->entry.data, entry->entry.length);
+
+    nalChainDataLength += entry->entry.length;
+
+    if (nalChainTail == NULL) {
+        LC_ASSERT(nalChainHead == NULL);
+        nalChainHead = nalChainTail = (PLENTRY)entry;
+    }
+    else {
+        LC_ASSERT(nalChainHead != NULL);
+        nalChainTail->next = (PLENTRY)entry;
+        nalChainTail = nalChainTail->next;
+    }
+}
+
 // As an optimization, we can cast the existing packet buffer to a PLENTRY and avoid
 // a malloc() and a memcpy() of the packet data.
 static void queueFragment(PLENTRY_INTERNAL* existingEntry, char* data, int offset, int length) {
     PLENTRY_INTERNAL entry;
 
     if (existingEntry == NULL || *existingEntry == NULL) {
-        entry = (PLENTRY_INTERNAL)malloc(sizeof(*entry) + length);
+        entry = allocateFragment(length);
     }
     else {
         entry = *existingEntry;
@@ -620,6 +1158,7 @@ static void queueFragment(PLENTRY_INTERNAL* existingEntry, char* data, int offse
         // the data already resides within the LENTRY allocation.
         if (existingEntry == NULL || *existingEntry == NULL) {
             entry->allocPtr = entry;
+            entry->packetOwner = NULL;
 
             entry->entry.data = (char*)(entry + 1);
             memcpy(entry->entry.data, &data[offset], entry->entry.length);
@@ -634,19 +1173,28 @@ static void queueFragment(PLENTRY_INTERNAL* existingEntry, char* data, int offse
             *existingEntry = NULL;
         }
 
-        entry->entry.bufferType = getBufferFlags(entry->entry.data, entry->entry.length);
+        appendFragment(entry);
+    }
+}
+
+// Queues a fragment that points into the packet buffer owned by packetOwner without
+// taking ownership of it. This lets several NALUs from one packet share the buffer.
+static void queueFragmentReference(PLENTRY_INTERNAL packetOwner, char* data, int offset, int length) {
+    PLENTRY_INTERNAL entry;
 
-        nalChainDataLength += entry->entry.length;
+    LC_ASSERT(packetOwner->packetOwner == NULL);
 
-        if (nalChainTail == NULL) {
-            LC_ASSERT(nalChainHead == NULL);
-            nalChainHead = nalChainTail = (PLENTRY)entry;
-        }
-        else {
-            LC_ASSERT(nalChainHead != NULL);
-            nalChainTail->next = (PLENTRY)entry;
-            nalChainTail = nalChainTail->next;
-        }
+    // The reference entry doesn't hold any data, so use the smallest size class
+    entry = allocateFragment(0);
+    if (entry != NULL) {
+        entry->entry.next = NULL;
+        entry->entry.length = length;
+        entry->entry.data = &data[offset];
+        entry->allocPtr = entry;
+        entry->packetOwner = packetOwner;
+        packetOwner->refCount++;
+
+        appendFragment(entry);
     }
 }
 
@@ -705,10 +1253,15 @@ static void processAvcHevcRtpPayloadSlow(PBUFFER_DESC currentPos, PLENTRY_INTERN
             }
         }
 
-        // To minimize copies, we'll allocate for SPS, PPS, and VPS to allow
-        // us to reuse the packet buffer for the picture data in the I-frame.
-        queueFragment(containsPicData ? existingEntry : NULL,
-                      currentPos->data, start, currentPos->offset - start);
+        // The picture data takes ownership of the packet buffer. The SPS, PPS, and VPS
+        // that precede it just hold a reference to it, so we don't need to copy them.
+        if (containsPicData || existingEntry == NULL || *existingEntry == NULL) {
+            queueFragment(containsPicData ? existingEntry : NULL,
+                          currentPos->data, start, currentPos->offset - start);
+        }
+        else {
+            queueFragmentReference(*existingEntry, currentPos->data, start, currentPos->offset - start);
+        }
     }
 }
 
@@ -719,7 +1272,8 @@ void requestDecoderRefresh(void) {
     waitingForIdrFrame = true;
 
     // Flush the decode unit queue
-    freeDecodeUnitList(LbqFlushQueueItems(&decodeUnitQueue));
+    unsigned int firstDroppedFrame;
+    flushQueuedDecodeUnits(&videoQueueStats.framesDroppedDecoderRefresh, &firstDroppedFrame);
 
     // Request the receive thread drop its state
     // on the next call. We can't do it here because
@@ -728,7 +1282,7 @@ void requestDecoderRefresh(void) {
     dropStatePending = true;
 
     // Request the IDR frame
-    LiRequestIdrFrame();
+    requestIdrFrameForRecovery(LI_RECOVERY_TRIGGER_DECODER);
 }
 
 // Return 1 if packet is the first one in the frame
@@ -789,7 +1343,7 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
         nextFrameNumber = frameIndex + 1;
         dropFrameState();
         if (waitingForIdrFrame) {
-            LiRequestIdrFrame();
+            requestIdrFrameForRecovery(LI_RECOVERY_TRIGGER_FRAME_LOSS);
         }
         else {
             connectionDetectedFrameLoss(startFrameNumber, frameIndex);
@@ -860,7 +1414,8 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
                 break;
             case 2: // IDR frame
                 // For other codecs, we trust the frame header rather than parsing the bitstream
-                // to determine if a given frame is an IDR frame.
+                // to determine if a given frame is an IDR frame. AV1 key frames will also be
+                // detected from the bitstream below in case the header isn't accurate.
                 if (!(NegotiatedVideoFormat & (VIDEO_FORMAT_MASK_H264 | VIDEO_FORMAT_MASK_H265))) {
                     waitingForIdrFrame = false;
                     waitingForNextSuccessfulFrame = false;
@@ -1054,7 +1609,7 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
                 nextFrameNumber = frameIndex + 1;
                 dropFrameState();
                 if (waitingForIdrFrame) {
-                    LiRequestIdrFrame();
+                    requestIdrFrameForRecovery(LI_RECOVERY_TRIGGER_FRAME_LOSS);
                 }
                 else {
                     connectionDetectedFrameLoss(startFrameNumber, frameIndex);
@@ -1064,6 +1619,40 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
             }
         }
 
+        if (firstPacket && (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_AV1)) {
+            unsigned int seqHeaderLength;
+            int av1FrameType;
+
+            parseAv1TemporalUnitStart(&currentPos, &seqHeaderLength, &av1FrameType);
+
+            // A key frame with a sequence header is a random access point like an H.264/HEVC IDR frame
+            if (seqHeaderLength != 0 && av1FrameType == AV1_FRAME_TYPE_KEY) {
+                // No longer waiting for an IDR frame
+                waitingForIdrFrame = false;
+                waitingForRefInvalFrame = false;
+
+                // Cancel any pending IDR frame request
+                waitingForNextSuccessfulFrame = false;
+
+                // This is an IDR frame
+                frameType = FRAME_TYPE_IDR;
+
+                // Split the sequence header into its own buffer, like we do for H.264/HEVC parameter sets.
+                // It references the packet buffer, which will be owned by the frame data below.
+                if (seqHeaderLength < currentPos.length) {
+                    if (existingEntry != NULL && *existingEntry != NULL) {
+                        queueFragmentReference(*existingEntry, currentPos.data, currentPos.offset, seqHeaderLength);
+                    }
+                    else {
+                        queueFragment(NULL, currentPos.data, currentPos.offset, seqHeaderLength);
+                    }
+
+                    currentPos.offset += seqHeaderLength;
+                    currentPos.length -= seqHeaderLength;
+                }
+            }
+        }
+
         // Other codecs are just passed through as is.
         queueFragment(existingEntry, currentPos.data, currentPos.offset, currentPos.length);
     }
@@ -1084,7 +1673,7 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
                 // detection of the recovery of the network. Requesting an IDR frame while
                 // the network is unstable will just contribute to congestion collapse.
                 if (waitingForNextSuccessfulFrame) {
-                    LiRequestIdrFrame();
+                    requestIdrFrameForRecovery(LI_RECOVERY_TRIGGER_FRAME_LOSS);
                 }
             }
             else {
@@ -1177,6 +1766,9 @@ void queueRtpPacket(PRTPV_QUEUE_ENTRY queueEntryPtr) {
     LC_ASSERT(sizeof(LENTRY_INTERNAL) <= sizeof(RTPV_QUEUE_ENTRY));
     PLENTRY_INTERNAL existingEntry = (PLENTRY_INTERNAL)queueEntryPtr;
     existingEntry->allocPtr = queueEntry.packet;
+    existingEntry->sizeClass = -1;
+    existingEntry->packetOwner = NULL;
+    existingEntry->refCount = 1;
 
     processRtpPayload((PNV_VIDEO_PACKET)(((char*)queueEntry.packet) + dataOffset),
                       queueEntry.length - dataOffset,
@@ -1186,11 +1778,47 @@ void queueRtpPacket(PRTPV_QUEUE_ENTRY queueEntryPtr) {
                       &existingEntry);
 
     if (existingEntry != NULL) {
-        // processRtpPayload didn't want this packet, so just free it
-        free(existingEntry->allocPtr);
+        // processRtpPayload didn't take ownership of this packet, so drop our reference.
+        // This will free it unless some fragments still point into it.
+        releasePacketReference(existingEntry);
     }
 }
 
 int LiGetPendingVideoFrames(void) {
-    return LbqGetItemCount(&decodeUnitQueue);
+    return SrqGetItemCount(&decodeUnitQueue);
+}
+
+bool LiGetVideoQueueStats(PVIDEO_QUEUE_STATS stats) {
+    if (VideoCallbacks.capabilities & CAPABILITY_DIRECT_SUBMIT) {
+        memset(stats, 0, sizeof(*stats));
+        return false;
+    }
+
+    stats->framesDroppedOverflow = PltAtomicLoad32(&videoQueueStats.framesDroppedOverflow);
+    stats->framesDroppedLatency = PltAtomicLoad32(&videoQueueStats.framesDroppedLatency);
+    stats->framesDroppedSuperseded = PltAtomicLoad32(&videoQueueStats.framesDroppedSuperseded);
+    stats->framesDroppedDecoderRefresh = PltAtomicLoad32(&videoQueueStats.framesDroppedDecoderRefresh);
+    stats->rfiRecoveries = PltAtomicLoad32(&videoQueueStats.rfiRecoveries);
+    stats->idrRecoveries = PltAtomicLoad32(&videoQueueStats.idrRecoveries);
+    return true;
+}
+
+bool LiGetVideoFrameHandoffLatency(uint32_t* p50Us, uint32_t* p90Us, uint32_t* p99Us) {
+    // We don't synchronize with the consumer here because we're just reading
+    // metrics and observing a torn write every once in a while is fine.
+    if (handoffLatencyHistogram.sampleCount == 0) {
+        return false;
+    }
+
+    if (p50Us != NULL) {
+        *p50Us = LhGetPercentile(&handoffLatencyHistogram, 50);
+    }
+    if (p90Us != NULL) {
+        *p90Us = LhGetPercentile(&handoffLatencyHistogram, 90);
+    }
+    if (p99Us != NULL) {
+        *p99Us = LhGetPercentile(&handoffLatencyHistogram, 99);
+    }
+
+    return true;
 }
@@ -34,14 +34,26 @@ static bool receivedFullFrame;
 // and subsequent packet/frame bursts that follow.
 #define RTP_RECV_PACKETS_BUFFERED 2048
 
+// Maximum number of already queued packets that the receive
+// thread will read and decrypt together
+#define VIDEO_RECV_BATCH_SIZE 16
+
 // Initialize the video stream
-void initializeVideoStream(void) {
-    initializeVideoDepacketizer(StreamConfig.packetSize);
+int initializeVideoStream(void) {
+    int err;
+
+    err = initializeVideoDepacketizer(StreamConfig.packetSize);
+    if (err != 0) {
+        return err;
+    }
+
     RtpvInitializeQueue(&rtpQueue);
     decryptionCtx = PltCreateCryptoContext();
+    PltSetCryptoContextStatsType(decryptionCtx, CRYPTO_STATS_TYPE_VIDEO);
     receivedDataFromPeer = false;
     firstDataTimeMs = 0;
     receivedFullFrame = false;
+    return 0;
 }
 
 // Clean up the video stream
@@ -81,12 +93,55 @@ static void VideoPingThreadProc(void* context) {
     }
 }
 
+// Checks whether a received packet is worth decrypting and queuing
+static bool isUsableVideoPacket(char* data, int length, int minSize, bool encrypted) {
+    if (length < minSize) {
+        // Runt packet
+        return false;
+    }
+
+    if (encrypted) {
+        PENC_VIDEO_HEADER encHeader = (PENC_VIDEO_HEADER)data;
+
+        // If this frame is below our current frame number, discard it before decryption
+        // to save CPU cycles decrypting FEC shards for a frame we already reassembled.
+        //
+        // Since this is happening _before_ decryption, this packet is not trusted yet.
+        // It's imperative that we do not mutate any state based on this packet until
+        // after it has been decrypted successfully!
+        //
+        // It's possible for an attacker to inject a fake packet that has any value of
+        // header fields they want, however this provides them no benefit because we will
+        // simply drop said packet here (if it's below the current frame number) or it
+        // will pass this check and be dropped during decryption (if contents is tampered)
+        // or after decryption in the RTP queue (if it's a replay of a previous authentic
+        // packet from the host).
+        //
+        // In short, an attacker spoofing this value via MITM or sending malicious values
+        // impersonating the host from off-link doesn't gain them anything. If they have
+        // a true MITM, they can DoS our connection by just dropping all our traffic, so
+        // tampering with packets to fail this check doesn't accomplish anything they
+        // couldn't already do. If they're not on-link, we just throw their malicious
+        // traffic away (as mentioned in the paragraph above) and continue accepting
+        // legitmate video traffic.
+        if (encHeader->frameNumber && LE32(encHeader->frameNumber) < RtpvGetCurrentFrameNumber(&rtpQueue)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 // Receive thread proc
 static void VideoReceiveThreadProc(void* context) {
     int err;
     int bufferSize, receiveSize, decryptedSize, minSize;
-    char* buffer;
+    char* buffers[VIDEO_RECV_BATCH_SIZE];
+    int packetLengths[VIDEO_RECV_BATCH_SIZE];
+    uint64_t receiveTimesUs[VIDEO_RECV_BATCH_SIZE];
+    PLT_CRYPTO_MESSAGE decryptBatch[VIDEO_RECV_BATCH_SIZE];
     char* encryptedBuffer;
+    int packetCount;
     int queueStatus;
     bool useSelect;
     int waitingForVideoMs;
@@ -97,7 +152,7 @@ static void VideoReceiveThreadProc(void* context) {
     minSize = sizeof(RTP_PACKET) + ((EncryptionFeaturesEnabled & SS_ENC_VIDEO) ? sizeof(ENC_VIDEO_HEADER) : 0);
     receiveSize = decryptedSize + ((EncryptionFeaturesEnabled & SS_ENC_VIDEO) ? sizeof(ENC_VIDEO_HEADER) : 0);
     bufferSize = decryptedSize + sizeof(RTPV_QUEUE_ENTRY);
-    buffer = NULL;
+    memset(buffers, 0, sizeof(buffers));
 
     if (setNonFatalRecvTimeoutMs(rtpSocket, UDP_RECV_POLL_TIMEOUT_MS) < 0) {
         // SO_RCVTIMEO failed, so use select() to wait
@@ -108,9 +163,9 @@ static void VideoReceiveThreadProc(void* context) {
         useSelect = false;
     }
 
-    // Allocate a staging buffer to use for each received packet
+    // Allocate staging buffers to use for each received packet in a batch
     if (encrypted) {
-        encryptedBuffer = (char*)malloc(receiveSize);
+        encryptedBuffer = (char*)malloc(receiveSize * VIDEO_RECV_BATCH_SIZE);
         if (encryptedBuffer == NULL) {
             Limelog("Video Receive: malloc() failed\n");
             ListenerCallbacks.connectionTerminated(-1);
@@ -125,17 +180,23 @@ static void VideoReceiveThreadProc(void* context) {
     while (!PltIsThreadInterrupted(&receiveThread)) {
         PRTP_PACKET packet;
 
-        if (buffer == NULL) {
-            buffer = (char*)malloc(bufferSize);
-            if (buffer == NULL) {
-                Limelog("Video Receive: malloc() failed\n");
-                ListenerCallbacks.connectionTerminated(-1);
-                break;
+        // Make sure we have a buffer for each packet in the batch
+        for (packetCount = 0; packetCount < VIDEO_RECV_BATCH_SIZE; packetCount++) {
+            if (buffers[packetCount] == NULL) {
+                buffers[packetCount] = (char*)malloc(bufferSize);
+                if (buffers[packetCount] == NULL) {
+                    break;
+                }
             }
         }
+        if (packetCount != VIDEO_RECV_BATCH_SIZE) {
+            Limelog("Video Receive: malloc() failed\n");
+            ListenerCallbacks.connectionTerminated(-1);
+            break;
+        }
 
         err = recvUdpSocket(rtpSocket,
-                            encrypted ? encryptedBuffer : buffer,
+                            encrypted ? encryptedBuffer : buffers[0],
                             receiveSize,
                             useSelect);
         if (err < 0) {
@@ -176,67 +237,81 @@ static void VideoReceiveThreadProc(void* context) {
         }
 #endif
 
-        if (err < minSize) {
-            // Runt packet
-            continue;
+        // Each packet is timestamped as it comes off the socket, since the arrival
+        // spacing within a burst feeds the bandwidth estimator and jitter tracking.
+        packetCount = 0;
+        if (isUsableVideoPacket(encrypted ? encryptedBuffer : buffers[0], err, minSize, encrypted)) {
+            receiveTimesUs[packetCount] = PltGetMicroseconds();
+            packetLengths[packetCount++] = err;
         }
 
-        // Decrypt the packet into the buffer if encryption is enabled
-        if (encrypted) {
-            PENC_VIDEO_HEADER encHeader = (PENC_VIDEO_HEADER)encryptedBuffer;
-
-            // If this frame is below our current frame number, discard it before decryption
-            // to save CPU cycles decrypting FEC shards for a frame we already reassembled.
-            //
-            // Since this is happening _before_ decryption, this packet is not trusted yet.
-            // It's imperative that we do not mutate any state based on this packet until
-            // after it has been decrypted successfully!
-            //
-            // It's possible for an attacker to inject a fake packet that has any value of
-            // header fields they want, however this provides them no benefit because we will
-            // simply drop said packet here (if it's below the current frame number) or it
-            // will pass this check and be dropped during decryption (if contents is tampered)
-            // or after decryption in the RTP queue (if it's a replay of a previous authentic
-            // packet from the host).
-            //
-            // In short, an attacker spoofing this value via MITM or sending malicious values
-            // impersonating the host from off-link doesn't gain them anything. If they have
-            // a true MITM, they can DoS our connection by just dropping all our traffic, so
-            // tampering with packets to fail this check doesn't accomplish anything they
-            // couldn't already do. If they're not on-link, we just throw their malicious
-            // traffic away (as mentioned in the paragraph above) and continue accepting
-            // legitmate video traffic.
-            if (encHeader->frameNumber && LE32(encHeader->frameNumber) < RtpvGetCurrentFrameNumber(&rtpQueue)) {
-                continue;
+        // Video packets arrive in bursts, so grab any others that are already waiting.
+        // This lets us decrypt them together.
+        while (packetCount < VIDEO_RECV_BATCH_SIZE) {
+            char* packetBuffer = encrypted ? &encryptedBuffer[packetCount * receiveSize] : buffers[packetCount];
+
+            err = recvUdpSocketIfReady(rtpSocket, packetBuffer, receiveSize);
+            if (err <= 0) {
+                // Any socket error will be reported by the next recvUdpSocket() call
+                break;
             }
 
-            if (!PltDecryptMessage(decryptionCtx, ALGORITHM_AES_GCM, 0,
-                                   (unsigned char*)StreamConfig.remoteInputAesKey, sizeof(StreamConfig.remoteInputAesKey),
-                                   encHeader->iv, sizeof(encHeader->iv),
-                                   encHeader->tag, sizeof(encHeader->tag),
-                                   ((unsigned char*)(encHeader + 1)), err - sizeof(ENC_VIDEO_HEADER), // The ciphertext is after the header
-                                   (unsigned char*)buffer, &err)) {
-                Limelog("Failed to decrypt video packet!\n");
-                continue;
+            if (isUsableVideoPacket(packetBuffer, err, minSize, encrypted)) {
+                receiveTimesUs[packetCount] = PltGetMicroseconds();
+                packetLengths[packetCount++] = err;
+            }
+        }
+
+        // Decrypt the packets into their buffers if encryption is enabled
+        if (encrypted && packetCount > 0) {
+            PENC_VIDEO_HEADER encHeader = NULL;
+
+            for (int i = 0; i < packetCount; i++) {
+                encHeader = (PENC_VIDEO_HEADER)&encryptedBuffer[i * receiveSize];
+
+                decryptBatch[i].iv = encHeader->iv;
+                decryptBatch[i].tag = encHeader->tag;
+                decryptBatch[i].inputData = (unsigned char*)(encHeader + 1); // The ciphertext is after the header
+                decryptBatch[i].inputDataLength = packetLengths[i] - sizeof(ENC_VIDEO_HEADER);
+                decryptBatch[i].outputData = (unsigned char*)buffers[i];
             }
+
+            PltDecryptMessageBatch(decryptionCtx, ALGORITHM_AES_GCM, 0,
+                                   (unsigned char*)StreamConfig.remoteInputAesKey, sizeof(StreamConfig.remoteInputAesKey),
+                                   sizeof(encHeader->iv), sizeof(encHeader->tag),
+                                   decryptBatch, packetCount);
         }
 
-        // Convert fields to host byte-order
-        packet = (PRTP_PACKET)&buffer[0];
-        packet->sequenceNumber = BE16(packet->sequenceNumber);
-        packet->timestamp = BE32(packet->timestamp);
-        packet->ssrc = BE32(packet->ssrc);
+        for (int i = 0; i < packetCount; i++) {
+            if (encrypted) {
+                if (!decryptBatch[i].success) {
+                    Limelog("Failed to decrypt video packet!\n");
+                    continue;
+                }
+
+                packetLengths[i] = decryptBatch[i].outputDataLength;
+            }
+
+            // Convert fields to host byte-order
+            packet = (PRTP_PACKET)&buffers[i][0];
+            packet->sequenceNumber = BE16(packet->sequenceNumber);
+            packet->timestamp = BE32(packet->timestamp);
+            packet->ssrc = BE32(packet->ssrc);
 
-        queueStatus = RtpvAddPacket(&rtpQueue, packet, err, (PRTPV_QUEUE_ENTRY)&buffer[decryptedSize]);
+            queueStatus = RtpvAddPacket(&rtpQueue, packet, packetLengths[i], receiveTimesUs[i],
+                                        (PRTPV_QUEUE_ENTRY)&buffers[i][decryptedSize]);
 
-        if (queueStatus == RTPF_RET_QUEUED) {
-            // The queue owns the buffer
-            buffer = NULL;
+            if (queueStatus == RTPF_RET_QUEUED) {
+                // The queue owns the buffer
+                buffers[i] = NULL;
+            }
         }
     }
 
-    if (buffer != NULL) {
-        free(buffer);
+    for (int i = 0; i < VIDEO_RECV_BATCH_SIZE; i++) {
+        if (buffers[i] != NULL) {
+            free(buffers[i]);
+        }
     }
 
     if (encryptedBuffer != NULL) {